@@ -8,21 +8,62 @@
 #include "chess_net.h"
 #include "chess_logic.h"
 #include "chess_structs.h"
+#include "eval_cache.h"
+#include "genome_arena.h"
+#include "game_sched.h"
+#include "swiss.h"
+#include "gauntlet.h"
+#include "checkpoint.h"
+#include "pop_archive.h"
+#include "persist.h"
+#include "rng.h"
 
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include <time.h>
 #include <omp.h>
+#include <stdint.h>
 
 
 #define MAX_MINIMAX_DEPTH 20
 
-#define MINIMAX_WIN_EVAL_COEF 100000
-
 #define PRIMITIVE_PIECE_VALUE_ENDGAME_THRESHOLD 15
 
-void chNetEvolution()
+// leaves evaluated together by one call of evaluateBoards in innerMinimax
+#define FRONTIER_BATCH_SIZE 8
+
+// nodes searched by thread between checks of limits of search
+#define SEARCH_POLL_NODES 1024
+
+// positions visited by searches of this thread (for node limits and stats)
+static _Thread_local long searchNodes = 0;
+
+/**
+ * state of one search shared by its threads
+ */
+typedef struct {
+
+  const TsearchInfo* info;
+  double startTime;
+
+  // nodes of all threads (added every SEARCH_POLL_NODES nodes)
+  long nodes;
+
+  // false in first depth, it is stopped only by cancel
+  bool canTimeOut;
+
+  // set when search has to stop, innerMinimax then returns immediately
+  bool stopped;
+
+} TsearchControl;
+
+// search of this thread (NULL outside of minimaxSearch) and its nodes
+// already added to control->nodes
+static _Thread_local TsearchControl* searchControl = NULL;
+static _Thread_local long polledNodes = 0;
+
+void chNetEvolution(const char* resumeFileName)
 {
   const int maxGeneration = 100;  // max number of generations in simulation
   const int populationCount = 100;  // number of networks in population
@@ -30,47 +71,141 @@ void chNetEvolution()
 
   const int netStruct[3] = {64, 10, 1};
   const int netStructLayerCount = sizeof(netStruct) / sizeof(*netStruct);
-
-  const int tournamentRounds = 2;
+  const Tactivation netActivation = ACT_SIGMOID;
+  const TchNetInput netInputMode = CHNET_INPUT_ABSOLUTE;
+
+  // swiss tournament plays fewer games than old one (two rounds of random
+  // pairs) and ends sooner if survival split gets stable
+  const int tournamentMaxGames = SWISS_GAMES_PER_PLAYER * populationCount;
+  const double tournamentMaxMisplaced = SWISS_MAX_MISPLACED_SHARE *
+                                        populationCount;
   const float tournamentMoveTime = 0.01; 
 
-  TchNet** population = malloc(populationCount * sizeof(TchNet*));
-  for(int i = 0; i < populationCount; ++i){
-    population[i] = initRandChNet(netStructLayerCount, netStruct);
+  // all random decisions of evolution come from this seed, so run can be
+  // repeated (independently on number of threads)
+  uint64_t seed;
+  int firstGeneration = 0;
+  TgenomeArena* arena;
+  TchNet** population;
+  float* fitness;
+
+  if(resumeFileName == NULL){
+    seed = ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+
+    // all nets live in arena, population is their order by fitness
+    arena = initRandGenomeArena(populationCount, netStructLayerCount,
+                                netStruct, netActivation, netInputMode, seed);
+    population = malloc(populationCount * sizeof(TchNet*));
+    memcpy(population, arena->nets, populationCount * sizeof(TchNet*));
+    fitness = calloc(populationCount, sizeof(float));
+  } else {
+    Tcheckpoint* checkpoint = loadCheckpoint(resumeFileName);
+    if(checkpoint == NULL){
+      fprintf(stderr, "can not resume from %s\n", resumeFileName);
+      return;
+    }
+    seed = checkpoint->seed;
+    firstGeneration = checkpoint->generation;
+    arena = checkpoint->arena;
+
+    population = malloc(arena->netCount * sizeof(TchNet*));
+    for(int i = 0; i < arena->netCount; ++i){
+      population[i] = arena->nets[checkpoint->order[i]];
+    }
+    fitness = checkpoint->fitness;
+    checkpoint->fitness = NULL;
+    freeCheckpoint(checkpoint, false);
+
+    printf("resumed from %s at generation %d\n", resumeFileName,
+           firstGeneration);
+  }
+  printf("evolution seed: %llu\n", (unsigned long long)seed);
+  // population size of checkpoint wins over constant
+  const int netCount = arena->netCount;
+
+  // archive and checkpoint are written by background thread from snapshot,
+  // so next generation doesn`t wait for disk
+  Tpersister* persister = startPersister(arena, POP_ARCHIVE_FILE,
+                                         CHECKPOINT_FILE);
+  if(persister == NULL){
+    fprintf(stderr, "can not start background saving\n");
   }
 
+  // every game of every tournament is appended to game log
+  TgameLog* gameLog = openGameLog(GAME_LOG_FILE);
+  if(gameLog == NULL){
+    fprintf(stderr, "can not open %s\n", GAME_LOG_FILE);
+  }
+  setGameSchedulerLog(gameLog);
+
+  // positions of all games are exported for analysis (one shard per thread)
+  TposDataset* dataset = createPosDataset(POS_DATASET_PREFIX,
+                                          POS_DATASET_SEEN_CAPACITY);
+  if(dataset == NULL){
+    fprintf(stderr, "can not create %s shards\n", POS_DATASET_PREFIX);
+  }
+  setGameSchedulerDataset(dataset);
 
-  for(int i = 0;
+
+  for(int i = firstGeneration;
       (i < maxGeneration);
       ++i){
     
     printf("----------GENERATION %3d----------\n", i);
+    if(gameLog != NULL){
+      gameLog->generation = i;
+    }
 
-    quickTournament(population, populationCount,
-                    tournamentRounds, tournamentMoveTime);
-
-    int elderyCount = populationCount/2;
-    for(int j = elderyCount; j < populationCount; ++j){
-      freeChNet(population[j]);
-
-      population[j] = chNetSex(population[(j - elderyCount) % elderyCount],
-                                     population[(j+1) % elderyCount],
-                                     mutationRareness);
+    // first round is paired by its own generator (index after children)
+    Trng pairingRng;
+    rngSeed(&pairingRng, seed, i + 1, netCount);
+    swissTournament(population, netCount, tournamentMaxGames,
+                    tournamentMaxMisplaced, tournamentMoveTime, &pairingRng,
+                    fitness);
+    printEvalCacheStats();
+
+    int elderyCount = netCount/2;
+    // children are written over nets that didn`t survive, every child has
+    // its own generator given by (seed, generation, child index)
+    #pragma omp parallel for
+    for(int j = elderyCount; j < netCount; ++j){
+      Trng rng;
+      rngSeed(&rng, seed, i + 1, j);
+      chNetSexInto(population[j],
+                   population[(j - elderyCount) % elderyCount],
+                   population[(j+1) % elderyCount],
+                   mutationRareness, &rng);
+    }
+    // ratings of replaced nets don`t belong to children, they are saved as
+    // 0 until children play
+    for(int j = elderyCount; j < netCount; ++j){
+      fitness[j] = 0;
     }
 
-    savePopulation(population, populationCount);
+    if(persister != NULL){
+      persisterSubmit(persister, arena, population, fitness, i + 1, seed);
+    }
   }
 
 
-  if(canAnyoneBeatPrimitiveEval(population, populationCount)){
+  if(canAnyoneBeatPrimitiveEval(population, netCount)){
     printf("someone is better than primitive eval");
   }
 
-  for(int i = 0; i < populationCount; ++i){
-    freeChNet(population[i]);
+  if(persister != NULL){
+    stopPersister(persister);
   }
-
+  setGameSchedulerLog(NULL);
+  if(gameLog != NULL){
+    closeGameLog(gameLog);
+  }
+  setGameSchedulerDataset(NULL);
+  if(dataset != NULL){
+    closePosDataset(dataset);
+  }
+  freeGenomeArena(arena);
   free(population);
+  free(fitness);
 }
 
 
@@ -78,35 +213,60 @@ void quickTournament(TchNet** population, int populationCount, int rounds,
                      float timeForMove)
 {
   float* keys = calloc(populationCount, sizeof(float));
+  int* order = malloc(populationCount * sizeof(int));
+  // white and black index (in population) of every game
+  int* players = malloc(2 * rounds * populationCount * sizeof(int));
+  TgameScheduler* sched = initGameScheduler();
+
+  for(int i = 0; i < populationCount; ++i){
+    order[i] = i;
+  }
 
+  // pairings don`t depend on results, so games of all rounds are scheduled
+  // together and no thread waits for end of round
+  int gameCount = 0;
   for(int round = 0; round < rounds; ++round){
-    shufflePopulationWithKeys(population, keys, populationCount);
-    
-    #pragma omp parallel for
-    for(int i = 0; i < populationCount; i += 2){
-      switch (game(population[i], population[i+1], timeForMove)){
-        case 0:  //draw
-          printf("game %d/%3d: draw\n", round+1, (i/2)+1);
-          keys[i] += 0.3;
-          keys[i+1] += 0.4;
-          break;
-        
-        case 1: //win of white
-          printf("game %d/%3d: white\n", round+1, (i/2)+1);
-          keys[i] += 1.0;
-          break;
-
-        case -1:  //win of black
-          printf("game %d/%3d: black\n", round+1, (i/2)+1);
-          keys[i+1] += 1.1;
-          break;
+    shuffleIndices(order, populationCount);
+
+    for(int i = 0; i + 1 < populationCount; i += 2){
+      // pairing that can not be queued is skipped (players[k] stays
+      // players of task k)
+      if(gameSchedulerAdd(sched, population[order[i]],
+                          population[order[i+1]], round, i/2) < 0){
+        continue;
       }
+      players[2*gameCount] = order[i];
+      players[2*gameCount + 1] = order[i+1];
+      ++gameCount;
+    }
+  }
+
+  runGameScheduler(sched, timeForMove, true);
+  gameSchedulerReport(sched);
+
+  for(int k = 0; k < gameCount; ++k){
+    int white = players[2*k], black = players[2*k + 1];
+    switch (sched->tasks[k].result){
+      case 0:  //draw
+        keys[white] += 0.3;
+        keys[black] += 0.4;
+        break;
+      
+      case 1: //win of white
+        keys[white] += 1.0;
+        break;
+
+      case -1:  //win of black
+        keys[black] += 1.1;
+        break;
     }
   }
-  
 
   sortPopulation(population, keys, populationCount, false);
 
+  freeGameScheduler(sched);
+  free(players);
+  free(order);
   free(keys);
 }
 
@@ -144,23 +304,30 @@ void sortPopulation(TchNet** population, float *keys, int populationCount, bool
 bool canAnyoneBeatPrimitiveEval(TchNet** population, int populationCount)
 {
   const float timeForMove = 1.0;
-  bool canAnyone = false;
-  
-  #pragma omp parallel for
-  for(int i = 0; i < populationCount; ++i){
-    if(game(population[i], NULL, timeForMove) == 1){
-      printf("net %d won as white\n", i);
-      if(game(NULL, population[i], timeForMove) == -1){
-        printf("net %d won as black\n", i);
-        canAnyone = true;
-      }
-    } else {
-      printf("net %d lost\n", i);
-    }
+
+  Tgauntlet* gauntlet = runGauntlet(population, populationCount,
+                                    timeForMove, true);
+  if(gauntlet == NULL){
+    return false;
   }
+  printGauntlet(gauntlet);
+
+  bool canAnyone = (gauntlet->winner >= 0);
+  freeGauntlet(gauntlet);
   return canAnyone;
 }
 
+void shuffleIndices(int* indices, int count)
+{
+  for(int i = 0; i < count; ++i){
+    int index = rand() % count;
+
+    int temp = indices[i];
+    indices[i] = indices[index];
+    indices[index] = temp;
+  }
+}
+
 void shufflePopulationWithKeys(TchNet** population, float* keys,
                                int populationCount)
 {
@@ -179,168 +346,350 @@ void shufflePopulationWithKeys(TchNet** population, float* keys,
 }
 
 
+/**
+ * returns true if cancel flag is set (by any thread)
+ */
+static inline bool isCancelled(const bool* cancel)
+{
+  return cancel != NULL && __atomic_load_n(cancel, __ATOMIC_RELAXED);
+}
+
 int game(const TchNet* white, const TchNet* black, float timeBudget)
 {
-  Tboard *b = initBoard();
+  return gameFrom(white, black, NULL, timeBudget, NULL, NULL);
+}
+
+int gameFrom(const TchNet* white, const TchNet* black, const Tboard* start,
+             float timeBudget, const bool* cancel, TgameRecord* record)
+{
+  Tboard *b = (start == NULL) ? initBoard() : copyBoard(start);
 
+  if(record != NULL){
+    startGameRecord(record,
+                    (white == NULL) ? GAME_LOG_PRIMITIVE_ID : white->id,
+                    (black == NULL) ? GAME_LOG_PRIMITIVE_ID : black->id,
+                    start);
+  }
 
   char *moveBuffer = malloc(MAX_INP_LEN * sizeof(char));
   int result = 2;
-  while(result == 2)
+  while(result == 2 && !isCancelled(cancel))
   {
+    double moveStart = omp_get_wtime();
+    float evaluation;
+    int depth;
     if(b->move%2 == 0){
       //white`s move
 
-      minimax(b, white, timeBudget, moveBuffer);
+      depth = minimaxCancellable(b, white, timeBudget, cancel, moveBuffer,
+                                 &evaluation);
 
     } else {
       //black`s move
 
-      minimax(b, black, timeBudget, moveBuffer);
+      depth = minimaxCancellable(b, black, timeBudget, cancel, moveBuffer,
+                                 &evaluation);
     
     }
+    if(isCancelled(cancel)){
+      // move of interrupted search is not trustworthy
+      break;
+    }
+
+    if(record != NULL){
+      gameRecordAddMove(record, moveBuffer, depth, evaluation,
+                        omp_get_wtime() - moveStart);
+    }
   
     moveBoard(moveBuffer, b);
 
     result = getResult(b);
   }
 
+  if(record != NULL){
+    record->result = result;
+  }
+
   freeBoard(b);
   free(moveBuffer);
   return result;
 }
 
-bool savePopulation(TchNet** population, int populationCount)
+int minimax(Tboard *b, const TchNet* net, float seconds, char *output)
 {
-  for(int i = 0; i < populationCount; ++i){
-    char filename[26] = "population/save____.txt";
-    int a = 0;
-    for(int j = i+1; j != 0; j = j/10){
-      filename[18 - a] = '0' + j%10;
-      ++a;
-    }
-    FILE* file = fopen(filename, "w");
-    if(file == NULL){
-      return false;
-    }
-    fprintChNet(file, population[i]);
-    fclose(file);    
+  return minimaxCancellable(b, net, seconds, NULL, output, NULL);
+}
+
+int minimaxCancellable(Tboard *b, const TchNet* net, float seconds,
+                       const bool* cancel, char *output, float* evaluation)
+{
+  TsearchInfo info;
+  initSearchInfo(&info, seconds);
+  info.cancel = cancel;
+
+  int depth = minimaxSearch(b, net, &info);
+  strcpy(output, info.bestMove);
+  if(evaluation != NULL) *evaluation = info.evaluation;
+  return depth;
+}
+
+void initSearchInfo(TsearchInfo* info, float seconds)
+{
+  memset(info, 0, sizeof(TsearchInfo));
+  info->seconds = seconds;
+}
+
+/**
+ * returns true if search has to stop
+ */
+static bool isSearchOver(const TsearchInfo* info, double startTime,
+                         long nodes)
+{
+  return (info->seconds > 0 &&
+          omp_get_wtime() - startTime > info->seconds) ||
+         (info->maxNodes > 0 && nodes >= info->maxNodes) ||
+         isCancelled(info->cancel);
+}
+
+/**
+ * adds nodes of thread to nodes of its search and checks limits
+ *
+ * @return true if search has to stop
+ */
+static bool pollSearch(TsearchControl* control)
+{
+  long total = __atomic_add_fetch(&control->nodes, searchNodes - polledNodes,
+                                  __ATOMIC_RELAXED);
+  polledNodes = searchNodes;
+
+  if(isCancelled(control->info->cancel) ||
+     (control->canTimeOut &&
+      isSearchOver(control->info, control->startTime, total))){
+    __atomic_store_n(&control->stopped, true, __ATOMIC_RELAXED);
   }
-  return true;
+  return __atomic_load_n(&control->stopped, __ATOMIC_RELAXED);
 }
 
-int minimax(Tboard *b, const TchNet* net, float seconds, char *output)
+int minimaxSearch(Tboard *b, const TchNet* net, TsearchInfo* info)
 {
+  double startTime = omp_get_wtime();
+  info->nodes = 0;
+  info->elapsed = 0;
+  info->evaluation = 0;
+  info->depth = -1;
+
   TmoveList *ml = initMoveList(16);
   generateAllPossibleMoves(b, ml);
 
   // no move possible
   if(ml->filled < 1){
-    strcpy(output, (char[5]){'n', 'o', 'm', 'o', '\0'});
+    strcpy(info->bestMove, (char[5]){'n', 'o', 'm', 'o', '\0'});
     freeMoveList(ml);
     return -1;
   }
+  strcpy(info->bestMove, ml->moves[0]);
 
 
-  int maxDepth = MAX_MINIMAX_DEPTH, startDepth = 1, depthStep = 1,
-      timeBudget = seconds * 1000000;
+  int maxDepth = (info->maxDepth > 0) ? info->maxDepth : MAX_MINIMAX_DEPTH,
+      startDepth = 1, depthStep = 1,
+      threads = (info->threads > 1) ? info->threads : 1;
   float depthTimeCoeff = 0.5;
   bool isBlack = (((b->move+1) % 2) == 0),
-       isInTime = true,
-       interrupted = false;
-  
-  clock_t startTime = clock();
-
-
-  int depth = startDepth;
-  for(; depth <= maxDepth && isInTime; depth += depthStep){
-    
-    float *keys = malloc(ml->filled * sizeof(int));
-    
-    for(int i = 0; i < ml->filled && isInTime; i++){
-      Tboard *bCopy = copyBoard(b);
+       isInTime = true;
+
+  TsearchControl control = {
+    .info = info,
+    .startTime = startTime,
+    .nodes = 0,
+    .canTimeOut = false,
+    .stopped = false
+  };
+
+  float *keys = malloc(ml->filled * sizeof(float));
+
+  // searched depth is depth of innerMinimax + 1 (move of root)
+  for(int depth = startDepth; (depth == startDepth || depth < maxDepth) &&
+                              isInTime; depth += depthStep){
+
+    // moves of root are searched with full window, so they can be split
+    // between threads without changing the result
+    control.canTimeOut = (depth != startDepth);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads) \
+            if(threads > 1)
+    for(int i = 0; i < ml->filled; i++){
+      if(__atomic_load_n(&control.stopped, __ATOMIC_RELAXED)){
+        continue;
+      }
+      searchControl = &control;
+      polledNodes = searchNodes;
+      TsearchArena *arena = getThreadSearchArena();
+      TsearchArenaMark mark = searchArenaMark(arena);
+      Tboard *bCopy = copyBoardToArena(b, arena);
       moveBoard(ml->moves[i], bCopy);
 
       keys[i] = innerMinimax(bCopy, net, depth, isBlack, -INF, INF);
 
-      freeBoard(bCopy);
+      searchArenaReset(arena, mark);
 
-      isInTime = !(startTime + timeBudget < clock()) || depth == startDepth;
-      interrupted = !isInTime;
+      pollSearch(&control);
+      searchControl = NULL;
+      flushEvalCacheStats();
     }
 
-    if(!interrupted) sortMoveList(ml, keys, isBlack);
+    // values of unfinished depth are not complete
+    if(control.stopped){
+      break;
+    }
 
-    free(keys);
+    sortMoveList(ml, keys, isBlack);
+    strcpy(info->bestMove, ml->moves[0]);
+    info->evaluation = keys[0];
+    info->depth = depth + 1;
+    info->nodes = control.nodes;
+    info->elapsed = omp_get_wtime() - startTime;
+    if(info->onDepth != NULL){
+      info->onDepth(info, info->onDepthData);
+    }
 
-    isInTime = !((startTime + timeBudget/
-                  (depthTimeCoeff * pow(10, depthStep))) < clock());
+    // next depth takes much longer, so it isn`t started late
+    isInTime = !isSearchOver(info, startTime, control.nodes) &&
+               !(info->seconds > 0 &&
+                 omp_get_wtime() - startTime >
+                   info->seconds / (depthTimeCoeff * pow(10, depthStep)));
   }
-  strcpy(output, ml->moves[0]);
-  freeMoveList(ml);
 
-  if(interrupted) depth -= depthStep;
-  
-  if(!isInTime) depth -= depthStep;
+  free(keys);
+  freeMoveList(ml);
 
-  return depth+1;
+  info->nodes = control.nodes;
+  info->elapsed = omp_get_wtime() - startTime;
+  return info->depth;
 }
 
 
+/**
+ * returns max (or min) of evaluations of children of b
+ * 
+ * children are evaluated in batches of FRONTIER_BATCH_SIZE and pruning is
+ * checked after every batch. Cutoffs in depth 1 node only skip evaluations
+ * of leaves, so value of root is same as with one by one evaluation.
+ */
+static float evaluateFrontier(const Tboard* b, const TmoveList* ml,
+                              const TchNet* net, bool isMax,
+                              float alfa, float beta)
+{
+  Tboard* children[FRONTIER_BATCH_SIZE];
+  float evaluations[FRONTIER_BATCH_SIZE];
+  float best = isMax ? -INF : INF;
+
+  TsearchArena* arena = getThreadSearchArena();
+  TsearchArenaMark mark = searchArenaMark(arena);
+
+  for(int start = 0; start < ml->filled; start += FRONTIER_BATCH_SIZE){
+    int count = ml->filled - start;
+    if(count > FRONTIER_BATCH_SIZE) count = FRONTIER_BATCH_SIZE;
+
+    for(int i = 0; i < count; ++i){
+      children[i] = copyBoardToArena(b, arena);
+      moveBoard(ml->moves[start + i], children[i]);
+    }
+
+    evaluateBoards(children, count, net, evaluations);
+    searchNodes += count;
+
+    for(int i = 0; i < count; ++i){
+      best = isMax ? fmax(best, evaluations[i]) : fmin(best, evaluations[i]);
+    }
+    searchArenaReset(arena, mark);
+
+    if(isMax){
+      alfa = fmax(alfa, best);
+    } else {
+      beta = fmin(beta, best);
+    }
+    if(beta <= alfa){
+      break;
+    }
+  }
+
+  return best;
+}
+
 float innerMinimax(Tboard *b, const TchNet* net, int depth, bool isMax, float alfa, float beta)
 {
+  ++searchNodes;
+  // limits are checked once in a while, stopped search unwinds (its value
+  // is thrown away by minimaxSearch)
+  if(searchControl != NULL &&
+     ((searchNodes - polledNodes >= SEARCH_POLL_NODES &&
+       pollSearch(searchControl)) ||
+      __atomic_load_n(&searchControl->stopped, __ATOMIC_RELAXED))){
+    return 0;
+  }
   if(depth == 0){
     return evaluateBoard(b, net);
   }
 
-  TmoveList *ml = initMoveList(8);
+  // everything of this node and its subtree is in arena of thread
+  TsearchArena *arena = getThreadSearchArena();
+  TsearchArenaMark mark = searchArenaMark(arena);
+
+  TmoveList *ml = initMoveListInArena(8, arena);
   generateAllPossibleMoves(b, ml);
 
   int result = getResultFaster(b, ml);
   if(result < 2){
-    freeMoveList(ml);
+    searchArenaReset(arena, mark);
 
     // *(depth+1) for faster checkmates
     return result * (MINIMAX_WIN_EVAL_COEF * (depth+1));
   }
 
+  if(depth == 1 && net != NULL){
+    float best = evaluateFrontier(b, ml, net, isMax, alfa, beta);
+    searchArenaReset(arena, mark);
+    return best;
+  }
+
   if(isMax){
     float max = -INF;
 
     for (int i = 0; i < ml->filled; i++){
-      Tboard *copy = copyBoard(b);
+      TsearchArenaMark childMark = searchArenaMark(arena);
+      Tboard *copy = copyBoardToArena(b, arena);
       moveBoard(ml->moves[i], copy);
 
       
       max = fmax(max, innerMinimax(copy, net, depth-1, false, alfa, beta));
-      freeBoard(copy);
+      searchArenaReset(arena, childMark);
 
       alfa = fmax(alfa, max);
       if(beta <= alfa){
-        freeMoveList(ml);
+        searchArenaReset(arena, mark);
         return max;
       }
     }
-    freeMoveList(ml);
+    searchArenaReset(arena, mark);
     return max;
   }else{
     float min = INF;
 
     for (int i = 0; i < ml->filled; i++){
-      Tboard *copy = copyBoard(b);
+      TsearchArenaMark childMark = searchArenaMark(arena);
+      Tboard *copy = copyBoardToArena(b, arena);
       moveBoard(ml->moves[i], copy);
 
       
       min = fmin(min, innerMinimax(copy, net, depth-1, true, alfa, beta));
-      freeBoard(copy);
+      searchArenaReset(arena, childMark);
 
       beta = fmin(beta, min);
       if(beta <= alfa){
-        freeMoveList(ml);
+        searchArenaReset(arena, mark);
         return min;
       }
     }
-    freeMoveList(ml);
+    searchArenaReset(arena, mark);
     return min;
   }
 }
@@ -377,16 +726,122 @@ void sortMoveList(TmoveList* ml, float *keys, bool increasing)
   }
 }
 
+Tboard** randomPositions(int count, int maxMoves)
+{
+  Tboard** positions = malloc(count * sizeof(Tboard*));
+  TmoveList* ml = initMoveList(16);
+
+  for(int i = 0; i < count; ++i){
+    Tboard* b = initBoard();
+    int moves = rand() % (maxMoves + 1);
+
+    for(int j = 0; j < moves; ++j){
+      ml->filled = 0;
+      generateAllPossibleMoves(b, ml);
+      if(getResultFaster(b, ml) != 2){
+        break;
+      }
+      moveBoard(ml->moves[rand() % ml->filled], b);
+    }
+
+    positions[i] = b;
+  }
+
+  freeMoveList(ml);
+  return positions;
+}
+
 float evaluateBoard(const Tboard* b, const TchNet* net)
 {
   if(net == NULL){
     return primitiveEval(b);
   }
 
-  char* posString = boardToPosString(b);
-  float evaluation = chNetPredict(net, posString);
-  free(posString);
-  return evaluation;
+  uint8_t pieceIndices[PREPR_NEURONS_COUNT];
+  bool mirrored = chNetEncodeBoardForNet(net, b, pieceIndices);
+
+  uint64_t key = 0;
+  float evaluation;
+  if(net->evalCache != NULL){
+    key = pieceIndicesHash(pieceIndices);
+  }
+  if(net->evalCache == NULL ||
+     !evalCacheProbe(net->evalCache, key, &evaluation)){
+    evaluation = chNetPredictIndices(net, pieceIndices);
+    if(net->evalCache != NULL){
+      evalCacheStore(net->evalCache, key, evaluation);
+    }
+  }
+
+  return mirrored ? chNetFlipEvaluation(evaluation) : evaluation;
+}
+
+void evaluateBoards(Tboard** boards, int count, const TchNet* net,
+                    float* evaluations)
+{
+  if(net == NULL){
+    for(int i = 0; i < count; ++i){
+      evaluations[i] = primitiveEval(boards[i]);
+    }
+    return;
+  }
+
+  // buffers of batch live in arena of thread until evaluations are done
+  TsearchArena* arena = getThreadSearchArena();
+  TsearchArenaMark mark = searchArenaMark(arena);
+  uint8_t* pieceIndices = searchArenaAlloc(arena,
+                                           count * PREPR_NEURONS_COUNT);
+  bool* mirrored = searchArenaAlloc(arena, count * sizeof(bool));
+  uint64_t* keys = searchArenaAlloc(arena, count * sizeof(uint64_t));
+
+  // only positions missing in cache go to the net, they are moved to front
+  // of pieceIndices
+  int* missing = searchArenaAlloc(arena, count * sizeof(int));
+  int missingCount = 0;
+  for(int i = 0; i < count; ++i){
+    uint8_t* indices = pieceIndices + missingCount*PREPR_NEURONS_COUNT;
+    mirrored[i] = chNetEncodeBoardForNet(net, boards[i], indices);
+    if(net->evalCache != NULL){
+      keys[i] = pieceIndicesHash(indices);
+      if(evalCacheProbe(net->evalCache, keys[i], &evaluations[i])){
+        continue;
+      }
+    }
+    missing[missingCount++] = i;
+  }
+
+  if(missingCount > 0){
+    float* missingEvaluations = searchArenaAlloc(arena, missingCount *
+                                                        sizeof(float));
+    chNetPredictIndicesBatch(net, pieceIndices, missingCount,
+                             missingEvaluations);
+
+    for(int i = 0; i < missingCount; ++i){
+      evaluations[missing[i]] = missingEvaluations[i];
+      if(net->evalCache != NULL){
+        evalCacheStore(net->evalCache, keys[missing[i]],
+                       missingEvaluations[i]);
+      }
+    }
+  }
+
+  for(int i = 0; i < count; ++i){
+    if(mirrored[i]){
+      evaluations[i] = chNetFlipEvaluation(evaluations[i]);
+    }
+  }
+
+  searchArenaReset(arena, mark);
+}
+
+void printEvalCacheStats(void)
+{
+  uint64_t probes, hits;
+  getEvalCacheStats(&probes, &hits);
+  resetEvalCacheStats();
+  printf("eval cache: %llu/%llu hits (%.1f %%)\n",
+         (unsigned long long)hits, (unsigned long long)probes,
+         (probes > 0) ? (100.0 * hits / probes) : 0);
 }
 
 float primitiveEval(const Tboard *b)
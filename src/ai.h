@@ -10,19 +10,31 @@
 
 #include "chess_net.h"
 #include "chess_structs.h"
+#include "game_log.h"
+
+
+// value of mate found with remaining depth d is
+// +-MINIMAX_WIN_EVAL_COEF * (d+1)
+#define MINIMAX_WIN_EVAL_COEF 100000
 
 
 /**
  * Initializes population of chNets and evolves them by forcing them to fight
  * each other in the most deadly game of chess in their lives.
  * 
- * saves the population
+ * saves the population (POP_ARCHIVE_FILE) and checkpoint (CHECKPOINT_FILE)
+ * after every generation
+ * 
+ * @param resumeFileName checkpoint to continue from (NULL for new run)
  */
-void chNetEvolution();
+void chNetEvolution(const char* resumeFileName);
 
 
 /**
  * sorts population, second half is sentenced to death
+ * 
+ * games of all rounds are played by game scheduler (shared queue), its
+ * per thread utilization is printed at the end
  */
 void quickTournament(TchNet** population, int populationCount, int rounds,
                      float timeForMove);
@@ -39,11 +51,77 @@ void quickTournament(TchNet** population, int populationCount, int rounds,
 int game(const TchNet* white, const TchNet* black, float timeBudget);
 
 /**
- * saves population
+ * same as game, but game starts from position start (copied)
  * 
- * @return true if OK, else false
+ * @param start starting position (if NULL, initial position is used)
+ * @param cancel if not NULL and set (by other thread), game is abandoned as
+ *        soon as running search notices it
+ * @param record if not NULL, gets moves (with depth, evaluation and time of
+ *        search), players and result of game
+ * 
+ * @return same as game, 2 if game was cancelled
  */
-bool savePopulation(TchNet** population, int populationCount);
+int gameFrom(const TchNet* white, const TchNet* black, const Tboard* start,
+             float timeBudget, const bool* cancel, TgameRecord* record);
+
+typedef struct TsearchInfo TsearchInfo;
+
+/**
+ * called after every finished depth of search (by thread of search)
+ */
+typedef void (*TsearchDepthCallback)(const TsearchInfo* info, void* data);
+
+/**
+ * limits and results of one search (see minimaxSearch)
+ */
+struct TsearchInfo {
+
+  // limits (0 means no limit), first depth is always finished
+  float seconds;
+  int maxDepth;
+  long maxNodes;
+
+  // cancellation flag (can be NULL), read atomically
+  const bool* cancel;
+
+  // threads searching moves of root (0 or 1 for calling thread only)
+  int threads;
+
+  // optional callback of finished depths (NULL if not used) and its data
+  TsearchDepthCallback onDepth;
+  void* onDepthData;
+
+  // best move and its value (from white`s point of view) in last finished
+  // depth, number of finished depth (in plies)
+  char bestMove[MAX_INP_LEN];
+  float evaluation;
+  int depth;
+
+  // positions visited and wall time of search so far
+  long nodes;
+  double elapsed;
+
+};
+
+
+/**
+ * sets limits of info (no depth, node limit or cancel flag, no callback)
+ */
+void initSearchInfo(TsearchInfo* info, float seconds);
+
+/**
+ * iterative deepening minimax with limits given by info
+ * 
+ * limits and cancel flag are checked every 1024 nodes of every thread
+ * (unfinished depth is thrown away), depth is not started when it probably
+ * wouldn`t finish in time
+ * 
+ * @param net chess network used for evaluation (if NULL, primitiveEval is used)
+ * 
+ * @return depth of finished search, -1 if there is no legal move (bestMove
+ *         is "nomo")
+ */
+int minimaxSearch(Tboard *b, const TchNet* net, TsearchInfo* info);
 
 /**
  * Uses minimax to choose a move.
@@ -57,6 +135,19 @@ bool savePopulation(TchNet** population, int populationCount);
  */
 int minimax(Tboard *b, const TchNet* net, float seconds, char *output);
 
+/**
+ * same as minimax, but search is interrupted when *cancel gets set
+ * 
+ * flag is checked after every move of root (same as time), if search is
+ * cancelled, output is some legal move
+ * 
+ * @param cancel cancellation flag (can be NULL), read atomically
+ * @param evaluation if not NULL, gets value of chosen move in last finished
+ *        depth (from white`s point of view)
+ */
+int minimaxCancellable(Tboard *b, const TchNet* net, float seconds,
+                       const bool* cancel, char *output, float* evaluation);
+
 
 /**
  * recursive part of minimax alg
@@ -70,6 +161,7 @@ int minimax(Tboard *b, const TchNet* net, float seconds, char *output);
  * 
  * @return numerical evaluation of position
  * @note use minimax() instead
+ * @note with net, children of depth 1 nodes are evaluated in batches
  */
 float innerMinimax(Tboard *b, const TchNet* net, int depth, bool isMax, float alfa, float beta);
 
@@ -79,6 +171,11 @@ float innerMinimax(Tboard *b, const TchNet* net, int depth, bool isMax, float al
  */
 void sortPopulation(TchNet** population, float *keys, int populationCount, bool increasing);
 
+/**
+ * randomizes order of indices (same way as shufflePopulationWithKeys)
+ */
+void shuffleIndices(int* indices, int count);
+
 /**
  * randomizes population`s order
  * 
@@ -95,17 +192,41 @@ void sortMoveList(TmoveList* ml, float *keys, bool increasing);
  * returns true if there is a net that can beat primitiveEval
  * 
  * let`s everyone play against primitive and if someone wins as black and white
- * returns true
+ * returns true (all games are played in parallel and cancelled as soon as
+ * someone wins both, see runGauntlet)
  */
 bool canAnyoneBeatPrimitiveEval(TchNet** population, int populationCount);
 
+/**
+ * returns count positions reached by random moves from starting position
+ * 
+ * @param maxMoves max length of random game leading to position
+ */
+Tboard** randomPositions(int count, int maxMoves);
+
 /**
  * returns evaluation of position
  * 
- * if net is null, uses primitiveEval
+ * if net is null, uses primitiveEval, else evaluation is looked up in (and
+ * saved to) evaluation cache of net
  */
 float evaluateBoard(const Tboard* b, const TchNet* net);
 
+/**
+ * fills evaluations by evaluations of count boards
+ * 
+ * boards missing in evaluation cache of net are evaluated together in one
+ * batch (if net is null, uses primitiveEval)
+ */
+void evaluateBoards(Tboard** boards, int count, const TchNet* net,
+                    float* evaluations);
+
+/**
+ * prints hit rate of evaluation caches of all nets (since last call)
+ * and resets their statistics
+ */
+void printEvalCacheStats(void);
+
 /**
  * sum of piece values from fun getPieceValue
  */
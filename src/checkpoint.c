@@ -0,0 +1,157 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "checkpoint.h"
+#include "genome_arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+
+/**
+ * writes checkpoint to opened file
+ */
+static bool fwriteCheckpoint(FILE* out, int generation, uint64_t seed,
+                             const TgenomeArena* arena, TchNet** population,
+                             const float* fitness)
+{
+  int n = arena->netCount;
+  int32_t header[2] = {generation, n};
+  int32_t* order = malloc(n * sizeof(int32_t));
+  float* fitnessOut = calloc(n, sizeof(float));
+  if(order == NULL || fitnessOut == NULL){
+    free(order);
+    free(fitnessOut);
+    return false;
+  }
+
+  for(int i = 0; i < n; ++i){
+    // slot of net is given by position of its genome in block
+    order[i] = (population[i]->genome - arena->block) / arena->genomeSize;
+    if(fitness != NULL){
+      fitnessOut[i] = fitness[i];
+    }
+  }
+
+  bool ok = fwrite(CHECKPOINT_MAGIC, 1, CHECKPOINT_MAGIC_LEN, out) ==
+              CHECKPOINT_MAGIC_LEN &&
+            fwrite(header, sizeof(int32_t), 2, out) == 2 &&
+            fwrite(&seed, sizeof(uint64_t), 1, out) == 1 &&
+            fwrite(order, sizeof(int32_t), n, out) == (size_t)n &&
+            fwrite(fitnessOut, sizeof(float), n, out) == (size_t)n &&
+            fwriteGenomeArena(out, arena);
+
+  free(order);
+  free(fitnessOut);
+  return ok;
+}
+
+bool saveCheckpoint(const char* fileName, int generation, uint64_t seed,
+                    const TgenomeArena* arena, TchNet** population,
+                    const float* fitness)
+{
+  char* tmpName = malloc(strlen(fileName) + 5);
+  if(tmpName == NULL){
+    return false;
+  }
+  sprintf(tmpName, "%s.tmp", fileName);
+
+  FILE* out = fopen(tmpName, "wb");
+  if(out == NULL){
+    free(tmpName);
+    return false;
+  }
+
+  bool ok = fwriteCheckpoint(out, generation, seed, arena, population,
+                             fitness) &&
+            fflush(out) == 0 &&
+            fsync(fileno(out)) == 0;
+  ok = (fclose(out) == 0) && ok;
+
+  // rename is atomic, so crash leaves old or new checkpoint
+  if(ok){
+    ok = rename(tmpName, fileName) == 0;
+  }
+  if(!ok){
+    remove(tmpName);
+  }
+
+  free(tmpName);
+  return ok;
+}
+
+
+Tcheckpoint* loadCheckpoint(const char* fileName)
+{
+  FILE* in = fopen(fileName, "rb");
+  if(in == NULL){
+    return NULL;
+  }
+
+  char magic[CHECKPOINT_MAGIC_LEN];
+  int32_t header[2];
+  uint64_t seed;
+  if(fread(magic, 1, CHECKPOINT_MAGIC_LEN, in) != CHECKPOINT_MAGIC_LEN ||
+     memcmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN) != 0 ||
+     fread(header, sizeof(int32_t), 2, in) != 2 ||
+     fread(&seed, sizeof(uint64_t), 1, in) != 1 ||
+     header[0] < 0 || header[1] < 1){
+    fclose(in);
+    return NULL;
+  }
+
+  int n = header[1];
+  Tcheckpoint* cp = calloc(1, sizeof(Tcheckpoint));
+  if(cp == NULL){
+    fclose(in);
+    return NULL;
+  }
+  cp->generation = header[0];
+  cp->seed = seed;
+  cp->order = malloc(n * sizeof(int));
+  cp->fitness = malloc(n * sizeof(float));
+
+  if(cp->order == NULL || cp->fitness == NULL ||
+     fread(cp->order, sizeof(int32_t), n, in) != (size_t)n ||
+     fread(cp->fitness, sizeof(float), n, in) != (size_t)n ||
+     (cp->arena = freadGenomeArena(in)) == NULL ||
+     cp->arena->netCount != n){
+    fclose(in);
+    freeCheckpoint(cp, true);
+    return NULL;
+  }
+  fclose(in);
+
+  // order must be permutation of slots
+  bool* used = calloc(n, sizeof(bool));
+  bool valid = (used != NULL);
+  for(int i = 0; valid && i < n; ++i){
+    valid = cp->order[i] >= 0 && cp->order[i] < n && !used[cp->order[i]];
+    if(valid){
+      used[cp->order[i]] = true;
+    }
+  }
+  free(used);
+  if(!valid){
+    freeCheckpoint(cp, true);
+    return NULL;
+  }
+
+  return cp;
+}
+
+void freeCheckpoint(Tcheckpoint* checkpoint, bool freeArena)
+{
+  if(freeArena && checkpoint->arena != NULL){
+    freeGenomeArena(checkpoint->arena);
+  }
+  free(checkpoint->order);
+  free(checkpoint->fitness);
+  free(checkpoint);
+}
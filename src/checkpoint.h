@@ -0,0 +1,75 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_CHECKPOINT_H
+#define __MODULE_CHECKPOINT_H
+
+#include "genome_arena.h"
+#include "chess_net.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// default file of checkpoint (written after every generation)
+#define CHECKPOINT_FILE "population/checkpoint.bin"
+
+#define CHECKPOINT_MAGIC "NNCHKPT1"
+#define CHECKPOINT_MAGIC_LEN 8
+
+
+/**
+ * whole state of evolution between two generations
+ */
+typedef struct {
+
+  // next generation to be played
+  int generation;
+
+  // seed of all random decisions of evolution (see rngSeed)
+  uint64_t seed;
+
+  // all nets
+  TgenomeArena* arena;
+
+  // population (order of nets by fitness) is arena->nets[order[i]]
+  int* order;
+
+  // fitness (rating) of population[i] in last tournament (0 for children)
+  float* fitness;
+
+} Tcheckpoint;
+
+
+/**
+ * writes checkpoint atomically
+ *
+ * checkpoint is written to fileName.tmp, synced to disk and renamed to
+ * fileName, so fileName always contains whole old or whole new checkpoint
+ *
+ * @param population permutation of arena->nets
+ * @param fitness fitness of population (NULL means zeros)
+ * @return false if writing failed (old checkpoint is kept)
+ */
+bool saveCheckpoint(const char* fileName, int generation, uint64_t seed,
+                    const TgenomeArena* arena, TchNet** population,
+                    const float* fitness);
+
+/**
+ * reads checkpoint written by saveCheckpoint
+ *
+ * @return checkpoint or NULL if error
+ */
+Tcheckpoint* loadCheckpoint(const char* fileName);
+
+/**
+ * frees checkpoint
+ *
+ * @param freeArena if false, arena is kept (caller took it over)
+ */
+void freeCheckpoint(Tcheckpoint* checkpoint, bool freeArena);
+
+#endif
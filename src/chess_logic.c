@@ -8,6 +8,7 @@
 
 #include "chess_logic.h"
 #include "chess_structs.h"
+#include "logger.h"
 
 #include <math.h>
 #include <time.h>
@@ -109,11 +110,25 @@ void moveBoard(const char *input, Tboard *b)
      b->pieces[from[1]][from[0]] == 'p' ||
      b->pieces[from[1]][from[0]] == 'P')
   {
-    freeArrayOfStrings(b->boringPoss, b->boringMoveCount);
-    b->boringPoss = malloc(0);
+    if(b->arena == NULL){
+      freeArrayOfStrings(b->boringPoss, b->boringMoveCount);
+      b->boringPoss = malloc(0);
+    }
 
     b->boringMoveCount = 0;
 
+  } else if(b->arena != NULL){
+    // positions of board in arena are shared with its parent, so array is
+    // copied (old one is given back by reset of arena)
+    char **boringPoss = searchArenaAlloc(b->arena, (b->boringMoveCount + 1) *
+                                                   sizeof(char*));
+    memcpy(boringPoss, b->boringPoss, b->boringMoveCount * sizeof(char*));
+    b->boringPoss = boringPoss;
+    b->boringPoss[b->boringMoveCount] = searchArenaAlloc(b->arena,
+                                                         POS_STRING_LEN);
+    writePosString(b, b->boringPoss[b->boringMoveCount]);
+    b->boringMoveCount++;
+
   } else {
     b->boringMoveCount++;
 
@@ -121,9 +136,7 @@ void moveBoard(const char *input, Tboard *b)
     b->boringPoss[b->boringMoveCount-1] = malloc(POS_STRING_LEN *
                                                  sizeof(char));
 
-    char *temp = boardToPosString(b);
-    strcpy(b->boringPoss[b->boringMoveCount-1], temp);
-    free(temp);
+    writePosString(b, b->boringPoss[b->boringMoveCount-1]);
   }
 
   if(b->pieces[to[1]][to[0]] != ' ') b->pieceCount--;
@@ -137,16 +150,134 @@ void moveBoard(const char *input, Tboard *b)
 }
 
 
+bool moveToSan(const Tboard* board, const char* move, char* san)
+{
+  Tboard* b = copyBoard(board);
+  TmoveList* ml = initMoveList(16);
+  generateAllPossibleMoves(b, ml);
+
+  // queen promotion is move without promotion char
+  char legalMove[MAX_INP_LEN];
+  strcpy(legalMove, move);
+  if(legalMove[4] == 'Q'){
+    legalMove[4] = '\0';
+  }
+
+  int fromCol = move[0] - 'A', fromRow = '8' - move[1];
+  int toCol = move[2] - 'A', toRow = '8' - move[3];
+  char piece = b->pieces[fromRow][fromCol];
+  char type = tolower(piece);
+
+  bool isLegal = false, isAmbiguous = false, sameCol = false, sameRow = false;
+  for(int i = 0; i < ml->filled; ++i){
+    const char* other = ml->moves[i];
+    if(strcmp(other, legalMove) == 0){
+      isLegal = true;
+    } else if(other[2] == move[2] && other[3] == move[3] &&
+              other[4] == '\0' &&
+              b->pieces['8' - other[1]][other[0] - 'A'] == piece &&
+              (other[0] != move[0] || other[1] != move[1])){
+      isAmbiguous = true;
+      sameCol = sameCol || other[0] == move[0];
+      sameRow = sameRow || other[1] == move[1];
+    }
+  }
+  freeMoveList(ml);
+  if(!isLegal){
+    freeBoard(b);
+    return false;
+  }
+
+  int len = 0;
+  if(type == 'k' && abs(toCol - fromCol) == 2){
+    strcpy(san, (toCol == 6) ? "O-O" : "O-O-O");
+    len = strlen(san);
+  } else {
+    bool isCapture = b->pieces[toRow][toCol] != ' ' ||
+                     (type == 'p' && fromCol != toCol);
+    if(type == 'p'){
+      if(isCapture){
+        san[len++] = tolower(move[0]);
+      }
+    } else {
+      san[len++] = toupper(type);
+      if(isAmbiguous && (!sameCol || !sameRow)){
+        san[len++] = sameCol ? move[1] : tolower(move[0]);
+      } else if(isAmbiguous){
+        san[len++] = tolower(move[0]);
+        san[len++] = move[1];
+      }
+    }
+    if(isCapture){
+      san[len++] = 'x';
+    }
+    san[len++] = tolower(move[2]);
+    san[len++] = move[3];
+    if(type == 'p' && (move[3] == '1' || move[3] == '8')){
+      san[len++] = '=';
+      san[len++] = (move[4] == '\0') ? 'Q' : move[4];
+    }
+  }
+
+  // check and mate
+  moveBoard(legalMove, b);
+  int result = getResult(b);
+  int kingPos[2];
+  getPieceLocation(b, (b->move%2 == 0) ? 'k' : 'K', kingPos);
+  if(result == 1 || result == -1){
+    san[len++] = '#';
+  } else if(gotChecked(b, kingPos)){
+    san[len++] = '+';
+  }
+  san[len] = '\0';
+
+  freeBoard(b);
+  return true;
+}
+
+bool sanToMove(const Tboard* board, const char* san, char* move)
+{
+  // check, mate and annotation suffixes are ignored
+  char wanted[16];
+  int len = 0;
+  for(; san[len] != '\0' && len < 15 && strchr("+#!?", san[len]) == NULL;
+      len++){
+    wanted[len] = (san[len] == '0') ? 'O' : san[len];
+  }
+  wanted[len] = '\0';
+
+  Tboard* b = copyBoard(board);
+  TmoveList* ml = initMoveList(16);
+  generateAllPossibleMoves(b, ml);
+
+  bool found = false;
+  char candidate[16];
+  for(int i = 0; i < ml->filled && !found; i++){
+    if(!moveToSan(b, ml->moves[i], candidate)){
+      continue;
+    }
+    candidate[strcspn(candidate, "+#")] = '\0';
+    if(strcmp(candidate, wanted) == 0){
+      strcpy(move, ml->moves[i]);
+      found = true;
+    }
+  }
+
+  freeMoveList(ml);
+  freeBoard(b);
+  return found;
+}
+
+
 int getResultFaster(Tboard *b, TmoveList *ml)
 {
-  char *temp = boardToPosString(b);
+  char temp[POS_STRING_LEN];
+  writePosString(b, temp);
   if(b->boringMoveCount >= MAX_BORING_MOVES ||
      isStringTwiceInArrayOfStrings(temp, b->boringPoss, b->boringMoveCount))
   {
-    free(temp);
     return 0;
   }
-  free(temp);
 
   if(ml->filled == 0){
     int kingPos[2] = {0, 0};
@@ -211,24 +342,22 @@ void generateAllPossibleMoves(Tboard * b, TmoveList *ml)
   if(b->move % 2 == 0) color = 'a';
   else color = 'A';
 
-  int *kingPos = malloc(2 * sizeof(int));
+  int kingPos[2];
   getPieceLocation(b, color + ('k' - 'a'), kingPos);
   if(!(kingPos[0] >= 0 && kingPos[0] <= 7 &&
        kingPos[1] >= 0 && kingPos[1] <= 7)){
-    free(kingPos);
 
-    FILE* errLog = fopen("kingPos_error_log.txt", "a");
-    if(errLog == NULL){
-      return;
+    if(isLogLevelEnabled(LOG_ERROR)){
+      char* fen = boardToFen(b);
+      logEvent(LOG_ERROR, "king_missing", "fen=\"%s\" last_move=%s",
+               (fen != NULL) ? fen : "?", b->lastMove);
+      free(fen);
     }
-    fprintf(errLog, "kingPos is not valid in fun generateAllPossibleMoves\n");
-    fprintf(errLog, "posString: %s\n", boardToPosString(b));
-    fprintf(errLog, "last move: %s\n", b->lastMove);
-    fclose(errLog);
     return;
   }
   if(gotChecked(b, kingPos)){
-    TmoveList *tempMl = initMoveList(8);
+    TmoveList *tempMl = (ml->arena != NULL) ?
+                        initMoveListInArena(8, ml->arena) : initMoveList(8);
     bool buffer[2];
 
     //temporarely disable castling ability
@@ -263,7 +392,6 @@ void generateAllPossibleMoves(Tboard * b, TmoveList *ml)
       }
     }
   }
-  free(kingPos);
 }
 
 
@@ -856,23 +984,20 @@ bool doesMoveBlockCheck(const Tboard* b,
   char oppColor = oppositeColor(b->pieces[kingPos[1]][kingPos[0]] -
                                 ('k' - 'a'));
 
-  Tboard *copy = copyBoard(b);
+  // only pieces are changed, so copy shares everything else with b
+  Tboard copy = *b;
+  Tboard *c = &copy;
 
   //make move
-  if(isEnPassant(move, copy)){
-    copy->pieces['8' - copy->lastMove[3]][copy->lastMove[2] - 'A'] = ' ';
+  if(isEnPassant(move, c)){
+    c->pieces['8' - c->lastMove[3]][c->lastMove[2] - 'A'] = ' ';
   }
-  copy->pieces['8' - move[3]]
-              [move[2] - 'A'] = copy->pieces['8' - move[1]]
-                                            [move[0] - 'A'];
-  copy->pieces['8' - move[1]][move[0] - 'A'] = ' ';
+  c->pieces['8' - move[3]]
+           [move[2] - 'A'] = c->pieces['8' - move[1]]
+                                      [move[0] - 'A'];
+  c->pieces['8' - move[1]][move[0] - 'A'] = ' ';
 
-  if(isAttacked(copy, oppColor, kingPos)){
-    freeBoard(copy);
-    return false;
-  }
-  freeBoard(copy);
-  return true;
+  return !isAttacked(c, oppColor, kingPos);
 }
 
 
@@ -1454,17 +1579,12 @@ bool willBeAttacked(const Tboard *b,
                     const int origin[2],
                     const int dest[2])
 {
-  Tboard *copy = copyBoard(b);
+  // only pieces are changed, so copy shares everything else with b
+  Tboard copy = *b;
 
-  copy->pieces[origin[1]][origin[0]] = ' ';
+  copy.pieces[origin[1]][origin[0]] = ' ';
 
-  if(isAttacked(copy, color, dest)){
-    freeBoard(copy);
-    return true;
-  } else {
-    freeBoard(copy);
-    return false;
-  }
+  return isAttacked(&copy, color, dest);
 }
 
 
@@ -129,6 +129,28 @@ bool isInputValid(const char* input, Tboard* b);
  */
 void moveBoard(const char* move, Tboard* b);
 
+/**
+ * writes move in standard algebraic notation (ex. "Nbd2", "exd6",
+ * "e8=Q+", "O-O")
+ * 
+ * @param b pointer to board (isn't modified)
+ * @param move string representing move (ex. E2E4, E7E8N)
+ * @param san gets filled (at least 16 chars)
+ * 
+ * @return false if move is not legal in b
+ */
+bool moveToSan(const Tboard* b, const char* move, char* san);
+
+/**
+ * finds legal move written in standard algebraic notation
+ * 
+ * @param san move like "Nf3", "exd5+", "O-O" (suffixes +#!? are ignored)
+ * @param move gets filled (length == MAX_INP_LEN)
+ * 
+ * @return false if there is no such legal move
+ */
+bool sanToMove(const Tboard* b, const char* san, char* move);
+
 /**
  * returns true if move is diagonnaly by pawn and lands on empty square
  * 
@@ -7,40 +7,145 @@
 #include "chess_net.h"
 #include "fcnn.h"
 #include "neuron.h"
+#include "search_arena.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <ctype.h>
+#include <sys/mman.h>
 
-#define PREPR_NEURONS_COUNT 64  // 64 pieces
-#define PREPR_NEURON_INP_COUNT 12  // 12 possible pieces
+// layout of genome: preprocessing weights, their biases, table of their
+// outputs and params of fcnn (all parts are multiples of DENSE_LANES)
+#define GENOME_PREPR_WEIGHTS 0
+#define GENOME_PREPR_BIASES \
+  (GENOME_PREPR_WEIGHTS + PREPR_NEURONS_COUNT * PREPR_NEURON_INP_COUNT)
+#define GENOME_PREPR_OUTPUTS (GENOME_PREPR_BIASES + PREPR_NEURONS_COUNT)
+#define GENOME_FCNN_PARAMS \
+  (GENOME_PREPR_OUTPUTS + PREPR_NEURONS_COUNT * CHNET_PIECE_INDEX_COUNT)
 
-TchNet* initRandChNet(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount)
+
+int chNetGenomeSize(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount)
+{
+  return GENOME_FCNN_PARAMS + fcnnParamCount(fcnnLayerCount,
+                                             fcnnNeuronsInLayersCount);
+}
+
+TchNet* initChNetView(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount,
+                      Tactivation activation, float* genome)
 {
   if(fcnnNeuronsInLayersCount[0] != PREPR_NEURONS_COUNT){
     return NULL;
   }
-  
+
   TchNet* net = malloc(sizeof(TchNet));
-  net->preprocessingNeurons = malloc(PREPR_NEURONS_COUNT * sizeof(Tneuron*));
-  for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
-    net->preprocessingNeurons[i] = initRandNeuron(PREPR_NEURON_INP_COUNT,
-                                                  MIN_RAND_WEIGHT,
-                                                  MAX_RAND_WEIGHT);
+  net->ownsGenome = (genome == NULL);
+  net->fileMap = NULL;
+  net->fileMapSize = 0;
+  net->id = -1;
+  if(net->ownsGenome){
+    int size = chNetGenomeSize(fcnnLayerCount, fcnnNeuronsInLayersCount);
+    genome = aligned_alloc(DENSE_ALIGN, size * sizeof(float));
+    memset(genome, 0, size * sizeof(float));
   }
+  net->genome = genome;
 
-  net->fcnn = initRandfcnn(fcnnLayerCount, fcnnNeuronsInLayersCount);
+  net->preprWeights = genome + GENOME_PREPR_WEIGHTS;
+  net->preprBiases = genome + GENOME_PREPR_BIASES;
+  net->preprOutputs = genome + GENOME_PREPR_OUTPUTS;
+  net->fcnn = initfcnnView(fcnnLayerCount, fcnnNeuronsInLayersCount,
+                           activation, genome + GENOME_FCNN_PARAMS);
+  net->evalCache = initEvalCache(EVAL_CACHE_BITS);
+  net->inputMode = CHNET_INPUT_ABSOLUTE;
 
   return net;
 }
 
-void freeChNet(TchNet* net)
+void chNetGenomeChanged(TchNet* net)
+{
+  for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
+    Tneuron neuron = {
+      PREPR_NEURON_INP_COUNT,
+      net->preprWeights + i*PREPR_NEURON_INP_COUNT,
+      net->preprBiases[i]
+    };
+
+    for(int k = 0; k < CHNET_PIECE_INDEX_COUNT; ++k){
+      float preprNeuronIputs[PREPR_NEURON_INP_COUNT] = {0};
+      if(k != CHNET_EMPTY_SQUARE){
+        preprNeuronIputs[k] = 1.0;
+      }
+      net->preprOutputs[i*CHNET_PIECE_INDEX_COUNT + k] =
+        calcNeuronOutputAct(&neuron, preprNeuronIputs, net->fcnn->activation);
+    }
+  }
+
+  if(net->evalCache != NULL){
+    clearEvalCache(net->evalCache);
+  }
+}
+
+
+/**
+ * randomizes weights and bias of preprocessing neuron (same range as
+ * initRandNeuron)
+ */
+static void randomizePreprNeuron(TchNet* net, int index, Trng* rng)
+{
+  for(int k = 0; k < PREPR_NEURON_INP_COUNT; ++k){
+    net->preprWeights[index*PREPR_NEURON_INP_COUNT + k] =
+      rngFloat(rng, MIN_RAND_WEIGHT, MAX_RAND_WEIGHT);
+  }
+  net->preprBiases[index] = rngFloat(rng, MIN_RAND_WEIGHT, MAX_RAND_WEIGHT);
+}
+
+/**
+ * copies weights and bias of preprocessing neuron from origin to dest
+ */
+static void copyPreprNeuron(TchNet* dest, const TchNet* origin, int index)
+{
+  memcpy(dest->preprWeights + index*PREPR_NEURON_INP_COUNT,
+         origin->preprWeights + index*PREPR_NEURON_INP_COUNT,
+         PREPR_NEURON_INP_COUNT * sizeof(float));
+  dest->preprBiases[index] = origin->preprBiases[index];
+}
+
+void randomizeChNet(TchNet* net, Trng* rng)
 {
   for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
-    freeNeuron(net->preprocessingNeurons[i]);
+    randomizePreprNeuron(net, i, rng);
+  }
+  randomizefcnn(net->fcnn, rng);
+  chNetGenomeChanged(net);
+}
+
+
+TchNet* initRandChNet(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount,
+                      Tactivation activation)
+{
+  TchNet* net = initChNetView(fcnnLayerCount, fcnnNeuronsInLayersCount,
+                              activation, NULL);
+  if(net == NULL){
+    return NULL;
   }
-  free(net->preprocessingNeurons);
 
+  Trng rng;
+  rngSeed(&rng, rand(), 0, 0);
+  randomizeChNet(net, &rng);
+
+  return net;
+}
+
+void freeChNet(TchNet* net)
+{
   freefcnn(net->fcnn);
+  freeEvalCache(net->evalCache);
+  if(net->ownsGenome){
+    free(net->genome);
+  }
+  if(net->fileMap != NULL){
+    munmap(net->fileMap, net->fileMapSize);
+  }
   
   free(net);
 }
@@ -52,8 +157,17 @@ void printChNet(const TchNet* n)
 
 void fprintChNet(FILE* out, const TchNet* n)
 {
+  // default mode is not written, so old files stay same
+  if(n->inputMode != CHNET_INPUT_ABSOLUTE){
+    fprintf(out, "%s\n", chNetInputName(n->inputMode));
+  }
   for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
-    fprintNeuron(out, n->preprocessingNeurons[i]);
+    Tneuron neuron = {
+      PREPR_NEURON_INP_COUNT,
+      n->preprWeights + i*PREPR_NEURON_INP_COUNT,
+      n->preprBiases[i]
+    };
+    fprintNeuron(out, &neuron);
   }
   fprintfcnn(out, n->fcnn);
 }
@@ -65,105 +179,294 @@ TchNet* getChNet(void)
 
 TchNet* fgetChNet(FILE* in)
 {
-  TchNet* net = malloc(sizeof(TchNet));
-  net->preprocessingNeurons = malloc(PREPR_NEURONS_COUNT * sizeof(Tneuron*));
-  for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
-    
-    net->preprocessingNeurons[i] = fgetNeuron(in);
-    
-    if(net->preprocessingNeurons[i] == NULL){
-      for(int j = 0; j < i; ++j){
-        freeNeuron(net->preprocessingNeurons[j]);
+  TchNetInput inputMode = CHNET_INPUT_ABSOLUTE;
+  if(fscanf(in, " ") == 0){
+    int c = fgetc(in);
+    ungetc(c, in);
+    if(isalpha(c)){
+      char name[32];
+      if(fscanf(in, "%31s", name) != 1 ||
+         (inputMode = chNetInputFromName(name)) == CHNET_INPUT_COUNT){
+        return NULL;
       }
-      free(net->preprocessingNeurons);
-      free(net);
+    }
+  }
 
+  // size of genome is known only after fcnn is read
+  float preprWeights[PREPR_NEURONS_COUNT * PREPR_NEURON_INP_COUNT];
+  float preprBiases[PREPR_NEURONS_COUNT];
+  for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
+    Tneuron* neuron = fgetNeuron(in);
+    if(neuron == NULL){
       return NULL;
     }
+    if(neuron->inputCount != PREPR_NEURON_INP_COUNT){
+      freeNeuron(neuron);
+      return NULL;
+    }
+    memcpy(preprWeights + i*PREPR_NEURON_INP_COUNT, neuron->weights,
+           PREPR_NEURON_INP_COUNT * sizeof(float));
+    preprBiases[i] = neuron->bias;
+    freeNeuron(neuron);
+  }
+
+  Tfcnn* fcnn = fgetfcnn(in);
+  if(fcnn == NULL){
+    return NULL;
+  }
+
+  TchNet* net = initChNetView(fcnn->layerCount, fcnn->neuronsInLayersCount,
+                              fcnn->activation, NULL);
+  if(net == NULL){
+    freefcnn(fcnn);
+    return NULL;
+  }
+  memcpy(net->preprWeights, preprWeights, sizeof(preprWeights));
+  memcpy(net->preprBiases, preprBiases, sizeof(preprBiases));
+  memcpy(net->fcnn->params, fcnn->params,
+         fcnnParamCount(fcnn->layerCount, fcnn->neuronsInLayersCount) *
+         sizeof(float));
+  freefcnn(fcnn);
+
+  net->inputMode = inputMode;
+  chNetGenomeChanged(net);
+
+  return net;
+}
+
+int chNetPieceIndex(char piece)
+{
+  switch(piece) {
+    case 'p': return 0;
+    case 'P': return 1;
+    case 'k': return 2;
+    case 'K': return 3;
+    case 'n': return 4;
+    case 'N': return 5;
+    case 'b': return 6;
+    case 'B': return 7;
+    case 'r': return 8;
+    case 'R': return 9;
+    case 'q': return 10;
+    case 'Q': return 11;
+    case ' ': return CHNET_EMPTY_SQUARE;
+    default:  return -1;
+  }
+}
+
+/**
+ * piece index of every char, unknown chars are empty squares
+ */
+static uint8_t pieceIndexTable[256];
+
+__attribute__((constructor))
+static void initPieceIndexTable(void)
+{
+  for(int c = 0; c < 256; ++c){
+    int k = chNetPieceIndex((char)c);
+    pieceIndexTable[c] = (k < 0) ? CHNET_EMPTY_SQUARE : k;
+  }
+}
+
+void chNetEncodeBoard(const Tboard* b, uint8_t* pieceIndices)
+{
+  for(int i = 0; i < 8; ++i){
+    for(int j = 0; j < 8; ++j){
+      pieceIndices[i*8 + j] = pieceIndexTable[(unsigned char)b->pieces[i][j]];
+    }
   }
+}
+
+/**
+ * piece index of same piece of other color
+ */
+static const uint8_t swappedPieceIndex[CHNET_PIECE_INDEX_COUNT] = {
+  1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, CHNET_EMPTY_SQUARE
+};
 
-  net->fcnn = fgetfcnn(in);
+bool chNetEncodeBoardForNet(const TchNet* net, const Tboard* b,
+                            uint8_t* pieceIndices)
+{
+  // even move -> white to move
+  if(net->inputMode != CHNET_INPUT_SIDE_TO_MOVE || b->move % 2 == 0){
+    chNetEncodeBoard(b, pieceIndices);
+    return false;
+  }
 
-  if(net->fcnn == NULL){
-    for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
-      freeNeuron(net->preprocessingNeurons[i]);
+  for(int i = 0; i < 8; ++i){
+    for(int j = 0; j < 8; ++j){
+      uint8_t k = pieceIndexTable[(unsigned char)b->pieces[i][j]];
+      pieceIndices[(7 - i)*8 + j] = swappedPieceIndex[k];
     }
-    free(net->preprocessingNeurons);
+  }
+  return true;
+}
 
-    free(net);
+float chNetFlipEvaluation(float evaluation)
+{
+  return 1.0f - evaluation;
+}
 
-    return NULL;
+static const char* inputModeNames[CHNET_INPUT_COUNT] = {
+  "absolute", "side_to_move"
+};
+
+const char* chNetInputName(TchNetInput mode)
+{
+  if(mode < CHNET_INPUT_ABSOLUTE || mode >= CHNET_INPUT_COUNT){
+    return "unknown";
   }
+  return inputModeNames[mode];
+}
 
-  return net;
+TchNetInput chNetInputFromName(const char* name)
+{
+  for(int i = 0; i < CHNET_INPUT_COUNT; ++i){
+    if(strcmp(name, inputModeNames[i]) == 0){
+      return i;
+    }
+  }
+  return CHNET_INPUT_COUNT;
 }
 
-float chNetPredict(const TchNet* net, const char* posString)
+/**
+ * fills pieceIndices by piece indices of posString
+ * 
+ * @return false if posString contains invalid char, else true
+ */
+static bool encodePosString(const char* posString, uint8_t* pieceIndices)
 {
-  int i;
-  float* fcnnInputs = malloc(PREPR_NEURONS_COUNT * sizeof(float));
-  
-  for(i = 0; i < PREPR_NEURONS_COUNT; ++i){
-    float* preprNeuronIputs = calloc(PREPR_NEURON_INP_COUNT, sizeof(float));
-    
-    switch(posString[i]) {
-      case 'p': preprNeuronIputs[0] = 1.0; break;
-      case 'P': preprNeuronIputs[1] = 1.0; break;
-      case 'k': preprNeuronIputs[2] = 1.0; break;
-      case 'K': preprNeuronIputs[3] = 1.0; break;
-      case 'n': preprNeuronIputs[4] = 1.0; break;
-      case 'N': preprNeuronIputs[5] = 1.0; break;
-      case 'b': preprNeuronIputs[6] = 1.0; break;
-      case 'B': preprNeuronIputs[7] = 1.0; break;
-      case 'r': preprNeuronIputs[8] = 1.0; break;
-      case 'R': preprNeuronIputs[9] = 1.0; break;
-      case 'q': preprNeuronIputs[10]= 1.0; break;
-      case 'Q': preprNeuronIputs[11]= 1.0; break;
-      case ' ': break;
-
-      case '\0':
-      default:
-        free(fcnnInputs);
-        free(preprNeuronIputs);
-        return NAN;
+  for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
+    int pieceIndex = chNetPieceIndex(posString[i]);
+    if(pieceIndex < 0){
+      return false;
     }
+    pieceIndices[i] = pieceIndex;
+  }
+  return true;
+}
 
+/**
+ * fills fcnnInputs by outputs of preprocessing neurons
+ */
+static void preprocessIndices(const TchNet* net, const uint8_t* pieceIndices,
+                              float* fcnnInputs)
+{
+  for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
+    fcnnInputs[i] =
+      net->preprOutputs[i*CHNET_PIECE_INDEX_COUNT + pieceIndices[i]];
+  }
+}
+
+float chNetPredictIndices(const TchNet* net, const uint8_t* pieceIndices)
+{
+  float fcnnInputs[PREPR_NEURONS_COUNT];
+  preprocessIndices(net, pieceIndices, fcnnInputs);
 
-    fcnnInputs[i] = calcNeuronOutput(net->preprocessingNeurons[i],
-                                     preprNeuronIputs);
-    free(preprNeuronIputs);
+  int outputCount = net->fcnn->neuronsInLayersCount[net->fcnn->layerCount-1];
+  if(outputCount > 1){
+    float* temptemp = fcnnPredict(net->fcnn, fcnnInputs);
+    float temp = temptemp[0];
+    free(temptemp);
+    return temp;
   }
 
+  float output;
+  fcnnForward(net->fcnn, fcnnInputs, &output);
+  return output;
+}
 
-  float* temptemp = fcnnPredict(net->fcnn, fcnnInputs);
-  float temp = temptemp[0];
-  free(fcnnInputs);
-  free(temptemp);
-  return temp;
+float chNetPredict(const TchNet* net, const char* posString)
+{
+  uint8_t pieceIndices[PREPR_NEURONS_COUNT];
+  if(!encodePosString(posString, pieceIndices)){
+    return NAN;
+  }
+  return chNetPredictIndices(net, pieceIndices);
 }
 
 
-TchNet* chNetSex(const TchNet* dad, const TchNet* mum, int mutationRareness)
+void chNetPredictIndicesBatch(const TchNet* net, const uint8_t* pieceIndices,
+                              int count, float* outputs)
+{
+  TsearchArena* arena = getThreadSearchArena();
+  TsearchArenaMark mark = searchArenaMark(arena);
+  float* fcnnInputs = searchArenaAlloc(arena, count * PREPR_NEURONS_COUNT *
+                                              sizeof(float));
+  for(int i = 0; i < count; ++i){
+    preprocessIndices(net, pieceIndices + i*PREPR_NEURONS_COUNT,
+                      fcnnInputs + i*PREPR_NEURONS_COUNT);
+  }
+
+  int outputCount = net->fcnn->neuronsInLayersCount[net->fcnn->layerCount-1];
+  float* fcnnOutputs = searchArenaAlloc(arena, count * outputCount *
+                                               sizeof(float));
+  fcnnPredictBatch(net->fcnn, fcnnInputs, count, fcnnOutputs);
+
+  for(int i = 0; i < count; ++i){
+    outputs[i] = fcnnOutputs[i*outputCount];
+  }
+
+  searchArenaReset(arena, mark);
+}
+
+void chNetPredictBatch(const TchNet* net, char** posStrings, int count,
+                       float* outputs)
+{
+  // invalid positions are evaluated as empty boards and replaced by NAN
+  uint8_t* pieceIndices = calloc(count * PREPR_NEURONS_COUNT, 1);
+  bool* isValid = malloc(count * sizeof(bool));
+
+  for(int i = 0; i < count; ++i){
+    isValid[i] = encodePosString(posStrings[i],
+                                 pieceIndices + i*PREPR_NEURONS_COUNT);
+    if(!isValid[i]){
+      memset(pieceIndices + i*PREPR_NEURONS_COUNT, CHNET_EMPTY_SQUARE,
+             PREPR_NEURONS_COUNT);
+    }
+  }
+
+  chNetPredictIndicesBatch(net, pieceIndices, count, outputs);
+
+  for(int i = 0; i < count; ++i){
+    if(!isValid[i]){
+      outputs[i] = NAN;
+    }
+  }
+
+  free(isValid);
+  free(pieceIndices);
+}
+
+
+TchNet* chNetSex(const TchNet* dad, const TchNet* mum, int mutationRareness,
+                 Trng* rng)
+{
+  TchNet* baby = initChNetView(dad->fcnn->layerCount,
+                               dad->fcnn->neuronsInLayersCount,
+                               dad->fcnn->activation, NULL);
+  chNetSexInto(baby, dad, mum, mutationRareness, rng);
+
+  return baby;
+}
+
+void chNetSexInto(TchNet* baby, const TchNet* dad, const TchNet* mum,
+                  int mutationRareness, Trng* rng)
 {
-  TchNet* baby = malloc(sizeof(TchNet));
-  baby->preprocessingNeurons = malloc(PREPR_NEURONS_COUNT * sizeof(Tneuron*));
-  
   // preprocessing neurons
   for(int i = 0; i < PREPR_NEURONS_COUNT; ++i){
-    if(mutationRareness > 0 && rand() > (RAND_MAX / mutationRareness)){
-      baby->preprocessingNeurons[i] = initRandNeuron(PREPR_NEURON_INP_COUNT,
-                                              MIN_RAND_WEIGHT,
-                                              MAX_RAND_WEIGHT);
+    if(mutationRareness > 0 && rngUnit(rng) > 1.0f / mutationRareness){
+      randomizePreprNeuron(baby, i, rng);
     } else {
-      if(rand() > RAND_MAX/2){
-        baby->preprocessingNeurons[i] = cpyNeuron(dad->preprocessingNeurons[i]);
+      if(rngUnit(rng) > 0.5f){
+        copyPreprNeuron(baby, dad, i);
       } else {
-        baby->preprocessingNeurons[i] = cpyNeuron(mum->preprocessingNeurons[i]);
+        copyPreprNeuron(baby, mum, i);
       }
     }
   }
 
-  baby->fcnn = fcnnSex(dad->fcnn, mum->fcnn, mutationRareness);
-
-  return baby;
+  fcnnSexInto(baby->fcnn, dad->fcnn, mum->fcnn, mutationRareness, rng);
+  baby->inputMode = dad->inputMode;
+  chNetGenomeChanged(baby);
 }
@@ -9,17 +9,86 @@
 
 #include "neuron.h"
 #include "fcnn.h"
+#include "rng.h"
+#include "eval_cache.h"
+#include "chess_structs.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#define PREPR_NEURONS_COUNT 64  // 64 pieces
+#define PREPR_NEURON_INP_COUNT 12  // 12 possible pieces
+
+// index of empty square returned by chNetPieceIndex
+#define CHNET_EMPTY_SQUARE PREPR_NEURON_INP_COUNT
+
+// possible inputs of preprocessing neuron (12 pieces + empty square)
+#define CHNET_PIECE_INDEX_COUNT (PREPR_NEURON_INP_COUNT + 1)
+
+/**
+ * how position is shown to net
+ */
+typedef enum {
+  // pieces as they are on board, net evaluates from white`s view
+  CHNET_INPUT_ABSOLUTE = 0,
+
+  // if black is to move, board is mirrored and colors are swapped, so net
+  // always evaluates from view of side to move
+  CHNET_INPUT_SIDE_TO_MOVE,
+
+  CHNET_INPUT_COUNT
+} TchNetInput;
 
 typedef struct {
 
-  // first layer of neurons acting as more complex inputs of fcnn
-  Tneuron** preprocessingNeurons;
+  /**
+   * weights of preprocessing neurons (first layer of neurons acting as
+   * more complex inputs of fcnn), one neuron for every square
+   *
+   * weight of k-th input of neuron of square s is
+   * preprWeights[s*PREPR_NEURON_INP_COUNT + k]
+   */
+  float* preprWeights;
+
+  // preprBiases[s] is bias of neuron of square s
+  float* preprBiases;
 
   // fully connected neural net
   Tfcnn* fcnn;
 
+  /**
+   * output of preprocessing neuron of every square for every piece
+   * (computed from preprWeights by chNetGenomeChanged)
+   *
+   * preprOutputs[square*CHNET_PIECE_INDEX_COUNT + pieceIndex]
+   */
+  float* preprOutputs;
+
+  // evaluations of recently seen positions (NULL if it couldn`t be allocated)
+  // keyed by encoded (possibly mirrored) position
+  TevalCache* evalCache;
+
+  // how boards are encoded for this net
+  TchNetInput inputMode;
+
+  /**
+   * one aligned block (chNetGenomeSize floats) holding everything above:
+   * preprWeights, preprBiases, preprOutputs and params of fcnn
+   */
+  float* genome;
+
+  // false if genome belongs to someone else (ex. genome arena)
+  bool ownsGenome;
+
+  // mapping of file holding genome (NULL if genome is not mapped),
+  // unmapped by freeChNet
+  void* fileMap;
+  size_t fileMapSize;
+
+  // slot of net in genome arena (-1 if net is not in arena), used to
+  // identify players in game log
+  int id;
+
 } TchNet;
 
 
@@ -28,11 +97,47 @@ typedef struct {
  * 
  * returns NULL if error
  * 
+ * @param activation activation of all neurons (preprocessing ones too)
+ * 
  * @note (fcnnNeuronsInLayersCount[0] != 64) -> return NULL
+ * @note generator of weights is seeded by rand()
  */
-TchNet* initRandChNet(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount);
+TchNet* initRandChNet(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount,
+                      Tactivation activation);
 
 
+/**
+ * returns number of floats in genome of net with given fcnn
+ * (divisible by DENSE_LANES)
+ */
+int chNetGenomeSize(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount);
+
+/**
+ * returns chNet whose weights and biases are in genome
+ * 
+ * returns NULL if error (same as initRandChNet)
+ * 
+ * @param genome chNetGenomeSize floats aligned to DENSE_ALIGN (not freed by
+ *        freeChNet), if NULL, new zeroed genome owned by net is allocated
+ * 
+ * @note genome is not changed, after it is filled, chNetGenomeChanged must
+ * be called
+ */
+TchNet* initChNetView(int fcnnLayerCount, const int* fcnnNeuronsInLayersCount,
+                      Tactivation activation, float* genome);
+
+/**
+ * recomputes preprOutputs and clears evaluation cache
+ * 
+ * must be called after any change of weights or biases of net
+ */
+void chNetGenomeChanged(TchNet* net);
+
+/**
+ * sets all weights and biases to random values from rng
+ */
+void randomizeChNet(TchNet* net, Trng* rng);
+
 void freeChNet(TchNet* net);
 
 
@@ -75,11 +180,92 @@ TchNet* fgetChNet(FILE* in);
 float chNetPredict(const TchNet* net, const char* posString);
 
 
+/**
+ * same as chNetPredict for count positions at once
+ * 
+ * all positions go through each layer together, so this is much faster
+ * than count calls of chNetPredict
+ * 
+ * @param outputs gets filled by count evaluations
+ */
+void chNetPredictBatch(const TchNet* net, char** posStrings, int count,
+                       float* outputs);
+
+/**
+ * same as chNetPredict, but position is given by piece indices
+ *
+ * @param pieceIndices 64 values from chNetPieceIndex (not checked),
+ *        in same order as posString (see chNetEncodeBoard)
+ */
+float chNetPredictIndices(const TchNet* net, const uint8_t* pieceIndices);
+
+/**
+ * same as chNetPredictBatch, but positions are given by piece indices
+ *
+ * @param pieceIndices count*64 values, i-th position starts at
+ *        pieceIndices[i*64]
+ */
+void chNetPredictIndicesBatch(const TchNet* net, const uint8_t* pieceIndices,
+                              int count, float* outputs);
+
+/**
+ * fills 64 pieceIndices by chNetPieceIndex of every square of board
+ *
+ * unknown chars are encoded as empty squares
+ */
+void chNetEncodeBoard(const Tboard* b, uint8_t* pieceIndices);
+
+/**
+ * fills 64 pieceIndices by encoding of board given by inputMode of net
+ *
+ * @return true if board was mirrored (black is to move in
+ *         CHNET_INPUT_SIDE_TO_MOVE mode), then evaluation of net is from
+ *         black`s view and must be flipped by chNetFlipEvaluation
+ */
+bool chNetEncodeBoardForNet(const TchNet* net, const Tboard* b,
+                            uint8_t* pieceIndices);
+
+/**
+ * returns evaluation from view of other side (outputs of net are in [0, 1])
+ */
+float chNetFlipEvaluation(float evaluation);
+
+/**
+ * returns name of input mode (ex. "side_to_move")
+ */
+const char* chNetInputName(TchNetInput mode);
+
+/**
+ * returns input mode with name or CHNET_INPUT_COUNT if there is none
+ */
+TchNetInput chNetInputFromName(const char* name);
+
+/**
+ * returns index of preprocessing neuron input that is set to 1 for piece
+ * 
+ * @param piece ['p', 'P', 'k', 'K', 'n', 'N', 'b', 'B', 'r', 'R', 'q', 'Q', ' ']
+ * 
+ * @return 0..11 for pieces, CHNET_EMPTY_SQUARE for ' ', -1 for other chars
+ */
+int chNetPieceIndex(char piece);
+
 /**
  * returns baby of mum and dad in parameters
  * 
  * @param mutationRareness 1 in $(mutationRareness) neurons gets randomized
+ * @param rng generator of all random decisions (and new weights), same rng
+ *        state gives same baby
+ */
+TchNet* chNetSex(const TchNet* dad, const TchNet* mum, int mutationRareness,
+                 Trng* rng);
+
+/**
+ * same as chNetSex, but baby is written to existing net (of same size),
+ * so no memory is allocated
+ * 
+ * @note baby must not be dad or mum
  */
-TchNet* chNetSex(const TchNet* dad, const TchNet* mum, int mutationRareness);
+void chNetSexInto(TchNet* baby, const TchNet* dad, const TchNet* mum,
+                  int mutationRareness, Trng* rng);
 
 #endif
\ No newline at end of file
@@ -7,7 +7,9 @@
  */
 
 #include "chess_structs.h"
+#include "chess_logic.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -27,6 +29,7 @@ Tboard* initBoard()
   b->boringMoveCount = 0;
   b->boringPoss = malloc(0);
   b->pieceCount = 32;
+  b->arena = NULL;
 
   char temp[8][8] = {
     {'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'},
@@ -65,6 +68,7 @@ Tboard* copyBoard(const Tboard *input)
   }
 
   b->pieceCount = input->pieceCount;
+  b->arena = NULL;
 
   for (int i = 0; i < 8; i++){
     for (int j = 0; j < 8; j++){
@@ -75,54 +79,63 @@ Tboard* copyBoard(const Tboard *input)
   return b;
 }
 
-Tboard* fenToBoard(char *fen)
+Tboard* copyBoardToArena(const Tboard *input, TsearchArena* arena)
+{
+  Tboard *b = searchArenaAlloc(arena, sizeof(Tboard));
+  *b = *input;
+  b->arena = arena;
+
+  b->lastMove = searchArenaAlloc(arena, MAX_INP_LEN * sizeof(char));
+  strcpy(b->lastMove, input->lastMove);
+
+  // strings of positions are never changed, only array is copied
+  b->boringPoss = searchArenaAlloc(arena, b->boringMoveCount *
+                                          sizeof(char*));
+  memcpy(b->boringPoss, input->boringPoss,
+         b->boringMoveCount * sizeof(char*));
+
+  return b;
+}
+
+Tboard* fenToBoard(const char *fen)
 {
-  int fenLen = strlen(fen);
-  
   Tboard *b = malloc(sizeof(Tboard));
   int index = 0;
 
   b->pieceCount = 0;
   b->boringMoveCount = 0;
   b->boringPoss = malloc(0);
+  b->arena = NULL;
+  b->lastMove = malloc(MAX_INP_LEN * sizeof(char));
+  strcpy(b->lastMove, "0000");
+  b->move = 0;
   
   b->canBlackCastle[0] = b->canBlackCastle[1] =\
   b->canWhiteCastle[0] = b->canWhiteCastle[1] = false;
 
 
-  int i = 0, j = 0;
-  //pieces
-  while(fen[index] != ' '){
-    if(fen[index] == '/')
-      index++;
-    while(fen[index] != '/' && fen[index] != ' '){
-      if(isalpha(fen[index])){
-        b->pieces[i][j] = switchCase(fen[index]);
+  //pieces (rank 8 first)
+  for(int i = 0; i < 8; i++){
+    int j = 0;
+    while(j < 8){
+      char c = fen[index++];
+      if(c != '\0' && strchr("pnbrqkPNBRQK", c) != NULL){
+        b->pieces[i][j++] = switchCase(c);
         b->pieceCount++;
-        j++;
-      } else if(isdigit(fen[index])){
-        for(int k = 0; k < (fen[index] - '0'); k++){
-          b->pieces[i][j + k] = ' ';
+      } else if(c >= '1' && c <= '8' && j + (c - '0') <= 8){
+        for(int k = 0; k < (c - '0'); k++){
+          b->pieces[i][j++] = ' ';
         }
-        j += (fen[index] - '0');
       } else {
-        free(b);
+        freeBoard(b);
         return NULL;
       }
-      index++;
     }
-    i++;
-
-    if(j == 8){
-      j = 0;
-    } else{
-      free(b);
+    if(fen[index] != ((i < 7) ? '/' : ' ')){
+      freeBoard(b);
       return NULL;
     }
-  }
-  if(i != 8){
-    free(b);
-    return NULL;
+    index++;
   }
 
   //testing if both kings are present
@@ -134,38 +147,39 @@ Tboard* fenToBoard(char *fen)
     }
   }
   if(!(iskOnBoard && isKOnBoard)){
-    free(b);
+    freeBoard(b);
     return NULL;
   }
 
 
-  index++;
+  //side to move
+  int side;
   if(fen[index] == 'w'){
-    b->move = 0;
+    side = 0;
   } else if(fen[index] == 'b'){
-    b->move = 1;
+    side = 1;
+  } else {
+    freeBoard(b);
+    return NULL;
   }
   index++;
-  if(fenLen-1 <= index){
-    return b;
-  }
-  if(fen[index] != ' '){
-    free(b);
+  if(fen[index] != ' ' && fen[index] != '\0'){
+    freeBoard(b);
     return NULL;
   }
-  index++;
 
-  if(fenLen-1 <= index){
-    return b;
-  }
+  //castling, en passant, halfmove clock and fullmove number are optional
+  char castling[8] = "-", enPassant[8] = "-";
+  int halfmove = 0, fullmove = 1;
+  sscanf(fen + index, "%7s %7s %d %d",
+         castling, enPassant, &halfmove, &fullmove);
+
+  bool ok = halfmove >= 0 && fullmove >= 1;
 
-  
   //castling
-  if(fen[index] == '-'){
-    index++;
-  } else {
-    while(fen[index] != ' '){
-      switch (fen[index])
+  if(strcmp(castling, "-") != 0){
+    for(int k = 0; ok && castling[k] != '\0'; k++){
+      switch (castling[k])
       {
       case 'K':
         b->canWhiteCastle[1] = true;
@@ -184,85 +198,87 @@ Tboard* fenToBoard(char *fen)
         break;
 
       default:
-        free(b);
-        return NULL;
+        ok = false;
       }
-      index++;
     }
   }
 
-  index++;
-  if(fenLen-1 <= index){
-    return b;
-  }
-
-
-  //lastMove
-  char temp[2];
-  if(fen[index] == '-'){
-    b->lastMove = malloc(MAX_INP_LEN * sizeof(char));
-    strcpy(b->lastMove, "0000");
-
-  } else {
-    if(isalpha(fen[index])){
-      temp[0] = toupper(fen[index]);
-      index++;
+  //en passant square is remembered as jump of pawn in lastMove
+  if(ok && strcmp(enPassant, "-") != 0){
+    char col = toupper(enPassant[0]);
+    if(col < 'A' || col > 'H' || enPassant[2] != '\0'){
+      ok = false;
+    } else if(enPassant[1] == '3'){
+      strcpy(b->lastMove, (char[]){col, '2', col, '4', '\0'});
+    } else if(enPassant[1] == '6'){
+      strcpy(b->lastMove, (char[]){col, '7', col, '5', '\0'});
     } else {
-      free(b);
-      return NULL;
+      ok = false;
     }
+  }
 
-    if(isdigit(fen[index])){
-      temp[1] = fen[index];
-      index++;
-    } else {
-      free(b);
-      return NULL;
-    }
-  
-    b->lastMove = malloc(MAX_INP_LEN * sizeof(char));
-    if(temp[1] == '3'){
-      strcpy(b->lastMove, (char[]){temp[0], '2', temp[0], '4', '\0'});
-    
-    } else if(temp[1] == '6'){
-      strcpy(b->lastMove, (char[]){temp[0], '7', temp[0], '5', '\0'});
-    } else {
-      free(b->lastMove);
-      free(b);
-      return NULL;
-    }
+  if(!ok){
+    freeBoard(b);
+    return NULL;
   }
 
-  index++;
-  if(fenLen-2 <= index){
-    return b;
+  b->move = 2*(fullmove - 1) + side;
+
+  //boring positions before FEN are unknown, blank ones only count moves
+  //(game is drawn after MAX_BORING_MOVES, more of them change nothing)
+  b->boringMoveCount = (halfmove > MAX_BORING_MOVES) ? MAX_BORING_MOVES
+                                                     : halfmove;
+  b->boringPoss = realloc(b->boringPoss, b->boringMoveCount * sizeof(char*));
+  for(int a = 0; a < b->boringMoveCount; a++){
+    b->boringPoss[a] = malloc(POS_STRING_LEN*sizeof(char));
+    for(int l = 0; l < POS_STRING_LEN-1; l++){
+      b->boringPoss[a][l] = ' ';
+    }
+    b->boringPoss[a][POS_STRING_LEN-1] = '\0';
   }
-  if(fen[index] != ' '){
-    free(b->lastMove);
-    free(b);
+
+  return b;
+}
+
+Tboard** loadFenFile(const char* fileName, int* count)
+{
+  FILE* file = fopen(fileName, "r");
+  if(file == NULL){
     return NULL;
   }
-  index++;
 
-  if(isdigit(fen[index])){
-    b->boringMoveCount = fen[index] - '0';
-    b->boringPoss = realloc(b->boringPoss, b->boringMoveCount * sizeof(char*));
-    for(int a = 0; a < b->boringMoveCount; a++){
-      b->boringPoss[a] = malloc(POS_STRING_LEN*sizeof(char));
-      for(int l = 0; l < POS_STRING_LEN-1; l++){
-        b->boringPoss[a][l] = ' ';
-      }
-      b->boringPoss[a][POS_STRING_LEN-1] = '\0';
+  int size = 16;
+  Tboard** boards = malloc(size * sizeof(Tboard*));
+  *count = 0;
+
+  char line[256];
+  while(fgets(line, sizeof(line), file) != NULL){
+    line[strcspn(line, "\r\n")] = '\0';
+    if(line[0] == '\0'){
+      continue;
+    }
+
+    Tboard* b = fenToBoard(line);
+    if(b == NULL){
+      continue;
     }
-  } else{
-    b->boringMoveCount = 0;
+
+    if(*count == size){
+      size *= 2;
+      boards = realloc(boards, size * sizeof(Tboard*));
+    }
+    boards[(*count)++] = b;
   }
 
-  return b;
+  fclose(file);
+  return boards;
 }
 
 void freeBoard(Tboard* b)
 {
+  if(b->arena != NULL){
+    return;
+  }
   for(int i = 0; i < b->boringMoveCount; i++){
     free(b->boringPoss[i]);
   }
@@ -276,13 +292,67 @@ void freeBoard(Tboard* b)
 char* boardToPosString(const Tboard *b)
 {
   char *posString = malloc(POS_STRING_LEN * sizeof(char));
-  for(int i = 0; i < 8; i++) {
-    for(int j = 0; j < 8; j++) {
-      posString[i*8 + j] = b->pieces[i][j];
+  writePosString(b, posString);
+  return posString;
+}
+
+void writePosString(const Tboard *b, char* posString)
+{
+  memcpy(posString, b->pieces, 64);
+  posString[64] = '\0';
+}
+
+char* boardToFen(const Tboard *b)
+{
+  char *fen = malloc(FEN_MAX_LEN * sizeof(char));
+  int index = 0;
+
+  //pieces
+  for(int i = 0; i < 8; i++){
+    int empty = 0;
+    for(int j = 0; j < 8; j++){
+      if(b->pieces[i][j] == ' '){
+        empty++;
+        continue;
+      }
+      if(empty > 0){
+        fen[index++] = '0' + empty;
+        empty = 0;
+      }
+      fen[index++] = switchCase(b->pieces[i][j]);
+    }
+    if(empty > 0){
+      fen[index++] = '0' + empty;
     }
+    fen[index++] = (i < 7) ? '/' : ' ';
   }
-  posString[64] = '\0';
-  return posString;
+
+  fen[index++] = (b->move%2 == 0) ? 'w' : 'b';
+  fen[index++] = ' ';
+
+  //castling
+  int castlingStart = index;
+  if(b->canWhiteCastle[1]) fen[index++] = 'K';
+  if(b->canWhiteCastle[0]) fen[index++] = 'Q';
+  if(b->canBlackCastle[1]) fen[index++] = 'k';
+  if(b->canBlackCastle[0]) fen[index++] = 'q';
+  if(index == castlingStart) fen[index++] = '-';
+  fen[index++] = ' ';
+
+  //en passant (square behind pawn that jumped by two)
+  const char *m = b->lastMove;
+  if(m[0] >= 'A' && m[0] <= 'H' && m[0] == m[2] &&
+     ((m[1] == '2' && m[3] == '4' && b->pieces[4][m[2]-'A'] == 'p') ||
+      (m[1] == '7' && m[3] == '5' && b->pieces[3][m[2]-'A'] == 'P'))){
+    fen[index++] = tolower(m[0]);
+    fen[index++] = (m[1] == '2') ? '3' : '6';
+  } else {
+    fen[index++] = '-';
+  }
+
+  snprintf(fen + index, FEN_MAX_LEN - index, " %d %d",
+           b->boringMoveCount, b->move/2 + 1);
+  return fen;
 }
 
 
@@ -296,6 +366,31 @@ TmoveList* initMoveList(int n)
   }
   ml->filled = 0;
   ml->size = n;
+  ml->arena = NULL;
+
+  return ml;
+}
+
+/**
+ * allocates n moves (one block) in arena to moves[from]..moves[from+n-1]
+ */
+static void allocMovesInArena(TmoveList* ml, int from, int n)
+{
+  char (*moves)[MAX_INP_LEN] = searchArenaAlloc(ml->arena,
+                                                n * MAX_INP_LEN);
+  for(int i = 0; i < n; i++){
+    ml->moves[from + i] = moves[i];
+  }
+}
+
+TmoveList* initMoveListInArena(int n, TsearchArena* arena)
+{
+  TmoveList *ml = searchArenaAlloc(arena, sizeof(TmoveList));
+  ml->moves = searchArenaAlloc(arena, n * sizeof(char*));
+  ml->filled = 0;
+  ml->size = n;
+  ml->arena = arena;
+  allocMovesInArena(ml, 0, n);
 
   return ml;
 }
@@ -313,6 +408,17 @@ void appendMoveList(TmoveList *ml, char* move)
 
   //realloc
   int n = ml->size * 2;
+  if(ml->arena != NULL){
+    // old array stays in arena till its reset
+    char **moves = searchArenaAlloc(ml->arena, n * sizeof(*ml->moves));
+    memcpy(moves, ml->moves, ml->size * sizeof(*ml->moves));
+    ml->moves = moves;
+    allocMovesInArena(ml, ml->size, n - ml->size);
+    ml->size = n;
+
+    strcpy(ml->moves[ml->filled-1], move);
+    return;
+  }
   ml->moves = realloc(ml->moves, n * sizeof(*ml->moves));
   for(int i = ml->size; i < n; i++){
     ml->moves[i] = malloc(MAX_INP_LEN * sizeof(char));
@@ -326,6 +432,9 @@ void appendMoveList(TmoveList *ml, char* move)
 
 void freeMoveList(TmoveList* ml)
 {
+  if(ml->arena != NULL){
+    return;
+  }
   for(int i = 0; i < ml->size; i++){
     free(ml->moves[i]);
   }
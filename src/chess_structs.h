@@ -13,6 +13,8 @@
 #ifndef __MODULE_CHESS_STRUCTS_H
 #define __MODULE_CHESS_STRUCTS_H
 
+#include "search_arena.h"
+
 #include <stdbool.h>
 
 //length of posString (64 squares + 1 '\0')
@@ -21,6 +23,9 @@
 //max length of string representing move + 1 '\0'
 #define MAX_INP_LEN 6
 
+//max length of FEN made by boardToFen + 1 '\0'
+#define FEN_MAX_LEN 100
+
 
 typedef struct{
 
@@ -52,6 +57,9 @@ typedef struct{
   //number of pieces left (for evaluating king's position)
   int pieceCount;
 
+  // arena of board made by copyBoardToArena (NULL if board is on heap)
+  TsearchArena* arena;
+
 } Tboard;
 
 
@@ -72,13 +80,35 @@ Tboard* initBoard(void);
  */
 Tboard* copyBoard(const Tboard *b);
 
+/**
+ * copies board to arena (freeBoard does nothing, memory is given back by
+ * reset of arena)
+ * 
+ * @note copy shares boring positions with b, so it must be dropped before
+ *       b is moved or freed (children in search)
+ */
+Tboard* copyBoardToArena(const Tboard *b, TsearchArena* arena);
+
 
 /**
  * initializes board that matches the fenString
+ * 
+ * castling, en passant, halfmove clock and fullmove number can be missing
+ * (EPD), then there is no castling, no en passant and move 1
+ * 
  * @return pointer to board if OK else NULL
  * @note https://en.wikipedia.org/wiki/Forsyth%E2%80%93Edwards_Notation
  */
-Tboard* fenToBoard(char *fenString);
+Tboard* fenToBoard(const char *fenString);
+
+/**
+ * reads file with one FEN per line
+ * 
+ * @param count gets filled by number of loaded positions
+ * @return array of boards (invalid lines are skipped) or NULL if file
+ * can not be opened
+ */
+Tboard** loadFenFile(const char* fileName, int* count);
 
 /**
  * returns posString of current possition
@@ -90,6 +120,21 @@ Tboard* fenToBoard(char *fenString);
  */
 char* boardToPosString(const Tboard *b);
 
+/**
+ * writes posString of b to posString (POS_STRING_LEN chars)
+ */
+void writePosString(const Tboard *b, char* posString);
+
+/**
+ * converts board to FEN (inverse of fenToBoard)
+ * 
+ * en passant square is taken from lastMove, halfmove clock is
+ * boringMoveCount
+ * 
+ * @returns allocated string (at most FEN_MAX_LEN chars with '\0')
+ */
+char* boardToFen(const Tboard *b);
+
 /**
  * frees board
  * 
@@ -121,6 +166,9 @@ typedef struct{
   //filled number of moves
   int filled;
 
+  // arena of list made by initMoveListInArena (NULL if list is on heap)
+  TsearchArena* arena;
+
 } TmoveList;
 
 
@@ -132,6 +180,12 @@ typedef struct{
  */
 TmoveList* initMoveList(int size);
 
+/**
+ * initializes TmoveList in arena (freeMoveList does nothing, memory is
+ * given back by reset of arena)
+ */
+TmoveList* initMoveListInArena(int size, TsearchArena* arena);
+
 /**
  * appends move to the end of moveList
  * 
@@ -0,0 +1,982 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "dense.h"
+#include "neuron.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DENSE_X86
+#include <immintrin.h>
+#endif
+
+
+typedef void (*TdenseLayerFun)(const float*, const float*, const float*,
+                               float*, int, int, Tactivation);
+typedef void (*TactivateVectorFun)(Tactivation, float*, int);
+typedef void (*TdenseLayerBatchFun)(const float*, const float*, const float*,
+                                    int, float*, int, int, int, Tactivation);
+typedef void (*TdenseLayerLanesFun)(const float*, const float*, const float*,
+                                    float*, int, int, int, Tactivation);
+
+
+static const char* simdLevelNames[SIMD_LEVEL_COUNT] = {
+  "scalar", "sse4.2", "avx2", "avx512"
+};
+
+static TsimdLevel simdLevel = SIMD_SCALAR;
+static TdenseLayerFun denseLayerFun;
+static TactivateVectorFun activateVectorFun;
+static TdenseLayerBatchFun denseLayerBatchFun;
+static TdenseLayerLanesFun denseLayerLanesFun;
+
+
+int denseStride(int count)
+{
+  return ((count + DENSE_LANES - 1) / DENSE_LANES) * DENSE_LANES;
+}
+
+
+/**
+ * scalar kernels (reference)
+ */
+
+static void denseLayerScalar(const float* w, const float* b, const float* x,
+                             float* y, int inputCount, int outputCount,
+                             Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  for(int j = 0; j < outputCount; ++j){
+    float sum = 0;
+    for(int i = 0; i < inputCount; ++i){
+      sum += x[i] * w[i*stride + j];
+    }
+    y[j] = activate(a, sum + b[j]);
+  }
+}
+
+static void activateVectorScalar(Tactivation a, float* x, int n)
+{
+  for(int i = 0; i < n; ++i){
+    x[i] = activate(a, x[i]);
+  }
+}
+
+static void denseLayerBatchScalar(const float* w, const float* b,
+                                  const float* x, int xStride, float* y,
+                                  int rowCount, int inputCount,
+                                  int outputCount, Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  for(int r = 0; r < rowCount; ++r){
+    denseLayerScalar(w, b, x + r*xStride, y + r*stride,
+                     inputCount, outputCount, a);
+  }
+}
+
+static void denseLayerLanesScalar(const float* w, const float* b,
+                                  const float* x, float* y, int inputCount,
+                                  int outputCount, int laneCount,
+                                  Tactivation a)
+{
+  for(int j = 0; j < outputCount; ++j){
+    for(int p = 0; p < laneCount; ++p){
+      float sum = 0;
+      for(int i = 0; i < inputCount; ++i){
+        sum += x[i*laneCount + p] * w[(i*outputCount + j)*laneCount + p];
+      }
+      y[j*laneCount + p] = activate(a, sum + b[j*laneCount + p]);
+    }
+  }
+}
+
+/**
+ * rows are processed in blocks of this size by vector batch kernels
+ */
+#define DENSE_BATCH_BLOCK 4
+
+
+#ifdef DENSE_X86
+
+/**
+ * exp() approximation from Cephes library (relative error below 2 ulp)
+ */
+
+#define EXP_HI 88.3762626647949f
+#define EXP_LO -88.3762626647949f
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+// same as in sigmoidRational()
+#define TANH_RATIONAL_LIMIT 4.97f
+
+
+/**
+ * SSE4.2 kernels
+ */
+
+__attribute__((target("sse4.2")))
+static inline __m128 sigmoid4(__m128 x)
+{
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  x = _mm_sub_ps(_mm_setzero_ps(), x);
+  x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+
+  __m128 fx = _mm_floor_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)),
+                                      _mm_set1_ps(0.5f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+
+  __m128 y = _mm_set1_ps(EXP_P0);
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+  y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, one));
+
+  __m128i e = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127));
+  y = _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+
+  return _mm_div_ps(one, _mm_add_ps(one, y));
+}
+
+__attribute__((target("sse4.2")))
+static inline __m128 sigmoidRational4(__m128 x)
+{
+  __m128 y = _mm_mul_ps(x, _mm_set1_ps(0.5f));
+  y = _mm_min_ps(_mm_max_ps(y, _mm_set1_ps(-TANH_RATIONAL_LIMIT)),
+                 _mm_set1_ps(TANH_RATIONAL_LIMIT));
+  __m128 y2 = _mm_mul_ps(y, y);
+
+  __m128 num = _mm_add_ps(y2, _mm_set1_ps(378));
+  num = _mm_add_ps(_mm_mul_ps(num, y2), _mm_set1_ps(17325));
+  num = _mm_add_ps(_mm_mul_ps(num, y2), _mm_set1_ps(135135));
+  num = _mm_mul_ps(num, y);
+
+  __m128 den = _mm_mul_ps(y2, _mm_set1_ps(28));
+  den = _mm_mul_ps(_mm_add_ps(den, _mm_set1_ps(3150)), y2);
+  den = _mm_mul_ps(_mm_add_ps(den, _mm_set1_ps(62370)), y2);
+  den = _mm_add_ps(den, _mm_set1_ps(135135));
+
+  return _mm_add_ps(_mm_set1_ps(0.5f),
+                    _mm_mul_ps(_mm_set1_ps(0.5f), _mm_div_ps(num, den)));
+}
+
+__attribute__((target("sse4.2")))
+static inline __m128 activate4(Tactivation a, __m128 x)
+{
+  switch(a){
+    case ACT_SIGMOID_RATIONAL:
+      return sigmoidRational4(x);
+
+    case ACT_SIGMOID_LUT: {
+      // there is no gather in SSE
+      float temp[4];
+      _mm_storeu_ps(temp, x);
+      for(int i = 0; i < 4; ++i){
+        temp[i] = sigmoidLut(temp[i]);
+      }
+      return _mm_loadu_ps(temp);
+    }
+
+    case ACT_HARD_SIGMOID:
+      x = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.25f)), _mm_set1_ps(0.5f));
+      return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+    case ACT_CLIPPED_RELU:
+      return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+    case ACT_SIGMOID:
+    default:
+      return sigmoid4(x);
+  }
+}
+
+__attribute__((target("sse4.2")))
+static void denseLayerSse42(const float* w, const float* b, const float* x,
+                            float* y, int inputCount, int outputCount,
+                            Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  for(int j = 0; j < outputCount; j += 4){
+    __m128 acc = _mm_setzero_ps();
+    for(int i = 0; i < inputCount; ++i){
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(x[i]),
+                                       _mm_load_ps(w + i*stride + j)));
+    }
+    acc = _mm_add_ps(acc, _mm_load_ps(b + j));
+    _mm_storeu_ps(y + j, activate4(a, acc));
+  }
+}
+
+static void denseLayerBatchSse42(const float* w, const float* b,
+                                 const float* x, int xStride, float* y,
+                                 int rowCount, int inputCount,
+                                 int outputCount, Tactivation a)
+{
+  // SSE has too few registers for blocking of rows
+  int stride = denseStride(outputCount);
+  for(int r = 0; r < rowCount; ++r){
+    denseLayerSse42(w, b, x + r*xStride, y + r*stride,
+                    inputCount, outputCount, a);
+  }
+}
+
+__attribute__((target("sse4.2")))
+static void denseLayerLanesSse42(const float* w, const float* b,
+                                 const float* x, float* y, int inputCount,
+                                 int outputCount, int laneCount,
+                                 Tactivation a)
+{
+  for(int j = 0; j < outputCount; ++j){
+    for(int p = 0; p < laneCount; p += 4){
+      __m128 acc = _mm_setzero_ps();
+      for(int i = 0; i < inputCount; ++i){
+        acc = _mm_add_ps(acc, _mm_mul_ps(
+          _mm_load_ps(x + i*laneCount + p),
+          _mm_load_ps(w + (i*outputCount + j)*laneCount + p)));
+      }
+      acc = _mm_add_ps(acc, _mm_load_ps(b + j*laneCount + p));
+      _mm_store_ps(y + j*laneCount + p, activate4(a, acc));
+    }
+  }
+}
+
+__attribute__((target("sse4.2")))
+static void activateVectorSse42(Tactivation a, float* x, int n)
+{
+  int i = 0;
+  for(; i + 4 <= n; i += 4){
+    _mm_storeu_ps(x + i, activate4(a, _mm_loadu_ps(x + i)));
+  }
+  activateVectorScalar(a, x + i, n - i);
+}
+
+
+/**
+ * AVX2 kernels
+ */
+
+__attribute__((target("avx2,fma")))
+static inline __m256 sigmoid8(__m256 x)
+{
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  x = _mm256_sub_ps(_mm256_setzero_ps(), x);
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)),
+                    _mm256_set1_ps(EXP_HI));
+
+  __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(EXP_LOG2E),
+                                              _mm256_set1_ps(0.5f)));
+  x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), x);
+  x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), x);
+
+  __m256 y = _mm256_set1_ps(EXP_P0);
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+  y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, one));
+
+  __m256i e = _mm256_add_epi32(_mm256_cvttps_epi32(fx),
+                               _mm256_set1_epi32(127));
+  y = _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+
+  return _mm256_div_ps(one, _mm256_add_ps(one, y));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 sigmoidRational8(__m256 x)
+{
+  __m256 y = _mm256_mul_ps(x, _mm256_set1_ps(0.5f));
+  y = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(-TANH_RATIONAL_LIMIT)),
+                    _mm256_set1_ps(TANH_RATIONAL_LIMIT));
+  __m256 y2 = _mm256_mul_ps(y, y);
+
+  __m256 num = _mm256_add_ps(y2, _mm256_set1_ps(378));
+  num = _mm256_fmadd_ps(num, y2, _mm256_set1_ps(17325));
+  num = _mm256_fmadd_ps(num, y2, _mm256_set1_ps(135135));
+  num = _mm256_mul_ps(num, y);
+
+  __m256 den = _mm256_mul_ps(y2, _mm256_set1_ps(28));
+  den = _mm256_mul_ps(_mm256_add_ps(den, _mm256_set1_ps(3150)), y2);
+  den = _mm256_mul_ps(_mm256_add_ps(den, _mm256_set1_ps(62370)), y2);
+  den = _mm256_add_ps(den, _mm256_set1_ps(135135));
+
+  return _mm256_fmadd_ps(_mm256_set1_ps(0.5f), _mm256_div_ps(num, den),
+                         _mm256_set1_ps(0.5f));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 sigmoidLut8(__m256 x)
+{
+  const float* table = getSigmoidLutTable();
+
+  __m256 t = _mm256_mul_ps(_mm256_sub_ps(x, _mm256_set1_ps(SIGMOID_LUT_MIN)),
+                           _mm256_set1_ps(SIGMOID_LUT_SCALE));
+  t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()),
+                    _mm256_set1_ps(SIGMOID_LUT_SIZE));
+
+  __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(t),
+                               _mm256_set1_epi32(SIGMOID_LUT_SIZE - 1));
+  __m256 f = _mm256_sub_ps(t, _mm256_cvtepi32_ps(i));
+
+  __m256 lo = _mm256_i32gather_ps(table, i, 4);
+  __m256 hi = _mm256_i32gather_ps(table + 1, i, 4);
+
+  return _mm256_fmadd_ps(f, _mm256_sub_ps(hi, lo), lo);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 activate8(Tactivation a, __m256 x)
+{
+  switch(a){
+    case ACT_SIGMOID_RATIONAL:
+      return sigmoidRational8(x);
+
+    case ACT_SIGMOID_LUT:
+      return sigmoidLut8(x);
+
+    case ACT_HARD_SIGMOID:
+      x = _mm256_fmadd_ps(x, _mm256_set1_ps(0.25f), _mm256_set1_ps(0.5f));
+      return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()),
+                           _mm256_set1_ps(1.0f));
+
+    case ACT_CLIPPED_RELU:
+      return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()),
+                           _mm256_set1_ps(1.0f));
+
+    case ACT_SIGMOID:
+    default:
+      return sigmoid8(x);
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void denseLayerAvx2(const float* w, const float* b, const float* x,
+                           float* y, int inputCount, int outputCount,
+                           Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  for(int j = 0; j < outputCount; j += 8){
+    // two accumulators hide latency of fma
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for(; i + 2 <= inputCount; i += 2){
+      acc0 = _mm256_fmadd_ps(_mm256_set1_ps(x[i]),
+                             _mm256_load_ps(w + i*stride + j), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_set1_ps(x[i+1]),
+                             _mm256_load_ps(w + (i+1)*stride + j), acc1);
+    }
+    if(i < inputCount){
+      acc0 = _mm256_fmadd_ps(_mm256_set1_ps(x[i]),
+                             _mm256_load_ps(w + i*stride + j), acc0);
+    }
+    acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_load_ps(b + j));
+    _mm256_storeu_ps(y + j, activate8(a, acc0));
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void denseLayerBatchAvx2(const float* w, const float* b,
+                                const float* x, int xStride, float* y,
+                                int rowCount, int inputCount,
+                                int outputCount, Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  int r = 0;
+  for(; r + DENSE_BATCH_BLOCK <= rowCount; r += DENSE_BATCH_BLOCK){
+    const float* x0 = x + r*xStride;
+    const float* x1 = x0 + xStride;
+    const float* x2 = x1 + xStride;
+    const float* x3 = x2 + xStride;
+
+    for(int j = 0; j < outputCount; j += 8){
+      __m256 acc0 = _mm256_setzero_ps();
+      __m256 acc1 = _mm256_setzero_ps();
+      __m256 acc2 = _mm256_setzero_ps();
+      __m256 acc3 = _mm256_setzero_ps();
+      for(int i = 0; i < inputCount; ++i){
+        __m256 weights = _mm256_load_ps(w + i*stride + j);
+        acc0 = _mm256_fmadd_ps(_mm256_set1_ps(x0[i]), weights, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_set1_ps(x1[i]), weights, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_set1_ps(x2[i]), weights, acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_set1_ps(x3[i]), weights, acc3);
+      }
+      __m256 bias = _mm256_load_ps(b + j);
+      float* yr = y + r*stride + j;
+      _mm256_storeu_ps(yr, activate8(a, _mm256_add_ps(acc0, bias)));
+      _mm256_storeu_ps(yr + stride, activate8(a, _mm256_add_ps(acc1, bias)));
+      _mm256_storeu_ps(yr + 2*stride, activate8(a, _mm256_add_ps(acc2, bias)));
+      _mm256_storeu_ps(yr + 3*stride, activate8(a, _mm256_add_ps(acc3, bias)));
+    }
+  }
+  for(; r < rowCount; ++r){
+    denseLayerAvx2(w, b, x + r*xStride, y + r*stride,
+                   inputCount, outputCount, a);
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void denseLayerLanesAvx2(const float* w, const float* b,
+                                const float* x, float* y, int inputCount,
+                                int outputCount, int laneCount,
+                                Tactivation a)
+{
+  for(int j = 0; j < outputCount; ++j){
+    for(int p = 0; p < laneCount; p += 8){
+      __m256 acc = _mm256_setzero_ps();
+      for(int i = 0; i < inputCount; ++i){
+        acc = _mm256_fmadd_ps(
+          _mm256_load_ps(x + i*laneCount + p),
+          _mm256_load_ps(w + (i*outputCount + j)*laneCount + p), acc);
+      }
+      acc = _mm256_add_ps(acc, _mm256_load_ps(b + j*laneCount + p));
+      _mm256_store_ps(y + j*laneCount + p, activate8(a, acc));
+    }
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void activateVectorAvx2(Tactivation a, float* x, int n)
+{
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    _mm256_storeu_ps(x + i, activate8(a, _mm256_loadu_ps(x + i)));
+  }
+  activateVectorScalar(a, x + i, n - i);
+}
+
+
+/**
+ * AVX-512 kernels
+ */
+
+__attribute__((target("avx512f")))
+static inline __m512 sigmoid16(__m512 x)
+{
+  const __m512 one = _mm512_set1_ps(1.0f);
+
+  x = _mm512_sub_ps(_mm512_setzero_ps(), x);
+  x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)),
+                    _mm512_set1_ps(EXP_HI));
+
+  __m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x,
+                                                   _mm512_set1_ps(EXP_LOG2E),
+                                                   _mm512_set1_ps(0.5f)),
+                                   _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+  x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), x);
+  x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), x);
+
+  __m512 y = _mm512_set1_ps(EXP_P0);
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+  y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, one));
+
+  y = _mm512_scalef_ps(y, fx);
+
+  return _mm512_div_ps(one, _mm512_add_ps(one, y));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 sigmoidRational16(__m512 x)
+{
+  __m512 y = _mm512_mul_ps(x, _mm512_set1_ps(0.5f));
+  y = _mm512_min_ps(_mm512_max_ps(y, _mm512_set1_ps(-TANH_RATIONAL_LIMIT)),
+                    _mm512_set1_ps(TANH_RATIONAL_LIMIT));
+  __m512 y2 = _mm512_mul_ps(y, y);
+
+  __m512 num = _mm512_add_ps(y2, _mm512_set1_ps(378));
+  num = _mm512_fmadd_ps(num, y2, _mm512_set1_ps(17325));
+  num = _mm512_fmadd_ps(num, y2, _mm512_set1_ps(135135));
+  num = _mm512_mul_ps(num, y);
+
+  __m512 den = _mm512_mul_ps(y2, _mm512_set1_ps(28));
+  den = _mm512_mul_ps(_mm512_add_ps(den, _mm512_set1_ps(3150)), y2);
+  den = _mm512_mul_ps(_mm512_add_ps(den, _mm512_set1_ps(62370)), y2);
+  den = _mm512_add_ps(den, _mm512_set1_ps(135135));
+
+  return _mm512_fmadd_ps(_mm512_set1_ps(0.5f), _mm512_div_ps(num, den),
+                         _mm512_set1_ps(0.5f));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 sigmoidLut16(__m512 x)
+{
+  const float* table = getSigmoidLutTable();
+
+  __m512 t = _mm512_mul_ps(_mm512_sub_ps(x, _mm512_set1_ps(SIGMOID_LUT_MIN)),
+                           _mm512_set1_ps(SIGMOID_LUT_SCALE));
+  t = _mm512_min_ps(_mm512_max_ps(t, _mm512_setzero_ps()),
+                    _mm512_set1_ps(SIGMOID_LUT_SIZE));
+
+  __m512i i = _mm512_min_epi32(_mm512_cvttps_epi32(t),
+                               _mm512_set1_epi32(SIGMOID_LUT_SIZE - 1));
+  __m512 f = _mm512_sub_ps(t, _mm512_cvtepi32_ps(i));
+
+  __m512 lo = _mm512_i32gather_ps(i, table, 4);
+  __m512 hi = _mm512_i32gather_ps(i, table + 1, 4);
+
+  return _mm512_fmadd_ps(f, _mm512_sub_ps(hi, lo), lo);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 activate16(Tactivation a, __m512 x)
+{
+  switch(a){
+    case ACT_SIGMOID_RATIONAL:
+      return sigmoidRational16(x);
+
+    case ACT_SIGMOID_LUT:
+      return sigmoidLut16(x);
+
+    case ACT_HARD_SIGMOID:
+      x = _mm512_fmadd_ps(x, _mm512_set1_ps(0.25f), _mm512_set1_ps(0.5f));
+      return _mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()),
+                           _mm512_set1_ps(1.0f));
+
+    case ACT_CLIPPED_RELU:
+      return _mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()),
+                           _mm512_set1_ps(1.0f));
+
+    case ACT_SIGMOID:
+    default:
+      return sigmoid16(x);
+  }
+}
+
+__attribute__((target("avx512f")))
+static void denseLayerAvx512(const float* w, const float* b, const float* x,
+                             float* y, int inputCount, int outputCount,
+                             Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  for(int j = 0; j < outputCount; j += 16){
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for(; i + 2 <= inputCount; i += 2){
+      acc0 = _mm512_fmadd_ps(_mm512_set1_ps(x[i]),
+                             _mm512_load_ps(w + i*stride + j), acc0);
+      acc1 = _mm512_fmadd_ps(_mm512_set1_ps(x[i+1]),
+                             _mm512_load_ps(w + (i+1)*stride + j), acc1);
+    }
+    if(i < inputCount){
+      acc0 = _mm512_fmadd_ps(_mm512_set1_ps(x[i]),
+                             _mm512_load_ps(w + i*stride + j), acc0);
+    }
+    acc0 = _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_load_ps(b + j));
+    _mm512_storeu_ps(y + j, activate16(a, acc0));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void denseLayerBatchAvx512(const float* w, const float* b,
+                                  const float* x, int xStride, float* y,
+                                  int rowCount, int inputCount,
+                                  int outputCount, Tactivation a)
+{
+  int stride = denseStride(outputCount);
+  int r = 0;
+  for(; r + DENSE_BATCH_BLOCK <= rowCount; r += DENSE_BATCH_BLOCK){
+    const float* x0 = x + r*xStride;
+    const float* x1 = x0 + xStride;
+    const float* x2 = x1 + xStride;
+    const float* x3 = x2 + xStride;
+
+    for(int j = 0; j < outputCount; j += 16){
+      __m512 acc0 = _mm512_setzero_ps();
+      __m512 acc1 = _mm512_setzero_ps();
+      __m512 acc2 = _mm512_setzero_ps();
+      __m512 acc3 = _mm512_setzero_ps();
+      for(int i = 0; i < inputCount; ++i){
+        __m512 weights = _mm512_load_ps(w + i*stride + j);
+        acc0 = _mm512_fmadd_ps(_mm512_set1_ps(x0[i]), weights, acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_set1_ps(x1[i]), weights, acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_set1_ps(x2[i]), weights, acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_set1_ps(x3[i]), weights, acc3);
+      }
+      __m512 bias = _mm512_load_ps(b + j);
+      float* yr = y + r*stride + j;
+      _mm512_storeu_ps(yr, activate16(a, _mm512_add_ps(acc0, bias)));
+      _mm512_storeu_ps(yr + stride, activate16(a, _mm512_add_ps(acc1, bias)));
+      _mm512_storeu_ps(yr + 2*stride,
+                       activate16(a, _mm512_add_ps(acc2, bias)));
+      _mm512_storeu_ps(yr + 3*stride,
+                       activate16(a, _mm512_add_ps(acc3, bias)));
+    }
+  }
+  for(; r < rowCount; ++r){
+    denseLayerAvx512(w, b, x + r*xStride, y + r*stride,
+                     inputCount, outputCount, a);
+  }
+}
+
+__attribute__((target("avx512f")))
+static void denseLayerLanesAvx512(const float* w, const float* b,
+                                  const float* x, float* y, int inputCount,
+                                  int outputCount, int laneCount,
+                                  Tactivation a)
+{
+  for(int j = 0; j < outputCount; ++j){
+    for(int p = 0; p < laneCount; p += 16){
+      __m512 acc = _mm512_setzero_ps();
+      for(int i = 0; i < inputCount; ++i){
+        acc = _mm512_fmadd_ps(
+          _mm512_load_ps(x + i*laneCount + p),
+          _mm512_load_ps(w + (i*outputCount + j)*laneCount + p), acc);
+      }
+      acc = _mm512_add_ps(acc, _mm512_load_ps(b + j*laneCount + p));
+      _mm512_store_ps(y + j*laneCount + p, activate16(a, acc));
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static void activateVectorAvx512(Tactivation a, float* x, int n)
+{
+  int i = 0;
+  for(; i + 16 <= n; i += 16){
+    _mm512_storeu_ps(x + i, activate16(a, _mm512_loadu_ps(x + i)));
+  }
+  activateVectorScalar(a, x + i, n - i);
+}
+
+#endif
+
+
+TsimdLevel detectSimdLevel(void)
+{
+#ifdef DENSE_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f")){
+    return SIMD_AVX512;
+  }
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+    return SIMD_AVX2;
+  }
+  if(__builtin_cpu_supports("sse4.2")){
+    return SIMD_SSE42;
+  }
+#endif
+  return SIMD_SCALAR;
+}
+
+
+TsimdLevel getSimdLevel(void)
+{
+  return simdLevel;
+}
+
+
+bool setSimdLevel(TsimdLevel level)
+{
+  if(level < SIMD_SCALAR || level > detectSimdLevel()){
+    return false;
+  }
+
+  switch(level){
+#ifdef DENSE_X86
+    case SIMD_AVX512:
+      denseLayerFun = denseLayerAvx512;
+      activateVectorFun = activateVectorAvx512;
+      denseLayerBatchFun = denseLayerBatchAvx512;
+      denseLayerLanesFun = denseLayerLanesAvx512;
+      break;
+    case SIMD_AVX2:
+      denseLayerFun = denseLayerAvx2;
+      activateVectorFun = activateVectorAvx2;
+      denseLayerBatchFun = denseLayerBatchAvx2;
+      denseLayerLanesFun = denseLayerLanesAvx2;
+      break;
+    case SIMD_SSE42:
+      denseLayerFun = denseLayerSse42;
+      activateVectorFun = activateVectorSse42;
+      denseLayerBatchFun = denseLayerBatchSse42;
+      denseLayerLanesFun = denseLayerLanesSse42;
+      break;
+#endif
+    default:
+      denseLayerFun = denseLayerScalar;
+      activateVectorFun = activateVectorScalar;
+      denseLayerBatchFun = denseLayerBatchScalar;
+      denseLayerLanesFun = denseLayerLanesScalar;
+      break;
+  }
+  simdLevel = level;
+
+  return true;
+}
+
+
+const char* simdLevelName(TsimdLevel level)
+{
+  if(level < SIMD_SCALAR || level >= SIMD_LEVEL_COUNT){
+    return "unknown";
+  }
+  return simdLevelNames[level];
+}
+
+
+/**
+ * chooses kernels before main() starts
+ */
+__attribute__((constructor))
+static void initSimdLevel(void)
+{
+  TsimdLevel level = detectSimdLevel();
+
+  const char* forced = getenv("NN_SIMD");
+  if(forced != NULL){
+    for(int i = 0; i < SIMD_LEVEL_COUNT; ++i){
+      if(strcmp(forced, simdLevelNames[i]) == 0 && i < (int)level){
+        level = i;
+      }
+    }
+  }
+
+  setSimdLevel(level);
+}
+
+
+void denseLayer(const float* weights, const float* biases,
+                const float* inputs, float* outputs,
+                int inputCount, int outputCount, Tactivation a)
+{
+  denseLayerFun(weights, biases, inputs, outputs, inputCount, outputCount, a);
+}
+
+
+void denseLayerBatch(const float* weights, const float* biases,
+                     const float* inputs, int inputStride, float* outputs,
+                     int rowCount, int inputCount, int outputCount,
+                     Tactivation a)
+{
+  denseLayerBatchFun(weights, biases, inputs, inputStride, outputs,
+                     rowCount, inputCount, outputCount, a);
+}
+
+
+void denseLayerLanes(const float* weights, const float* biases,
+                     const float* inputs, float* outputs,
+                     int inputCount, int outputCount, int laneCount,
+                     Tactivation a)
+{
+  denseLayerLanesFun(weights, biases, inputs, outputs,
+                     inputCount, outputCount, laneCount, a);
+}
+
+
+void activateVector(Tactivation a, float* x, int n)
+{
+  activateVectorFun(a, x, n);
+}
+
+
+static float randFloat(float min, float max)
+{
+  return (((float)rand()/(float)(RAND_MAX)) * (max-min)) + min;
+}
+
+bool denseSelfTest(void)
+{
+  const int shapes[][2] = {{64, 10}, {10, 1}, {12, 64}, {100, 37}, {1, 1},
+                           {7, 33}};
+  const int shapeCount = sizeof(shapes) / sizeof(*shapes);
+  const int activationTestCount = 1000;
+
+  TsimdLevel originalLevel = getSimdLevel();
+  bool ok = true;
+
+  printf("cpu supports: %s, used: %s, tolerance: %g\n",
+         simdLevelName(detectSimdLevel()), simdLevelName(originalLevel),
+         DENSE_TOLERANCE);
+
+  for(int level = SIMD_SCALAR; level <= (int)detectSimdLevel(); ++level){
+    for(int a = 0; a < ACT_COUNT; ++a){
+      double maxErr = 0;
+
+      for(int s = 0; s < shapeCount; ++s){
+        int in = shapes[s][0], out = shapes[s][1], stride = denseStride(out);
+
+        float* w = aligned_alloc(DENSE_ALIGN, in * stride * sizeof(float));
+        float* b = aligned_alloc(DENSE_ALIGN, stride * sizeof(float));
+        float* x = malloc(in * sizeof(float));
+        float* ref = malloc(stride * sizeof(float));
+        float* y = malloc(stride * sizeof(float));
+
+        memset(w, 0, in * stride * sizeof(float));
+        memset(b, 0, stride * sizeof(float));
+        for(int i = 0; i < in; ++i){
+          x[i] = randFloat(0, 1);
+          for(int j = 0; j < out; ++j){
+            w[i*stride + j] = randFloat(-1, 1);
+          }
+        }
+        for(int j = 0; j < out; ++j){
+          b[j] = randFloat(-1, 1);
+        }
+
+        denseLayerScalar(w, b, x, ref, in, out, a);
+        setSimdLevel(level);
+        denseLayer(w, b, x, y, in, out, a);
+
+        for(int j = 0; j < out; ++j){
+          maxErr = fmax(maxErr, fabs(y[j] - ref[j]));
+        }
+
+        // batch of copies of x with one remainder row after blocks
+        int rowCount = DENSE_BATCH_BLOCK + 1;
+        float* xBatch = malloc(rowCount * in * sizeof(float));
+        float* yBatch = malloc(rowCount * stride * sizeof(float));
+        for(int r = 0; r < rowCount; ++r){
+          memcpy(xBatch + r*in, x, in * sizeof(float));
+        }
+        denseLayerBatch(w, b, xBatch, in, yBatch, rowCount, in, out, a);
+        for(int r = 0; r < rowCount; ++r){
+          for(int j = 0; j < out; ++j){
+            maxErr = fmax(maxErr, fabs(yBatch[r*stride + j] - ref[j]));
+          }
+        }
+        free(xBatch);
+        free(yBatch);
+
+        // DENSE_LANES copies of same layer in lanes
+        int lanes = DENSE_LANES;
+        float* wLanes = aligned_alloc(DENSE_ALIGN,
+                                      in * out * lanes * sizeof(float));
+        float* bLanes = aligned_alloc(DENSE_ALIGN, out * lanes * sizeof(float));
+        float* xLanes = aligned_alloc(DENSE_ALIGN, in * lanes * sizeof(float));
+        float* yLanes = aligned_alloc(DENSE_ALIGN, out * lanes * sizeof(float));
+        for(int p = 0; p < lanes; ++p){
+          for(int i = 0; i < in; ++i){
+            xLanes[i*lanes + p] = x[i];
+            for(int j = 0; j < out; ++j){
+              wLanes[(i*out + j)*lanes + p] = w[i*stride + j];
+            }
+          }
+          for(int j = 0; j < out; ++j){
+            bLanes[j*lanes + p] = b[j];
+          }
+        }
+        denseLayerLanes(wLanes, bLanes, xLanes, yLanes, in, out, lanes, a);
+        for(int p = 0; p < lanes; ++p){
+          for(int j = 0; j < out; ++j){
+            maxErr = fmax(maxErr, fabs(yLanes[j*lanes + p] - ref[j]));
+          }
+        }
+        free(wLanes);
+        free(bLanes);
+        free(xLanes);
+        free(yLanes);
+
+        free(w);
+        free(b);
+        free(x);
+        free(ref);
+        free(y);
+      }
+
+      float* x = malloc(activationTestCount * sizeof(float));
+      for(int i = 0; i < activationTestCount; ++i){
+        x[i] = randFloat(-100, 100);
+      }
+      float* y = malloc(activationTestCount * sizeof(float));
+      memcpy(y, x, activationTestCount * sizeof(float));
+      activateVector(a, y, activationTestCount);
+      for(int i = 0; i < activationTestCount; ++i){
+        maxErr = fmax(maxErr, fabs(y[i] - activate(a, x[i])));
+      }
+      free(x);
+      free(y);
+
+      printf("%-7s %-17s max error: %e %s\n", simdLevelName(level),
+             activationName(a), maxErr,
+             (maxErr <= DENSE_TOLERANCE) ? "OK" : "FAILED");
+      ok = ok && (maxErr <= DENSE_TOLERANCE);
+    }
+  }
+
+  setSimdLevel(originalLevel);
+
+  return ok;
+}
+
+
+void activationBenchmark(void)
+{
+  const int count = 1 << 16;
+  const int repetitions = 200;
+  const float range = 30;
+
+  float* x = malloc(count * sizeof(float));
+  float* y = malloc(count * sizeof(float));
+  for(int i = 0; i < count; ++i){
+    x[i] = -range + (2 * range * i) / count;
+  }
+
+  printf("simd level: %s, %d evaluations per measurement\n",
+         simdLevelName(getSimdLevel()), count * repetitions);
+  printf("%-17s %12s %12s %14s\n",
+         "activation", "scalar ns", "vector ns", "max err vs sig");
+
+  for(int a = 0; a < ACT_COUNT; ++a){
+    // sink keeps compiler from throwing away scalar loop
+    volatile float sink = 0;
+
+    double start = clock();
+    for(int r = 0; r < repetitions; ++r){
+      float sum = 0;
+      for(int i = 0; i < count; ++i){
+        sum += activate(a, x[i]);
+      }
+      sink += sum;
+    }
+    double scalarTime = (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for(int r = 0; r < repetitions; ++r){
+      memcpy(y, x, count * sizeof(float));
+      activateVector(a, y, count);
+      sink += y[r];
+    }
+    double vectorTime = (clock() - start) / CLOCKS_PER_SEC;
+
+    double maxErr = 0;
+    for(int i = 0; i < count; ++i){
+      maxErr = fmax(maxErr, fabs(y[i] - sigmoid(x[i])));
+      maxErr = fmax(maxErr, fabs(activate(a, x[i]) - sigmoid(x[i])));
+    }
+
+    printf("%-17s %12.2f %12.2f %14e\n", activationName(a),
+           scalarTime * 1e9 / ((double)count * repetitions),
+           vectorTime * 1e9 / ((double)count * repetitions),
+           maxErr);
+    (void)sink;
+  }
+
+  free(x);
+  free(y);
+}
@@ -0,0 +1,134 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_DENSE_H
+#define __MODULE_DENSE_H
+
+#include "neuron.h"
+
+#include <stdbool.h>
+
+
+// number of floats every row of layer weights is padded to
+// (one AVX-512 register, so every row starts aligned)
+#define DENSE_LANES 16
+
+// alignment of weight blocks in bytes
+#define DENSE_ALIGN 64
+
+// max absolute difference of any vectorized kernel output from scalar kernel
+#define DENSE_TOLERANCE 1e-5
+
+
+/**
+ * instruction set used by dense kernels
+ */
+typedef enum {
+  SIMD_SCALAR = 0,
+  SIMD_SSE42,
+  SIMD_AVX2,
+  SIMD_AVX512,
+  SIMD_LEVEL_COUNT
+} TsimdLevel;
+
+
+/**
+ * returns best level supported by this cpu (CPUID)
+ */
+TsimdLevel detectSimdLevel(void);
+
+/**
+ * returns level used by denseLayer() and activateVector()
+ *
+ * @note it is chosen at startup as detectSimdLevel(), but can be lowered
+ * by environment variable NN_SIMD=[scalar | sse4.2 | avx2 | avx512]
+ */
+TsimdLevel getSimdLevel(void);
+
+/**
+ * sets level used by denseLayer() and activateVector()
+ *
+ * @return false if cpu doesn`t support level (nothing changes), else true
+ */
+bool setSimdLevel(TsimdLevel level);
+
+/**
+ * returns name of level (ex. "avx2")
+ */
+const char* simdLevelName(TsimdLevel level);
+
+/**
+ * returns count rounded up to multiple of DENSE_LANES
+ */
+int denseStride(int count);
+
+/**
+ * outputs[j] = a(biases[j] + sum(inputs[i] * weights[i*stride + j]))
+ *
+ * @param weights column per neuron, aligned to DENSE_ALIGN,
+ *        stride == denseStride(outputCount), padding is zero
+ * @param biases aligned to DENSE_ALIGN, padded to stride by zeros
+ * @param outputs must have space for denseStride(outputCount) floats
+ * @param a activation function of layer
+ *
+ * @note scalar level gives same results as calcNeuronOutputAct(),
+ * others differ by less than DENSE_TOLERANCE
+ */
+void denseLayer(const float* weights, const float* biases,
+                const float* inputs, float* outputs,
+                int inputCount, int outputCount, Tactivation a);
+
+/**
+ * computes denseLayer() for rowCount input vectors at once
+ *
+ * weights are loaded once for several rows, so this is matrix-matrix
+ * product instead of rowCount matrix-vector products
+ *
+ * @param inputs rowCount rows, row r starts at inputs[r*inputStride]
+ * @param outputs rowCount rows, row r starts at
+ *        outputs[r*denseStride(outputCount)]
+ */
+void denseLayerBatch(const float* weights, const float* biases,
+                     const float* inputs, int inputStride, float* outputs,
+                     int rowCount, int inputCount, int outputCount,
+                     Tactivation a);
+
+/**
+ * computes same layer of laneCount different nets at once
+ *
+ * every value has laneCount lanes (one for each net), so vectorization goes
+ * across nets:
+ * outputs[j*laneCount + p] = a(biases[j*laneCount + p] +
+ *   sum(inputs[i*laneCount + p] * weights[(i*outputCount + j)*laneCount + p]))
+ *
+ * @param laneCount multiple of DENSE_LANES
+ * @note all arrays must be aligned to DENSE_ALIGN
+ */
+void denseLayerLanes(const float* weights, const float* biases,
+                     const float* inputs, float* outputs,
+                     int inputCount, int outputCount, int laneCount,
+                     Tactivation a);
+
+/**
+ * x[i] = a(x[i]) for every i < n
+ */
+void activateVector(Tactivation a, float* x, int n);
+
+/**
+ * compares every level supported by cpu with scalar kernel on random layers
+ * and prints max errors to stdout
+ *
+ * @return true if all errors are below DENSE_TOLERANCE
+ */
+bool denseSelfTest(void);
+
+/**
+ * measures speed of all activations (scalar and vectorized) and their
+ * max errors and prints it to stdout
+ */
+void activationBenchmark(void);
+
+#endif
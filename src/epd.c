@@ -0,0 +1,260 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "epd.h"
+#include "ai.h"
+#include "chess_logic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+/**
+ * reads moves of bm or am operation (SAN separated by spaces)
+ *
+ * @return false if some move is not legal
+ */
+static bool parseEpdMoves(const Tboard* b, char* operands,
+                          char moves[EPD_MAX_MOVES][MAX_INP_LEN],
+                          int* moveCount)
+{
+  char* save;
+  for(char* san = strtok_r(operands, " \t", &save); san != NULL;
+      san = strtok_r(NULL, " \t", &save)){
+    if(*moveCount == EPD_MAX_MOVES || !sanToMove(b, san, moves[*moveCount])){
+      return false;
+    }
+    ++*moveCount;
+  }
+  return true;
+}
+
+/**
+ * parses one line of EPD file to entry
+ *
+ * @return false if line is not valid position with bm or am
+ */
+static bool parseEpdLine(char* line, TepdEntry* entry)
+{
+  char fields[4][80];
+  int opsStart;
+  if(sscanf(line, "%79s %79s %79s %79s%n", fields[0], fields[1], fields[2],
+            fields[3], &opsStart) != 4){
+    return false;
+  }
+
+  char fen[4*80 + 8];
+  snprintf(fen, sizeof(fen), "%s %s %s %s 0 1",
+           fields[0], fields[1], fields[2], fields[3]);
+  memset(entry, 0, sizeof(TepdEntry));
+  entry->board = fenToBoard(fen);
+  if(entry->board == NULL){
+    return false;
+  }
+
+  bool ok = true;
+  char* save;
+  for(char* op = strtok_r(line + opsStart, ";", &save); ok && op != NULL;
+      op = strtok_r(NULL, ";", &save)){
+    char opcode[16];
+    int operandsStart;
+    if(sscanf(op, "%15s%n", opcode, &operandsStart) != 1){
+      continue;
+    }
+    char* operands = op + operandsStart;
+
+    if(strcmp(opcode, "bm") == 0){
+      ok = parseEpdMoves(entry->board, operands, entry->bestMoves,
+                         &entry->bestMoveCount);
+    } else if(strcmp(opcode, "am") == 0){
+      ok = parseEpdMoves(entry->board, operands, entry->avoidMoves,
+                         &entry->avoidMoveCount);
+    } else if(strcmp(opcode, "id") == 0){
+      char* start = strchr(operands, '"');
+      char* end = (start != NULL) ? strchr(start + 1, '"') : NULL;
+      if(end != NULL){
+        int len = end - start - 1;
+        if(len >= EPD_ID_LEN) len = EPD_ID_LEN - 1;
+        memcpy(entry->id, start + 1, len);
+        entry->id[len] = '\0';
+      }
+    }
+  }
+
+  if(!ok || entry->bestMoveCount + entry->avoidMoveCount == 0){
+    freeBoard(entry->board);
+    return false;
+  }
+  return true;
+}
+
+TepdEntry* loadEpdFile(const char* fileName, int* count)
+{
+  FILE* file = fopen(fileName, "r");
+  if(file == NULL){
+    return NULL;
+  }
+
+  int size = 16;
+  TepdEntry* entries = malloc(size * sizeof(TepdEntry));
+  *count = 0;
+
+  char line[1024];
+  int lineNumber = 0;
+  while(fgets(line, sizeof(line), file) != NULL){
+    ++lineNumber;
+    line[strcspn(line, "\r\n")] = '\0';
+    if(line[0] == '\0' || line[0] == '#'){
+      continue;
+    }
+
+    if(*count == size){
+      size *= 2;
+      entries = realloc(entries, size * sizeof(TepdEntry));
+    }
+    if(!parseEpdLine(line, &entries[*count])){
+      fprintf(stderr, "%s:%d: invalid EPD skipped\n", fileName, lineNumber);
+      continue;
+    }
+    if(entries[*count].id[0] == '\0'){
+      snprintf(entries[*count].id, EPD_ID_LEN, "line %d", lineNumber);
+    }
+    ++*count;
+  }
+
+  fclose(file);
+  return entries;
+}
+
+void freeEpdEntries(TepdEntry* entries, int count)
+{
+  for(int i = 0; i < count; ++i){
+    freeBoard(entries[i].board);
+  }
+  free(entries);
+}
+
+bool isEpdSolution(const TepdEntry* entry, const char* move)
+{
+  for(int i = 0; i < entry->avoidMoveCount; ++i){
+    if(strcmp(entry->avoidMoves[i], move) == 0){
+      return false;
+    }
+  }
+  for(int i = 0; i < entry->bestMoveCount; ++i){
+    if(strcmp(entry->bestMoves[i], move) == 0){
+      return true;
+    }
+  }
+  return entry->bestMoveCount == 0;
+}
+
+
+/**
+ * position being searched (data of epdOnDepth)
+ */
+typedef struct {
+
+  const TepdEntry* entry;
+  TepdResult* result;
+
+} TepdSearch;
+
+/**
+ * search callback, remembers when search switched to solution
+ */
+static void epdOnDepth(const TsearchInfo* info, void* data)
+{
+  TepdSearch* search = data;
+
+  if(!isEpdSolution(search->entry, info->bestMove)){
+    search->result->solveSeconds = -1;
+  } else if(search->result->solveSeconds < 0){
+    search->result->solveSeconds = info->elapsed;
+  }
+}
+
+TepdResult* runEpdSuite(const TepdEntry* entries, int count,
+                        const TchNet* net, float seconds, int maxDepth,
+                        double* wallSeconds)
+{
+  TepdResult* results = calloc((count > 0) ? count : 1, sizeof(TepdResult));
+  if(results == NULL){
+    return NULL;
+  }
+
+  double start = omp_get_wtime();
+
+  // positions take different time, so threads take them one by one
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(int i = 0; i < count; ++i){
+    TepdResult* result = &results[i];
+    TepdSearch search = {&entries[i], result};
+    Tboard* b = copyBoard(entries[i].board);
+
+    TsearchInfo info;
+    initSearchInfo(&info, seconds);
+    info.maxDepth = maxDepth;
+    info.onDepth = epdOnDepth;
+    info.onDepthData = &search;
+    result->solveSeconds = -1;
+
+    minimaxSearch(b, net, &info);
+
+    strcpy(result->move, info.bestMove);
+    result->solved = isEpdSolution(&entries[i], info.bestMove);
+    if(!result->solved){
+      result->solveSeconds = -1;
+    }
+    result->depth = info.depth;
+    result->nodes = info.nodes;
+    result->seconds = info.elapsed;
+    freeBoard(b);
+  }
+
+  if(wallSeconds != NULL){
+    *wallSeconds = omp_get_wtime() - start;
+  }
+  return results;
+}
+
+
+void printEpdReport(const TepdEntry* entries, const TepdResult* results,
+                    int count, double wallSeconds)
+{
+  int solved = 0;
+  long nodes = 0;
+  double solveSum = 0, searchSum = 0, depthSum = 0;
+
+  for(int i = 0; i < count; ++i){
+    const TepdResult* r = &results[i];
+    nodes += r->nodes;
+    searchSum += r->seconds;
+    depthSum += r->depth;
+    if(r->solved){
+      ++solved;
+      solveSum += r->solveSeconds;
+    } else {
+      char san[16] = "?";
+      moveToSan(entries[i].board, r->move, san);
+      printf("  unsolved %-20s played %-8s depth %2d\n",
+             entries[i].id, san, r->depth);
+    }
+  }
+
+  printf("epd: solved %d/%d (%.1f %%)\n", solved, count,
+         (count > 0) ? 100.0 * solved / count : 0);
+  printf("  mean time to solve: %.3f s\n",
+         (solved > 0) ? solveSum / solved : 0);
+  printf("  mean depth: %.2f\n", (count > 0) ? depthSum / count : 0);
+  printf("  nodes: %ld in %.2f s on %d threads\n",
+         nodes, wallSeconds, omp_get_max_threads());
+  printf("  nodes/sec: %.0f total, %.0f per thread\n",
+         (wallSeconds > 0) ? nodes / wallSeconds : 0,
+         (searchSum > 0) ? nodes / searchSum : 0);
+}
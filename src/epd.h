@@ -0,0 +1,101 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_EPD_H
+#define __MODULE_EPD_H
+
+#include "chess_net.h"
+#include "chess_structs.h"
+
+#include <stdbool.h>
+
+
+// max number of moves of one operation (bm or am)
+#define EPD_MAX_MOVES 8
+
+// max length of id of position
+#define EPD_ID_LEN 64
+
+
+/**
+ * test position of EPD file
+ *
+ * position is solved if chosen move is one of bestMoves (if there are
+ * some) and none of avoidMoves
+ */
+typedef struct {
+
+  Tboard* board;
+
+  char id[EPD_ID_LEN];
+
+  // moves of "bm" and "am" operations (format of moveBoard)
+  char bestMoves[EPD_MAX_MOVES][MAX_INP_LEN];
+  int bestMoveCount;
+  char avoidMoves[EPD_MAX_MOVES][MAX_INP_LEN];
+  int avoidMoveCount;
+
+} TepdEntry;
+
+/**
+ * search of one position
+ */
+typedef struct {
+
+  char move[MAX_INP_LEN];
+  bool solved;
+
+  // time when search chose solution and kept it till the end
+  // (-1 if not solved)
+  double solveSeconds;
+
+  int depth;
+  long nodes;
+  double seconds;
+
+} TepdResult;
+
+
+/**
+ * reads EPD file (4 FEN fields followed by operations, ex.
+ * "... w - - bm Nf3; id \"test 1\";")
+ *
+ * @param count gets filled by number of loaded positions
+ * @return positions with bm or am operation (other lines are skipped) or
+ *         NULL if file can not be opened
+ */
+TepdEntry* loadEpdFile(const char* fileName, int* count);
+
+/**
+ * frees positions of loadEpdFile
+ */
+void freeEpdEntries(TepdEntry* entries, int count);
+
+/**
+ * returns true if move solves position
+ */
+bool isEpdSolution(const TepdEntry* entry, const char* move);
+
+/**
+ * searches every position (one per thread at a time, on all threads)
+ *
+ * @param net chess network used for evaluation (NULL for primitiveEval)
+ * @param seconds time limit of every search (0 for none)
+ * @param maxDepth depth limit of every search (0 for none)
+ * @param wallSeconds gets filled by time of whole run (can be NULL)
+ * @return result of every position (NULL if error)
+ */
+TepdResult* runEpdSuite(const TepdEntry* entries, int count,
+                        const TchNet* net, float seconds, int maxDepth,
+                        double* wallSeconds);
+
+/**
+ * prints unsolved positions, solve rate, mean time to solve and nodes/sec
+ */
+void printEpdReport(const TepdEntry* entries, const TepdResult* results,
+                    int count, double wallSeconds);
+
+#endif
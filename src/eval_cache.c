@@ -0,0 +1,136 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "eval_cache.h"
+#include "chess_net.h"
+#include "rng.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// marks used entry, so empty entry (zeros) never matches
+#define EVAL_CACHE_VALID_BIT (1ull << 32)
+
+// random number for every piece on every square
+static uint64_t zobristKeys[64][PREPR_NEURON_INP_COUNT];
+
+// statistics of calling thread not flushed yet
+static _Thread_local uint64_t threadProbes = 0;
+static _Thread_local uint64_t threadHits = 0;
+
+// statistics of all threads since last resetEvalCacheStats()
+static uint64_t totalProbes = 0;
+static uint64_t totalHits = 0;
+
+
+/**
+ * fills zobristKeys, keys are same in every run
+ */
+__attribute__((constructor))
+static void initZobristKeys(void)
+{
+  uint64_t state = 0x5EEDC0FFEEull;
+  for(int s = 0; s < 64; ++s){
+    for(int k = 0; k < PREPR_NEURON_INP_COUNT; ++k){
+      zobristKeys[s][k] = rngSplitMix64(&state);
+    }
+  }
+}
+
+
+TevalCache* initEvalCache(int bits)
+{
+  TevalCache* cache = malloc(sizeof(TevalCache));
+  if(cache == NULL){
+    return NULL;
+  }
+  cache->entries = calloc((size_t)1 << bits, sizeof(TevalCacheEntry));
+  if(cache->entries == NULL){
+    free(cache);
+    return NULL;
+  }
+  cache->mask = ((uint64_t)1 << bits) - 1;
+  return cache;
+}
+
+void freeEvalCache(TevalCache* cache)
+{
+  if(cache == NULL){
+    return;
+  }
+  free(cache->entries);
+  free(cache);
+}
+
+void clearEvalCache(TevalCache* cache)
+{
+  memset(cache->entries, 0, (cache->mask + 1) * sizeof(TevalCacheEntry));
+}
+
+
+void flushEvalCacheStats(void)
+{
+  if(threadProbes > 0){
+    __atomic_fetch_add(&totalProbes, threadProbes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totalHits, threadHits, __ATOMIC_RELAXED);
+    threadProbes = 0;
+    threadHits = 0;
+  }
+}
+
+void getEvalCacheStats(uint64_t* probes, uint64_t* hits)
+{
+  *probes = __atomic_load_n(&totalProbes, __ATOMIC_RELAXED);
+  *hits = __atomic_load_n(&totalHits, __ATOMIC_RELAXED);
+}
+
+void resetEvalCacheStats(void)
+{
+  __atomic_store_n(&totalProbes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&totalHits, 0, __ATOMIC_RELAXED);
+}
+
+
+bool evalCacheProbe(TevalCache* cache, uint64_t key, float* evaluation)
+{
+  TevalCacheEntry* e = &cache->entries[key & cache->mask];
+  uint64_t check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+  uint64_t data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+
+  ++threadProbes;
+  if((check ^ data) != key || !(data & EVAL_CACHE_VALID_BIT)){
+    return false;
+  }
+  ++threadHits;
+
+  uint32_t bits = (uint32_t)data;
+  memcpy(evaluation, &bits, sizeof(float));
+  return true;
+}
+
+void evalCacheStore(TevalCache* cache, uint64_t key, float evaluation)
+{
+  uint32_t bits;
+  memcpy(&bits, &evaluation, sizeof(float));
+  uint64_t data = bits | EVAL_CACHE_VALID_BIT;
+
+  TevalCacheEntry* e = &cache->entries[key & cache->mask];
+  __atomic_store_n(&e->check, key ^ data, __ATOMIC_RELAXED);
+  __atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+}
+
+
+uint64_t pieceIndicesHash(const uint8_t* pieceIndices)
+{
+  uint64_t hash = 0;
+  for(int s = 0; s < 64; ++s){
+    if(pieceIndices[s] < PREPR_NEURON_INP_COUNT){
+      hash ^= zobristKeys[s][pieceIndices[s]];
+    }
+  }
+  return hash;
+}
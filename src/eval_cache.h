@@ -0,0 +1,98 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_EVAL_CACHE_H
+#define __MODULE_EVAL_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// default cache of one net has 2^EVAL_CACHE_BITS entries (16 B each)
+#define EVAL_CACHE_BITS 14
+
+
+/**
+ * one cached evaluation
+ *
+ * check == key ^ data, so entry torn by concurrent writes is detected
+ * (and treated as miss) without any locking
+ */
+typedef struct {
+  uint64_t check;
+  uint64_t data;
+} TevalCacheEntry;
+
+/**
+ * fixed size lossy cache of evaluations of one net
+ *
+ * new entry always replaces old one with same index, it can be used by
+ * more threads at once
+ */
+typedef struct {
+
+  // 2^bits entries
+  TevalCacheEntry* entries;
+
+  // index of key is key & mask
+  uint64_t mask;
+
+} TevalCache;
+
+
+/**
+ * returns empty cache with 2^bits entries or NULL if error
+ */
+TevalCache* initEvalCache(int bits);
+
+void freeEvalCache(TevalCache* cache);
+
+/**
+ * removes all entries (cache of net, that was changed, must be cleared)
+ */
+void clearEvalCache(TevalCache* cache);
+
+/**
+ * adds probes and hits of calling thread to statistics of all threads
+ *
+ * probes are counted by thread without any atomic operation, so searching
+ * thread calls this once in a while (after every move of root)
+ */
+void flushEvalCacheStats(void);
+
+/**
+ * returns probes and hits of all caches flushed since last
+ * resetEvalCacheStats()
+ */
+void getEvalCacheStats(uint64_t* probes, uint64_t* hits);
+
+/**
+ * sets probes and hits of all threads to 0
+ */
+void resetEvalCacheStats(void);
+
+/**
+ * returns true and sets evaluation if key is in cache
+ */
+bool evalCacheProbe(TevalCache* cache, uint64_t key, float* evaluation);
+
+/**
+ * saves evaluation of key to cache
+ */
+void evalCacheStore(TevalCache* cache, uint64_t key, float evaluation);
+
+/**
+ * returns 64-bit Zobrist hash of position encoded by chNetEncodeBoard
+ * (or chNetEncodeBoardForNet)
+ *
+ * side to move, castling and en passant are not hashed, because chess net
+ * sees only pieces
+ *
+ * @param pieceIndices 64 piece indices
+ */
+uint64_t pieceIndicesHash(const uint8_t* pieceIndices);
+
+#endif
@@ -6,49 +6,270 @@
 
 #include "fcnn.h"
 #include "neuron.h"
+#include "dense.h"
+#include "rng.h"
+#include "search_arena.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdbool.h>
+#include <math.h>
 
 
 
 
-Tfcnn* initRandfcnn(int layerCount, const int* neuronsInLayersCount)
+/**
+ * defines forward pass of variant (scalar, avx2, avx512) for net with
+ * one hidden layer of fixed size
+ *
+ * all loop bounds are constants, so compiler unrolls them and hidden layer
+ * stays in registers (vectors of WIDTH floats, native width of TARGET).
+ * Inputs of hidden layer are summed in ACCS interleaved partial sums;
+ * scalar variant has ACCS == 1, so it sums in same order as denseLayer()
+ * and gives same results.
+ */
+#define FCNN_FIXED_FORWARD_VARIANT(IN, HID, OUT, VARIANT, TARGET, WIDTH,    \
+                                   ACCS)                                     \
+  TARGET                                                                     \
+  static void fcnnForward_##IN##_##HID##_##OUT##_##VARIANT(                  \
+    const Tfcnn* net, const float* inputs, float* outputs)                   \
+  {                                                                          \
+    typedef float Tlanes __attribute__((vector_size(WIDTH * sizeof(float))));\
+    enum {                                                                   \
+      HID_BLOCKS = (HID + DENSE_LANES - 1) / DENSE_LANES * DENSE_LANES/WIDTH,\
+      OUT_BLOCKS = (OUT + DENSE_LANES - 1) / DENSE_LANES * DENSE_LANES/WIDTH,\
+      HID_USED = (HID + WIDTH - 1) / WIDTH,                                  \
+      OUT_USED = (OUT + WIDTH - 1) / WIDTH                                   \
+    };                                                                       \
+    const Tlanes* w0 = (const Tlanes*)net->weights[0];                       \
+    const Tlanes* b0 = (const Tlanes*)net->biases[0];                        \
+    const Tlanes* w1 = (const Tlanes*)net->weights[1];                       \
+    const Tlanes* b1 = (const Tlanes*)net->biases[1];                        \
+                                                                             \
+    /* ACCS independent sums hide latency of additions */                   \
+    _Static_assert(IN % ACCS == 0, "inputs must split to ACCS sums");        \
+    Tlanes sums[ACCS][HID_USED];                                             \
+    memset(sums, 0, sizeof(sums));                                           \
+    for(int i = 0; i < IN; i += ACCS){                                       \
+      for(int a = 0; a < ACCS; ++a){                                         \
+        for(int k = 0; k < HID_USED; ++k){                                   \
+          sums[a][k] += inputs[i + a] * w0[(i + a)*HID_BLOCKS + k];          \
+        }                                                                    \
+      }                                                                      \
+    }                                                                        \
+    Tlanes hidden[HID_USED];                                                 \
+    for(int k = 0; k < HID_USED; ++k){                                       \
+      hidden[k] = sums[0][k];                                                \
+      for(int a = 1; a < ACCS; ++a){                                         \
+        hidden[k] += sums[a][k];                                             \
+      }                                                                      \
+      hidden[k] += b0[k];                                                    \
+    }                                                                        \
+    /* padding lanes are activated too (whole vectors), but never read */    \
+    activateVector(net->activation, (float*)hidden, HID_USED * WIDTH);       \
+                                                                             \
+    Tlanes out[OUT_USED] = {0};                                              \
+    for(int i = 0; i < HID; ++i){                                            \
+      float h = ((const float*)hidden)[i];                                   \
+      for(int k = 0; k < OUT_USED; ++k){                                     \
+        out[k] += h * w1[i*OUT_BLOCKS + k];                                  \
+      }                                                                      \
+    }                                                                        \
+    for(int k = 0; k < OUT_USED; ++k){                                       \
+      out[k] += b1[k];                                                       \
+    }                                                                        \
+    activateVector(net->activation, (float*)out, OUT_USED * WIDTH);          \
+    memcpy(outputs, out, OUT * sizeof(float));                               \
+  }
+
+/**
+ * defines forward passes of all variants for topology IN-HID-OUT
+ */
+#define FCNN_FIXED_FORWARD(IN, HID, OUT)                                     \
+  FCNN_FIXED_FORWARD_VARIANT(IN, HID, OUT, scalar, , 4, 1)                   \
+  FCNN_FIXED_FORWARD_VARIANT(IN, HID, OUT, avx2,                             \
+                             __attribute__((target("avx2,fma"))), 8, 4)      \
+  FCNN_FIXED_FORWARD_VARIANT(IN, HID, OUT, avx512,                           \
+                             __attribute__((target("avx512f"))), 16, 4)
+
+/**
+ * entry of fixedForwards table for topology IN-HID-OUT
+ * (sse4.2 level uses scalar variant, SSE2 of x86-64 is enough for it)
+ */
+#define FCNN_FIXED_FORWARD_ENTRY(IN, HID, OUT)                               \
+  { {IN, HID, OUT},                                                          \
+    { fcnnForward_##IN##_##HID##_##OUT##_scalar,                             \
+      fcnnForward_##IN##_##HID##_##OUT##_scalar,                             \
+      fcnnForward_##IN##_##HID##_##OUT##_avx2,                               \
+      fcnnForward_##IN##_##HID##_##OUT##_avx512 } }
+
+
+typedef void (*TfcnnForwardFun)(const Tfcnn*, const float*, float*);
+
+typedef struct {
+  int neuronsInLayersCount[3];
+  TfcnnForwardFun funs[SIMD_LEVEL_COUNT];
+} TfixedForward;
+
+// topologies used in chNetEvolution (add new ones here)
+FCNN_FIXED_FORWARD(64, 10, 1)
+FCNN_FIXED_FORWARD(64, 16, 1)
+FCNN_FIXED_FORWARD(64, 32, 1)
+
+static const TfixedForward fixedForwards[] = {
+  FCNN_FIXED_FORWARD_ENTRY(64, 10, 1),
+  FCNN_FIXED_FORWARD_ENTRY(64, 16, 1),
+  FCNN_FIXED_FORWARD_ENTRY(64, 32, 1),
+};
+
+/**
+ * returns index of fixedForwards entry matching topology or -1
+ */
+static int findFixedForward(int layerCount, const int* neuronsInLayersCount)
 {
-  //there are no neurons in first layer
+  if(layerCount != 3){
+    return -1;
+  }
+  int count = sizeof(fixedForwards) / sizeof(*fixedForwards);
+  for(int i = 0; i < count; ++i){
+    if(memcmp(fixedForwards[i].neuronsInLayersCount, neuronsInLayersCount,
+              3 * sizeof(int)) == 0){
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+int fcnnParamCount(int layerCount, const int* neuronsInLayersCount)
+{
+  int paramCount = 0;
+  for(int i = 1; i < layerCount; ++i){
+    int stride = denseStride(neuronsInLayersCount[i]);
+    paramCount += (neuronsInLayersCount[i-1] + 1) * stride;
+  }
+  return paramCount;
+}
+
 
+/**
+ * allocates fcnn of given size with weights and biases in params
+ * 
+ * @param params block of fcnnParamCount() floats aligned to DENSE_ALIGN,
+ *        if NULL, new zeroed block owned by fcnn is allocated
+ */
+static Tfcnn* allocfcnn(int layerCount, const int* neuronsInLayersCount,
+                        Tactivation activation, float* params)
+{
   Tfcnn* n = malloc(sizeof(Tfcnn));
   n->layerCount = layerCount;
+  n->activation = activation;
   n->neuronsInLayersCount = malloc(n->layerCount * sizeof(int));
-  n->neurons = malloc((n->layerCount-1) * sizeof(Tneuron**));
+  n->weights = malloc((n->layerCount-1) * sizeof(float*));
+  n->biases = malloc((n->layerCount-1) * sizeof(float*));
+  memcpy(n->neuronsInLayersCount, neuronsInLayersCount,
+         layerCount * sizeof(int));
+
+  // every matrix and vector has length divisible by DENSE_LANES,
+  // so all of them stay aligned
+  n->ownsParams = (params == NULL);
+  if(n->ownsParams){
+    int paramCount = fcnnParamCount(layerCount, neuronsInLayersCount);
+    params = aligned_alloc(DENSE_ALIGN, paramCount * sizeof(float));
+    memset(params, 0, paramCount * sizeof(float));
+  }
+  n->params = params;
 
-  n->neuronsInLayersCount[0] = neuronsInLayersCount[0];
+  float* p = n->params;
   for(int i = 1; i < n->layerCount; ++i){
-    n->neuronsInLayersCount[i] = neuronsInLayersCount[i];
+    int stride = denseStride(n->neuronsInLayersCount[i]);
 
-    n->neurons[i-1] = malloc(n->neuronsInLayersCount[i] * sizeof(Tneuron*));
-    for(int j = 0; j < n->neuronsInLayersCount[i]; ++j){
-      n->neurons[i-1][j] = initRandNeuron(n->neuronsInLayersCount[i-1],
-                                          MIN_RAND_WEIGHT,
-                                          MAX_RAND_WEIGHT);
-    }
+    n->weights[i-1] = p;
+    p += n->neuronsInLayersCount[i-1] * stride;
+
+    n->biases[i-1] = p;
+    p += stride;
   }
 
+  n->fixedForward = findFixedForward(layerCount, neuronsInLayersCount);
+
   return n;
 }
 
+Tfcnn* initfcnnView(int layerCount, const int* neuronsInLayersCount,
+                    Tactivation activation, float* params)
+{
+  return allocfcnn(layerCount, neuronsInLayersCount, activation, params);
+}
 
-void freefcnn(Tfcnn* n)
+
+/**
+ * randomizes weights and bias of neuron (same range as initRandNeuron)
+ */
+static void randomizefcnnNeuron(Tfcnn* n, int layerIndex, int neuronIndex,
+                                Trng* rng)
+{
+  int stride = denseStride(n->neuronsInLayersCount[layerIndex]);
+
+  for(int i = 0; i < n->neuronsInLayersCount[layerIndex-1]; ++i){
+    n->weights[layerIndex-1][i*stride + neuronIndex] =
+      rngFloat(rng, MIN_RAND_WEIGHT, MAX_RAND_WEIGHT);
+  }
+  n->biases[layerIndex-1][neuronIndex] =
+    rngFloat(rng, MIN_RAND_WEIGHT, MAX_RAND_WEIGHT);
+}
+
+
+/**
+ * copies weights and bias of neuron from origin to dest
+ */
+static void copyfcnnNeuron(Tfcnn* dest, const Tfcnn* origin,
+                           int layerIndex, int neuronIndex)
+{
+  int stride = denseStride(dest->neuronsInLayersCount[layerIndex]);
+
+  for(int i = 0; i < dest->neuronsInLayersCount[layerIndex-1]; ++i){
+    dest->weights[layerIndex-1][i*stride + neuronIndex] =
+      origin->weights[layerIndex-1][i*stride + neuronIndex];
+  }
+  dest->biases[layerIndex-1][neuronIndex] =
+    origin->biases[layerIndex-1][neuronIndex];
+}
+
+
+Tfcnn* initRandfcnn(int layerCount, const int* neuronsInLayersCount,
+                    Tactivation activation)
+{
+  //there are no neurons in first layer
+
+  Tfcnn* n = allocfcnn(layerCount, neuronsInLayersCount, activation, NULL);
+
+  Trng rng;
+  rngSeed(&rng, rand(), 0, 0);
+  randomizefcnn(n, &rng);
+
+  return n;
+}
+
+void randomizefcnn(Tfcnn* n, Trng* rng)
 {
   for(int i = 1; i < n->layerCount; ++i){
     for(int j = 0; j < n->neuronsInLayersCount[i]; ++j){
-      freeNeuron(n->neurons[i-1][j]);
+      randomizefcnnNeuron(n, i, j, rng);
     }
-    free(n->neurons[i-1]);
   }
+}
+
+
+void freefcnn(Tfcnn* n)
+{
+  if(n->ownsParams){
+    free(n->params);
+  }
+  free(n->weights);
+  free(n->biases);
   free(n->neuronsInLayersCount);
-  free(n->neurons);
   free(n);
 }
 
@@ -67,9 +288,21 @@ void fprintfcnn(FILE* out, const Tfcnn* n)
   }
   fprintf(out, "\n");
 
+  if(n->activation != ACT_SIGMOID){
+    fprintf(out, "%s\n", activationName(n->activation));
+  }
+
   for(int i = 1; i < n->layerCount; ++i){
+    int stride = denseStride(n->neuronsInLayersCount[i]);
+    int inputCount = n->neuronsInLayersCount[i-1];
+
+    // neurons are printed same as fprintNeuron does it
     for(int j = 0; j < n->neuronsInLayersCount[i]; ++j){
-      fprintNeuron(out, n->neurons[i-1][j]);
+      fprintf(out, "%d\n", inputCount);
+      for(int k = 0; k < inputCount; ++k){
+        fprintf(out, "%f ", n->weights[i-1][k*stride + j]);
+      }
+      fprintf(out, "\n%f\n", n->biases[i-1][j]);
     }
   }
 }
@@ -81,31 +314,59 @@ Tfcnn* getfcnn(void)
 
 Tfcnn* fgetfcnn(FILE* in)
 {
-  Tfcnn* n = malloc(sizeof(Tfcnn));
-  if(fscanf(in, "%d", &n->layerCount) != 1){
+  int layerCount;
+  if(fscanf(in, "%d", &layerCount) != 1 || layerCount < 2){
     return NULL;
   }
 
-  n->neuronsInLayersCount = malloc(n->layerCount * sizeof(int));
-  n->neurons = malloc((n->layerCount-1) * sizeof(Tneuron**));
-
-  if(fscanf(in, "%d", &n->neuronsInLayersCount[0]) != 1){
+  int* neuronsInLayersCount = malloc(layerCount * sizeof(int));
+  for(int i = 0; i < layerCount; ++i){
+    if(fscanf(in, "%d", &neuronsInLayersCount[i]) != 1 ||
+       neuronsInLayersCount[i] < 1){
+      free(neuronsInLayersCount);
       return NULL;
     }
-  for(int i = 1; i < n->layerCount; ++i){
-     if(fscanf(in, "%d", &n->neuronsInLayersCount[i]) != 1){
-      return NULL;
+  }
+
+  // optional activation line (starts with letter, neurons start with number)
+  Tactivation activation = ACT_SIGMOID;
+  if(fscanf(in, " ") == 0){
+    int c = fgetc(in);
+    ungetc(c, in);
+    if(isalpha(c)){
+      char name[32];
+      if(fscanf(in, "%31s", name) != 1 ||
+         (activation = activationFromName(name)) == ACT_COUNT){
+        free(neuronsInLayersCount);
+        return NULL;
+      }
     }
-    n->neurons[i-1] = malloc(n->neuronsInLayersCount[i] * sizeof(Tneuron*));
   }
 
+  Tfcnn* n = allocfcnn(layerCount, neuronsInLayersCount, activation, NULL);
+  free(neuronsInLayersCount);
 
   for(int i = 1; i < n->layerCount; ++i){
+    int stride = denseStride(n->neuronsInLayersCount[i]);
+
     for(int j = 0; j < n->neuronsInLayersCount[i]; ++j){
-      n->neurons[i-1][j] = fgetNeuron(in);
-      if(n->neurons[i-1][j] == NULL){
+      Tneuron* neuron = fgetNeuron(in);
+      if(neuron == NULL){
+        freefcnn(n);
         return NULL;
       }
+      if(neuron->inputCount != n->neuronsInLayersCount[i-1]){
+        freeNeuron(neuron);
+        freefcnn(n);
+        return NULL;
+      }
+
+      for(int k = 0; k < neuron->inputCount; ++k){
+        n->weights[i-1][k*stride + j] = neuron->weights[k];
+      }
+      n->biases[i-1][j] = neuron->bias;
+
+      freeNeuron(neuron);
     }
   }
 
@@ -114,66 +375,192 @@ Tfcnn* fgetfcnn(FILE* in)
 
 float* propagateLayer(const Tfcnn* net, const float* inputs, int layerIndex)
 {
-  float* output = malloc(net->neuronsInLayersCount[layerIndex] *
+  float* output = malloc(denseStride(net->neuronsInLayersCount[layerIndex]) *
                          sizeof(float));
 
-  for(int i = 0; i < net->neuronsInLayersCount[layerIndex]; ++i){
-    output[i] = calcNeuronOutput(net->neurons[layerIndex-1][i], inputs);
-  }
+  denseLayer(net->weights[layerIndex-1], net->biases[layerIndex-1],
+             inputs, output,
+             net->neuronsInLayersCount[layerIndex-1],
+             net->neuronsInLayersCount[layerIndex], net->activation);
 
   return output;
 }
 
 float* fcnnPredict(const Tfcnn* net, const float* inputs)
 {
-  float* b;
+  float* outputs = malloc(net->neuronsInLayersCount[net->layerCount-1] *
+                          sizeof(float));
+  fcnnForward(net, inputs, outputs);
+  return outputs;
+}
+
+void fcnnForward(const Tfcnn* net, const float* inputs, float* outputs)
+{
+  if(net->fixedForward >= 0){
+    fixedForwards[net->fixedForward].funs[getSimdLevel()](net, inputs,
+                                                          outputs);
+    return;
+  }
+
+  int maxStride = 0;
+  for(int i = 0; i < net->layerCount; ++i){
+    if(denseStride(net->neuronsInLayersCount[i]) > maxStride){
+      maxStride = denseStride(net->neuronsInLayersCount[i]);
+    }
+  }
 
-  float* a = malloc(net->neuronsInLayersCount[0] * sizeof(float));
+  TsearchArena* arena = getThreadSearchArena();
+  TsearchArenaMark mark = searchArenaMark(arena);
+  float* a = searchArenaAlloc(arena, maxStride * sizeof(float));
+  float* b = searchArenaAlloc(arena, maxStride * sizeof(float));
   memcpy(a, inputs, net->neuronsInLayersCount[0] * sizeof(float));
 
   for(int i = 1; i < net->layerCount; ++i){
-    b = propagateLayer(net, a, i);
+    denseLayer(net->weights[i-1], net->biases[i-1], a, b,
+               net->neuronsInLayersCount[i-1], net->neuronsInLayersCount[i],
+               net->activation);
+
+    float* temp = a;
+    a = b;
+    b = temp;
+  }
+
+  memcpy(outputs, a,
+         net->neuronsInLayersCount[net->layerCount-1] * sizeof(float));
+  searchArenaReset(arena, mark);
+}
+
+void fcnnPredictBatch(const Tfcnn* net, const float* inputs, int rowCount,
+                      float* outputs)
+{
+  int maxStride = 0;
+  for(int i = 1; i < net->layerCount; ++i){
+    if(denseStride(net->neuronsInLayersCount[i]) > maxStride){
+      maxStride = denseStride(net->neuronsInLayersCount[i]);
+    }
+  }
+
+  TsearchArena* arena = getThreadSearchArena();
+  TsearchArenaMark mark = searchArenaMark(arena);
+  float* a = searchArenaAlloc(arena, rowCount * maxStride * sizeof(float));
+  float* b = searchArenaAlloc(arena, rowCount * maxStride * sizeof(float));
+
+  // first layer reads inputs directly
+  const float* layerInputs = inputs;
+  int layerInputStride = net->neuronsInLayersCount[0];
+
+  for(int i = 1; i < net->layerCount; ++i){
+    denseLayerBatch(net->weights[i-1], net->biases[i-1],
+                    layerInputs, layerInputStride, b, rowCount,
+                    net->neuronsInLayersCount[i-1],
+                    net->neuronsInLayersCount[i], net->activation);
 
-    a = realloc(a, net->neuronsInLayersCount[i] * sizeof(float));
+    layerInputs = b;
+    layerInputStride = denseStride(net->neuronsInLayersCount[i]);
 
-    memcpy(a, b, net->neuronsInLayersCount[i] * sizeof(float));
+    float* temp = a;
+    a = b;
+    b = temp;
+  }
 
-    free(b);
+  int outputCount = net->neuronsInLayersCount[net->layerCount-1];
+  for(int r = 0; r < rowCount; ++r){
+    memcpy(outputs + r*outputCount, a + r*layerInputStride,
+           outputCount * sizeof(float));
   }
 
-  return a;
+  searchArenaReset(arena, mark);
 }
 
-Tfcnn* fcnnSex(const Tfcnn* dad, const Tfcnn* mum, int mutationRareness)
+Tfcnn* fcnnSex(const Tfcnn* dad, const Tfcnn* mum, int mutationRareness,
+               Trng* rng)
 {
-  Tfcnn* baby = malloc(sizeof(Tfcnn));
-  baby->layerCount = dad->layerCount;
-  baby->neuronsInLayersCount = malloc(baby->layerCount * sizeof(int));
-  baby->neurons = malloc((baby->layerCount-1) * sizeof(Tneuron**));
+  Tfcnn* baby = allocfcnn(dad->layerCount, dad->neuronsInLayersCount,
+                          dad->activation, NULL);
+  fcnnSexInto(baby, dad, mum, mutationRareness, rng);
+
+  return baby;
+}
 
-  baby->neuronsInLayersCount[0] = dad->neuronsInLayersCount[0];
+void fcnnSexInto(Tfcnn* baby, const Tfcnn* dad, const Tfcnn* mum,
+                 int mutationRareness, Trng* rng)
+{
+  baby->activation = dad->activation;
 
   for(int i = 1; i < baby->layerCount; ++i){
-    baby->neuronsInLayersCount[i] = dad->neuronsInLayersCount[i];
-
-    baby->neurons[i-1] = malloc(baby->neuronsInLayersCount[i] *
-                                sizeof(Tneuron*));
     for(int j = 0; j < baby->neuronsInLayersCount[i]; ++j){
       
-      if(mutationRareness > 0 && rand() > (RAND_MAX / mutationRareness)){
-        baby->neurons[i-1][j] = initRandNeuron(baby->neuronsInLayersCount[i-1],
-                                               MIN_RAND_WEIGHT,
-                                               MAX_RAND_WEIGHT);
+      if(mutationRareness > 0 && rngUnit(rng) > 1.0f / mutationRareness){
+        randomizefcnnNeuron(baby, i, j, rng);
       } else {
-        if(rand() > RAND_MAX/2){
-          baby->neurons[i-1][j] = cpyNeuron(dad->neurons[i-1][j]);
+        if(rngUnit(rng) > 0.5f){
+          copyfcnnNeuron(baby, dad, i, j);
         } else {
-          baby->neurons[i-1][j] = cpyNeuron(mum->neurons[i-1][j]);
+          copyfcnnNeuron(baby, mum, i, j);
         }
       }
     }
   }
-  
+}
 
-  return baby;
+
+bool fcnnSelfTest(void)
+{
+  const int inputSetCount = 100;
+
+  TsimdLevel originalLevel = getSimdLevel();
+  int topologyCount = sizeof(fixedForwards) / sizeof(*fixedForwards);
+  bool ok = true;
+
+  for(int t = 0; t < topologyCount; ++t){
+    const int* counts = fixedForwards[t].neuronsInLayersCount;
+    int outputCount = counts[2];
+
+    for(int level = SIMD_SCALAR; level <= (int)detectSimdLevel(); ++level){
+      double maxErr = 0;
+
+      for(int a = 0; a < ACT_COUNT; ++a){
+        Tfcnn* net = initRandfcnn(3, counts, a);
+        float* inputs = malloc(counts[0] * sizeof(float));
+        float* ref = malloc(outputCount * sizeof(float));
+        float* y = malloc(outputCount * sizeof(float));
+
+        for(int r = 0; r < inputSetCount; ++r){
+          for(int i = 0; i < counts[0]; ++i){
+            inputs[i] = (float)rand() / RAND_MAX;
+          }
+
+          // generic loops on scalar level are reference
+          setSimdLevel(SIMD_SCALAR);
+          net->fixedForward = -1;
+          fcnnForward(net, inputs, ref);
+
+          setSimdLevel(level);
+          net->fixedForward = t;
+          fcnnForward(net, inputs, y);
+
+          for(int j = 0; j < outputCount; ++j){
+            maxErr = fmax(maxErr, fabs(y[j] - ref[j]));
+          }
+        }
+
+        free(inputs);
+        free(ref);
+        free(y);
+        freefcnn(net);
+      }
+
+      // scalar variant must be exact
+      bool levelOk = (level == SIMD_SCALAR) ? (maxErr == 0)
+                                            : (maxErr <= DENSE_TOLERANCE);
+      printf("fixed %d-%d-%d %-7s max error: %e %s\n",
+             counts[0], counts[1], counts[2], simdLevelName(level), maxErr,
+             levelOk ? "OK" : "FAILED");
+      ok = ok && levelOk;
+    }
+  }
+
+  setSimdLevel(originalLevel);
+
+  return ok;
 }
@@ -13,6 +13,10 @@
 #define MAX_RAND_WEIGHT 1
 
 #include "neuron.h"
+#include "dense.h"
+#include "rng.h"
+
+#include <stdbool.h>
 
 
 //fully connected neural network
@@ -25,19 +29,62 @@ typedef struct
   int* neuronsInLayersCount;
 
   /**
-   * array of arrays of pointers to all neurons in network
+   * array of weight matrices of all layers
    * 
    * there is one less layer than above layers state,
    * because input neurons are not neurons
+   * 
+   * weights[l][i * denseStride(neuronsInLayersCount[l+1]) + j] is weight of
+   * i-th input of j-th neuron in layer l+1 (one column per neuron, rows are
+   * padded by zeros, so dense kernels can use aligned vector loads)
    */
-  Tneuron*** neurons;
+  float** weights;
+
+  // array of bias vectors of all layers (padded same as weights)
+  float** biases;
+
+  // one aligned block of memory holding all weights and biases
+  float* params;
+
+  // false if params belong to someone else (see initfcnnView)
+  bool ownsParams;
+
+  // activation function of all neurons
+  Tactivation activation;
+
+  // index of forward pass specialized for topology of this net
+  // (chosen at creation, -1 if there is none and generic loops are used)
+  int fixedForward;
 
 } Tfcnn;
 
 /**
  * intits random fully connected neural network of given size
+ * 
+ * @note generator of weights is seeded by rand()
+ */
+Tfcnn* initRandfcnn(int layerCount, const int* neuronsInLayersCount,
+                    Tactivation activation);
+
+/**
+ * returns number of floats in params block of net of given size
+ * (divisible by DENSE_LANES)
+ */
+int fcnnParamCount(int layerCount, const int* neuronsInLayersCount);
+
+/**
+ * returns net using params as its weights and biases (params are not
+ * changed and are not freed by freefcnn)
+ * 
+ * @param params fcnnParamCount() floats aligned to DENSE_ALIGN
+ */
+Tfcnn* initfcnnView(int layerCount, const int* neuronsInLayersCount,
+                    Tactivation activation, float* params);
+
+/**
+ * sets all weights and biases to random values from rng
  */
-Tfcnn* initRandfcnn(int layerCount, const int* neuronsInLayersCount);
+void randomizefcnn(Tfcnn* n, Trng* rng);
 
 /**
  * frees fully connected neural network
@@ -51,6 +98,9 @@ void printfcnn(const Tfcnn* n);
 
 /**
  * prints fully connected neural network to file
+ * 
+ * @note activation is printed on line after layer sizes only if it is not
+ * ACT_SIGMOID, so files of sigmoid nets stay same as before
  */
 void fprintfcnn(FILE* out, const Tfcnn* n);
 
@@ -64,6 +114,8 @@ Tfcnn* getfcnn(void);
 /**
  * gets fully connected neural network from file
  * 
+ * nets without activation line get ACT_SIGMOID
+ * 
  * @return initialized fcnn or NULL for error
  */
 Tfcnn* fgetfcnn(FILE* in);
@@ -81,13 +133,52 @@ float* propagateLayer(const Tfcnn* net, const float* inputs, int layerIndex);
  */
 float* fcnnPredict(const Tfcnn* net, const float* inputs);
 
+/**
+ * same as fcnnPredict, but outputs are written to given array
+ * 
+ * uses forward pass specialized for topology of net if there is one
+ * (same results as generic one), so nothing gets allocated
+ * 
+ * @param outputs gets filled by neuronsInLayersCount[layerCount-1] floats
+ */
+void fcnnForward(const Tfcnn* net, const float* inputs, float* outputs);
+
+/**
+ * same as fcnnPredict for rowCount inputs at once (one matrix-matrix
+ * product per layer)
+ * 
+ * @param inputs rowCount rows of neuronsInLayersCount[0] floats
+ * @param outputs gets filled by rowCount rows of
+ *        neuronsInLayersCount[layerCount-1] floats
+ */
+void fcnnPredictBatch(const Tfcnn* net, const float* inputs, int rowCount,
+                      float* outputs);
+
 /**
  * returns baby of mum and dad in parameters
  * 
  * @param mutationRareness 1 in $(mutationRareness) neurons gets randomized
+ * @param rng generator of all random decisions (and new weights)
  *  
  * @note mum and dad must have the number of layers and neurons in them
+ * @note baby inherits activation of dad
+ */
+Tfcnn* fcnnSex(const Tfcnn* dad, const Tfcnn* mum, int mutationRareness,
+               Trng* rng);
+
+/**
+ * same as fcnnSex, but baby is written to existing net (of same size)
+ */
+void fcnnSexInto(Tfcnn* baby, const Tfcnn* dad, const Tfcnn* mum,
+                 int mutationRareness, Trng* rng);
+
+/**
+ * compares forward passes specialized for fixed topologies with generic
+ * one on every level supported by cpu and prints max errors to stdout
+ * 
+ * @return true if scalar variants are exact and others differ by less than
+ * DENSE_TOLERANCE
  */
-Tfcnn* fcnnSex(const Tfcnn* dad, const Tfcnn* mum, int mutationRareness);
+bool fcnnSelfTest(void);
 
 #endif
\ No newline at end of file
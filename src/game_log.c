@@ -0,0 +1,403 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "game_log.h"
+#include "chess_logic.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <omp.h>
+
+
+// promotion char of code (0 means no promotion or queen)
+static const char promotionChars[5] = {'\0', 'N', 'B', 'R', 'Q'};
+
+// longest game that fits to record (moveCount is 16 bit)
+#define GAME_RECORD_MAX_MOVES 0xFFFF
+
+// PGN movetext lines are wrapped at this length
+#define PGN_LINE_LEN 79
+
+
+TgameRecord* initGameRecord(void)
+{
+  TgameRecord* record = calloc(1, sizeof(TgameRecord));
+  if(record == NULL){
+    return NULL;
+  }
+  record->moveCapacity = 128;
+  record->moves = malloc(record->moveCapacity * sizeof(TgameRecordMove));
+  if(record->moves == NULL){
+    free(record);
+    return NULL;
+  }
+  record->result = 2;
+  return record;
+}
+
+void freeGameRecord(TgameRecord* record)
+{
+  free(record->moves);
+  free(record);
+}
+
+void startGameRecord(TgameRecord* record, int white, int black,
+                     const Tboard* start)
+{
+  record->white = white;
+  record->black = black;
+  record->result = 2;
+  record->moveCount = 0;
+  record->startFen[0] = '\0';
+  if(start != NULL){
+    char* fen = boardToFen(start);
+    strcpy(record->startFen, fen);
+    free(fen);
+  }
+}
+
+bool gameRecordAddMove(TgameRecord* record, const char* move, int depth,
+                       float evaluation, float seconds)
+{
+  if(record->moveCount >= GAME_RECORD_MAX_MOVES){
+    return false;
+  }
+  if(record->moveCount == record->moveCapacity){
+    TgameRecordMove* moves = realloc(record->moves, 2 * record->moveCapacity *
+                                                    sizeof(TgameRecordMove));
+    if(moves == NULL){
+      return false;
+    }
+    record->moves = moves;
+    record->moveCapacity *= 2;
+  }
+
+  TgameRecordMove* m = &record->moves[record->moveCount++];
+  m->move = gameLogEncodeMove(move);
+  m->depth = (depth < -1) ? -1 : (depth > 127) ? 127 : depth;
+  m->reserved = 0;
+  m->evaluation = evaluation;
+  m->seconds = seconds;
+  return true;
+}
+
+
+uint16_t gameLogEncodeMove(const char* move)
+{
+  int from = (move[0] - 'A') + 8*(move[1] - '1');
+  int to = (move[2] - 'A') + 8*(move[3] - '1');
+  int promotion = 0;
+  for(int i = 1; i < 5 && move[4] != '\0'; ++i){
+    if(promotionChars[i] == toupper(move[4])){
+      promotion = i;
+    }
+  }
+  return from | (to << 6) | (promotion << 12);
+}
+
+void gameLogDecodeMove(uint16_t code, char* move)
+{
+  int from = code & 63, to = (code >> 6) & 63, promotion = (code >> 12) & 7;
+  move[0] = 'A' + from%8;
+  move[1] = '1' + from/8;
+  move[2] = 'A' + to%8;
+  move[3] = '1' + to/8;
+  move[4] = (promotion < 5) ? promotionChars[promotion] : '\0';
+  move[5] = '\0';
+}
+
+
+TgameLog* openGameLog(const char* fileName)
+{
+  TgameLog* log = calloc(1, sizeof(TgameLog));
+  if(log == NULL){
+    return NULL;
+  }
+  log->file = fopen(fileName, "ab");
+  log->bufferCount = omp_get_max_threads();
+  log->buffers = calloc(log->bufferCount, sizeof(unsigned char*));
+  log->bufferFilled = calloc(log->bufferCount, sizeof(size_t));
+  bool ok = log->file != NULL && log->buffers != NULL &&
+            log->bufferFilled != NULL;
+  for(int t = 0; ok && t < log->bufferCount; ++t){
+    log->buffers[t] = malloc(GAME_LOG_BUFFER_SIZE);
+    ok = log->buffers[t] != NULL;
+  }
+
+  if(!ok){
+    if(log->file != NULL){
+      fclose(log->file);
+    }
+    for(int t = 0; log->buffers != NULL && t < log->bufferCount; ++t){
+      free(log->buffers[t]);
+    }
+    free(log->buffers);
+    free(log->bufferFilled);
+    free(log);
+    return NULL;
+  }
+
+  return log;
+}
+
+void closeGameLog(TgameLog* log)
+{
+  if(!gameLogFlush(log)){
+    fprintf(stderr, "can not write game log\n");
+  }
+  printf("game log: %ld games, %ld bytes in %ld writes\n",
+         log->records, log->bytes, log->flushes);
+
+  fclose(log->file);
+  for(int t = 0; t < log->bufferCount; ++t){
+    free(log->buffers[t]);
+  }
+  free(log->buffers);
+  free(log->bufferFilled);
+  free(log);
+}
+
+
+/**
+ * appends size bytes to file (the only place where threads meet)
+ */
+static bool gameLogAppend(TgameLog* log, const void* data, size_t size)
+{
+  bool ok;
+  #pragma omp critical(gameLogFile)
+  {
+    ok = fwrite(data, 1, size, log->file) == size;
+    log->bytes += size;
+    ++log->flushes;
+  }
+  return ok;
+}
+
+/**
+ * returns size of serialized record
+ */
+static size_t gameRecordSize(const TgameRecord* record)
+{
+  return sizeof(TgameRecordHeader) + strlen(record->startFen) +
+         record->moveCount * sizeof(TgameRecordMove);
+}
+
+/**
+ * serializes record to dest (gameRecordSize bytes)
+ */
+static void serializeGameRecord(const TgameRecord* record, int generation,
+                                unsigned char* dest)
+{
+  size_t fenLength = strlen(record->startFen);
+  TgameRecordHeader h;
+  h.magic = GAME_LOG_MAGIC;
+  h.white = record->white;
+  h.black = record->black;
+  h.generation = generation;
+  h.round = record->round;
+  h.index = record->index;
+  h.result = record->result;
+  h.fenLength = fenLength;
+  h.moveCount = record->moveCount;
+
+  memcpy(dest, &h, sizeof(h));
+  memcpy(dest + sizeof(h), record->startFen, fenLength);
+  memcpy(dest + sizeof(h) + fenLength, record->moves,
+         record->moveCount * sizeof(TgameRecordMove));
+}
+
+bool gameLogWrite(TgameLog* log, const TgameRecord* record)
+{
+  int thread = omp_get_thread_num();
+  size_t size = gameRecordSize(record);
+  bool ok = true;
+
+  #pragma omp atomic
+  ++log->records;
+
+  // thread without buffer (nested parallelism) or huge game
+  if(thread >= log->bufferCount || size > GAME_LOG_BUFFER_SIZE){
+    unsigned char* data = malloc(size);
+    if(data == NULL){
+      return false;
+    }
+    serializeGameRecord(record, log->generation, data);
+    ok = gameLogAppend(log, data, size);
+    free(data);
+    return ok;
+  }
+
+  if(log->bufferFilled[thread] + size > GAME_LOG_BUFFER_SIZE){
+    ok = gameLogAppend(log, log->buffers[thread], log->bufferFilled[thread]);
+    log->bufferFilled[thread] = 0;
+  }
+  serializeGameRecord(record, log->generation,
+                      log->buffers[thread] + log->bufferFilled[thread]);
+  log->bufferFilled[thread] += size;
+
+  return ok;
+}
+
+bool gameLogFlush(TgameLog* log)
+{
+  bool ok = true;
+  for(int t = 0; t < log->bufferCount; ++t){
+    if(log->bufferFilled[t] > 0){
+      ok = gameLogAppend(log, log->buffers[t], log->bufferFilled[t]) && ok;
+      log->bufferFilled[t] = 0;
+    }
+  }
+  return (fflush(log->file) == 0) && ok;
+}
+
+
+bool freadGameRecord(FILE* in, TgameRecord* record)
+{
+  TgameRecordHeader h;
+  if(fread(&h, sizeof(h), 1, in) != 1 || h.magic != GAME_LOG_MAGIC ||
+     h.fenLength >= FEN_MAX_LEN ||
+     fread(record->startFen, 1, h.fenLength, in) != h.fenLength){
+    return false;
+  }
+  record->startFen[h.fenLength] = '\0';
+
+  if(h.moveCount > record->moveCapacity){
+    TgameRecordMove* moves = realloc(record->moves,
+                                     h.moveCount * sizeof(TgameRecordMove));
+    if(moves == NULL){
+      return false;
+    }
+    record->moves = moves;
+    record->moveCapacity = h.moveCount;
+  }
+  if(fread(record->moves, sizeof(TgameRecordMove), h.moveCount, in) !=
+     h.moveCount){
+    return false;
+  }
+
+  record->white = h.white;
+  record->black = h.black;
+  record->generation = h.generation;
+  record->round = h.round;
+  record->index = h.index;
+  record->result = h.result;
+  record->moveCount = h.moveCount;
+  return true;
+}
+
+
+/**
+ * writes token to PGN movetext, wraps lines
+ */
+static void printPgnToken(FILE* out, const char* token, int* lineLen)
+{
+  int len = strlen(token);
+  if(*lineLen > 0 && *lineLen + 1 + len > PGN_LINE_LEN){
+    fputc('\n', out);
+    *lineLen = 0;
+  } else if(*lineLen > 0){
+    fputc(' ', out);
+    ++*lineLen;
+  }
+  fputs(token, out);
+  *lineLen += len;
+}
+
+/**
+ * writes name of player with id to PGN tag
+ */
+static void printPgnPlayer(FILE* out, const char* tag, int id)
+{
+  if(id == GAME_LOG_PRIMITIVE_ID){
+    fprintf(out, "[%s \"primitiveEval\"]\n", tag);
+  } else {
+    fprintf(out, "[%s \"net %d\"]\n", tag, id);
+  }
+}
+
+bool fprintGameRecordPgn(FILE* out, const TgameRecord* record)
+{
+  Tboard* b;
+  if(record->startFen[0] == '\0'){
+    b = initBoard();
+  } else {
+    b = fenToBoard(record->startFen);
+    if(b == NULL){
+      return false;
+    }
+  }
+
+  const char* result = (record->result == 1) ? "1-0" :
+                       (record->result == -1) ? "0-1" :
+                       (record->result == 0) ? "1/2-1/2" : "*";
+
+  fprintf(out, "[Event \"evolution generation %d\"]\n", record->generation);
+  fprintf(out, "[Site \"?\"]\n");
+  fprintf(out, "[Date \"????.??.??\"]\n");
+  fprintf(out, "[Round \"%d.%d\"]\n", record->round + 1, record->index + 1);
+  printPgnPlayer(out, "White", record->white);
+  printPgnPlayer(out, "Black", record->black);
+  fprintf(out, "[Result \"%s\"]\n", result);
+  if(record->startFen[0] != '\0'){
+    fprintf(out, "[SetUp \"1\"]\n[FEN \"%s\"]\n", record->startFen);
+  }
+  fputc('\n', out);
+
+  bool ok = true;
+  int lineLen = 0;
+  char token[64], move[MAX_INP_LEN], san[16];
+  for(int i = 0; ok && i < record->moveCount; ++i){
+    const TgameRecordMove* m = &record->moves[i];
+    bool isWhite = (b->move%2 == 0);
+    if(isWhite || i == 0){
+      snprintf(token, sizeof(token), isWhite ? "%d." : "%d...",
+               b->move/2 + 1);
+      printPgnToken(out, token, &lineLen);
+    }
+
+    gameLogDecodeMove(m->move, move);
+    ok = moveToSan(b, move, san);
+    if(ok){
+      moveBoard(move, b);
+      printPgnToken(out, san, &lineLen);
+      snprintf(token, sizeof(token), "{%+.2f/%d %.3fs}",
+               m->evaluation, m->depth, m->seconds);
+      printPgnToken(out, token, &lineLen);
+    }
+  }
+  printPgnToken(out, result, &lineLen);
+  fputs("\n\n", out);
+
+  freeBoard(b);
+  return ok;
+}
+
+int exportGameLogPgn(const char* logFileName, FILE* out)
+{
+  FILE* in = fopen(logFileName, "rb");
+  if(in == NULL){
+    return -1;
+  }
+  TgameRecord* record = initGameRecord();
+  if(record == NULL){
+    fclose(in);
+    return -1;
+  }
+
+  int count = 0;
+  while(freadGameRecord(in, record)){
+    if(fprintGameRecordPgn(out, record)){
+      ++count;
+    } else {
+      fprintf(stderr, "game %d of log has illegal move\n", count + 1);
+    }
+  }
+
+  freeGameRecord(record);
+  fclose(in);
+  return count;
+}
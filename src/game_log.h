@@ -0,0 +1,215 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_GAME_LOG_H
+#define __MODULE_GAME_LOG_H
+
+#include "chess_structs.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// default game log of evolution
+#define GAME_LOG_FILE "population/games.bin"
+
+// first bytes of every record ("GREC"), marks start of record
+#define GAME_LOG_MAGIC 0x43455247u
+
+// id of player without net (primitiveEval)
+#define GAME_LOG_PRIMITIVE_ID -2
+
+// size of per thread buffer, it is written to file when full
+#define GAME_LOG_BUFFER_SIZE (64 * 1024)
+
+
+/**
+ * header of one game in binary log
+ *
+ * header is followed by fenLength chars of starting FEN (without '\0',
+ * 0 for initial position) and by moveCount TgameRecordMove
+ */
+typedef struct {
+
+  uint32_t magic;
+
+  // ids of nets (TchNet.id or GAME_LOG_PRIMITIVE_ID)
+  int32_t white;
+  int32_t black;
+
+  // generation of evolution, round of tournament and index of game in round
+  int32_t generation;
+  int32_t round;
+  int32_t index;
+
+  // result of gameFrom (0, 1 or -1)
+  int8_t result;
+  uint8_t fenLength;
+  uint16_t moveCount;
+
+} TgameRecordHeader;
+
+/**
+ * one move of game and search that chose it
+ */
+typedef struct {
+
+  // move encoded by gameLogEncodeMove
+  uint16_t move;
+
+  // depth of finished search (-1 if unknown)
+  int8_t depth;
+  uint8_t reserved;
+
+  // value of move from white`s point of view
+  float evaluation;
+
+  // time spent by search
+  float seconds;
+
+} TgameRecordMove;
+
+
+/**
+ * game in memory (filled by gameFrom, written by gameLogWrite)
+ */
+typedef struct {
+
+  int white;
+  int black;
+  int generation;
+  int round;
+  int index;
+  int result;
+
+  // starting FEN (empty string for initial position)
+  char startFen[FEN_MAX_LEN];
+
+  TgameRecordMove* moves;
+  int moveCount;
+  int moveCapacity;
+
+} TgameRecord;
+
+
+/**
+ * append-only log of games shared by all threads
+ *
+ * every thread serializes its games to its own buffer, buffer goes to file
+ * (under lock) only when it is full or on gameLogFlush, so threads almost
+ * never wait for each other or for disk
+ */
+typedef struct {
+
+  FILE* file;
+
+  // one buffer per thread (index is omp_get_thread_num())
+  int bufferCount;
+  unsigned char** buffers;
+  size_t* bufferFilled;
+
+  // stamped to every written record (set by owner of log)
+  int generation;
+
+  // statistics
+  long records;
+  long bytes;
+  long flushes;
+
+} TgameLog;
+
+
+/**
+ * returns empty record (NULL if error)
+ */
+TgameRecord* initGameRecord(void);
+
+/**
+ * frees record
+ */
+void freeGameRecord(TgameRecord* record);
+
+/**
+ * removes all moves and sets players and start of new game
+ *
+ * @param white net id of white (TchNet.id or GAME_LOG_PRIMITIVE_ID)
+ * @param start starting position (NULL for initial position)
+ */
+void startGameRecord(TgameRecord* record, int white, int black,
+                     const Tboard* start);
+
+/**
+ * appends move of game to record
+ *
+ * @return false if error (record is full or allocation failed)
+ */
+bool gameRecordAddMove(TgameRecord* record, const char* move, int depth,
+                       float evaluation, float seconds);
+
+/**
+ * encodes move ("E2E4", "E7E8N") to 16 bits (from, to and promotion)
+ */
+uint16_t gameLogEncodeMove(const char* move);
+
+/**
+ * decodes move encoded by gameLogEncodeMove
+ *
+ * @param move gets filled (length == MAX_INP_LEN)
+ */
+void gameLogDecodeMove(uint16_t code, char* move);
+
+
+/**
+ * opens log for appending (file is created if it doesn`t exist)
+ *
+ * @return NULL if error
+ */
+TgameLog* openGameLog(const char* fileName);
+
+/**
+ * flushes all buffers, prints statistics and closes log
+ */
+void closeGameLog(TgameLog* log);
+
+/**
+ * writes record to buffer of calling thread (safe to call from many
+ * threads at once)
+ *
+ * @return false if writing to file failed
+ */
+bool gameLogWrite(TgameLog* log, const TgameRecord* record);
+
+/**
+ * writes buffers of all threads to file
+ *
+ * @note must not be called while other threads write to log
+ */
+bool gameLogFlush(TgameLog* log);
+
+
+/**
+ * reads next record from binary log
+ *
+ * @return false at the end of file or if record is corrupted
+ */
+bool freadGameRecord(FILE* in, TgameRecord* record);
+
+/**
+ * writes game as PGN (SAN moves, depth/eval/time of every move in comment)
+ *
+ * @return false if moves of record are not legal
+ */
+bool fprintGameRecordPgn(FILE* out, const TgameRecord* record);
+
+/**
+ * converts whole binary log to PGN
+ *
+ * @return number of exported games, -1 if log can not be opened
+ */
+int exportGameLogPgn(const char* logFileName, FILE* out);
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "game_sched.h"
+#include "ai.h"
+#include "logger.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <omp.h>
+
+
+// log and dataset given to new schedulers
+static TgameLog* defaultLog = NULL;
+static TposDataset* defaultDataset = NULL;
+
+void setGameSchedulerLog(TgameLog* log)
+{
+  defaultLog = log;
+}
+
+void setGameSchedulerDataset(TposDataset* dataset)
+{
+  defaultDataset = dataset;
+}
+
+
+TgameScheduler* initGameScheduler(void)
+{
+  TgameScheduler* sched = calloc(1, sizeof(TgameScheduler));
+  if(sched == NULL){
+    return NULL;
+  }
+
+  sched->taskCapacity = 64;
+  sched->tasks = malloc(sched->taskCapacity * sizeof(TgameTask));
+
+  sched->threadCount = 0;
+  sched->threadGames = calloc(omp_get_max_threads(), sizeof(int));
+  sched->threadBusySeconds = calloc(omp_get_max_threads(), sizeof(double));
+  sched->log = defaultLog;
+  sched->dataset = defaultDataset;
+
+  if(sched->tasks == NULL || sched->threadGames == NULL ||
+     sched->threadBusySeconds == NULL){
+    freeGameScheduler(sched);
+    return NULL;
+  }
+
+  return sched;
+}
+
+void freeGameScheduler(TgameScheduler* sched)
+{
+  free(sched->tasks);
+  free(sched->threadGames);
+  free(sched->threadBusySeconds);
+  free(sched);
+}
+
+void clearGameScheduler(TgameScheduler* sched)
+{
+  sched->taskCount = 0;
+  sched->nextTask = 0;
+}
+
+int gameSchedulerAdd(TgameScheduler* sched, const TchNet* white,
+                     const TchNet* black, int round, int index)
+{
+  return gameSchedulerAddFrom(sched, white, black, NULL, round, index);
+}
+
+int gameSchedulerAddFrom(TgameScheduler* sched, const TchNet* white,
+                         const TchNet* black, const Tboard* start,
+                         int round, int index)
+{
+  if(sched->taskCount == sched->taskCapacity){
+    TgameTask* tasks = realloc(sched->tasks,
+                               2 * sched->taskCapacity * sizeof(TgameTask));
+    if(tasks == NULL){
+      return -1;
+    }
+    sched->tasks = tasks;
+    sched->taskCapacity *= 2;
+  }
+
+  TgameTask* task = &sched->tasks[sched->taskCount];
+  task->white = white;
+  task->black = black;
+  task->start = start;
+  task->round = round;
+  task->index = index;
+  task->result = GAME_NOT_PLAYED;
+
+  return sched->taskCount++;
+}
+
+
+void runGameScheduler(TgameScheduler* sched, float timeForMove,
+                      bool printResults)
+{
+  const int maxThreads = omp_get_max_threads();
+  sched->nextTask = 0;
+  sched->threadCount = 0;
+  sched->stopped = false;
+  for(int t = 0; t < maxThreads; ++t){
+    sched->threadGames[t] = 0;
+    sched->threadBusySeconds[t] = 0;
+  }
+
+  double start = omp_get_wtime();
+
+  #pragma omp parallel num_threads(maxThreads)
+  {
+    #pragma omp single nowait
+    sched->threadCount = omp_get_num_threads();
+
+    int thread = omp_get_thread_num();
+    int games = 0;
+    double busy = 0;
+    // moves of game being played (only if games are logged or exported)
+    TgameRecord* record = (sched->log != NULL || sched->dataset != NULL) ?
+                          initGameRecord() : NULL;
+
+    while(true){
+      int k = __atomic_fetch_add(&sched->nextTask, 1, __ATOMIC_RELAXED);
+      if(k >= sched->taskCount){
+        break;
+      }
+      TgameTask* task = &sched->tasks[k];
+
+      double gameStart = omp_get_wtime();
+      task->result = gameFrom(task->white, task->black, task->start,
+                              timeForMove, &sched->stopped, record);
+      busy += omp_get_wtime() - gameStart;
+      ++games;
+
+      if(record != NULL && task->result != GAME_NOT_PLAYED){
+        record->round = task->round;
+        record->index = task->index;
+        if(sched->log != NULL){
+          gameLogWrite(sched->log, record);
+        }
+        if(sched->dataset != NULL){
+          posDatasetAddGame(sched->dataset, record);
+        }
+      }
+
+      logEvent(printResults ? LOG_INFO : LOG_DEBUG, "game",
+               "round=%d index=%d white=%d black=%d result=%s seconds=%.3f",
+               task->round+1, task->index+1,
+               (task->white != NULL) ? task->white->id : GAME_LOG_PRIMITIVE_ID,
+               (task->black != NULL) ? task->black->id : GAME_LOG_PRIMITIVE_ID,
+               (task->result == 1) ? "white" :
+               (task->result == -1) ? "black" :
+               (task->result == 0) ? "draw" : "cancelled",
+               omp_get_wtime() - gameStart);
+
+      if(sched->onResult != NULL){
+        bool goOn;
+        #pragma omp critical(gameSchedulerResult)
+        {
+          goOn = !sched->stopped &&
+                 sched->onResult(sched, k, sched->onResultData);
+          if(!goOn){
+            __atomic_store_n(&sched->stopped, true, __ATOMIC_RELAXED);
+            // nobody takes another game
+            __atomic_store_n(&sched->nextTask, sched->taskCount,
+                             __ATOMIC_RELAXED);
+          }
+        }
+      }
+    }
+
+    sched->threadGames[thread] = games;
+    sched->threadBusySeconds[thread] = busy;
+    if(record != NULL){
+      freeGameRecord(record);
+    }
+  }
+
+  sched->wallSeconds = omp_get_wtime() - start;
+  // results of games come before report of scheduler
+  flushLogger();
+
+  if(sched->log != NULL && !gameLogFlush(sched->log)){
+    fprintf(stderr, "can not write game log\n");
+  }
+  if(sched->dataset != NULL && !posDatasetFlush(sched->dataset)){
+    fprintf(stderr, "can not write position dataset\n");
+  }
+}
+
+
+void gameSchedulerReport(const TgameScheduler* sched)
+{
+  double busySum = 0;
+  printf("scheduler: %d games in %.2f s on %d threads\n",
+         sched->taskCount, sched->wallSeconds, sched->threadCount);
+
+  for(int t = 0; t < sched->threadCount; ++t){
+    busySum += sched->threadBusySeconds[t];
+    printf("  thread %2d: %4d games, busy %7.2f s (%5.1f %%)\n",
+           t, sched->threadGames[t], sched->threadBusySeconds[t],
+           (sched->wallSeconds > 0) ?
+             (100.0 * sched->threadBusySeconds[t] / sched->wallSeconds) : 0);
+  }
+
+  if(sched->threadCount > 0 && sched->wallSeconds > 0){
+    printf("  utilization: %.1f %%\n",
+           100.0 * busySum / (sched->threadCount * sched->wallSeconds));
+  }
+}
@@ -0,0 +1,157 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_GAME_SCHED_H
+#define __MODULE_GAME_SCHED_H
+
+#include "chess_net.h"
+#include "chess_structs.h"
+#include "game_log.h"
+#include "pos_dataset.h"
+
+#include <stdbool.h>
+
+
+/**
+ * one game waiting in scheduler (and its result after run)
+ */
+typedef struct {
+
+  // players (NULL means primitiveEval)
+  const TchNet* white;
+  const TchNet* black;
+
+  // starting position (NULL means initial position), not owned by task
+  const Tboard* start;
+
+  // only for printing, round of tournament and index of game in round
+  int round;
+  int index;
+
+  // result of game(), GAME_NOT_PLAYED until game is finished
+  int result;
+
+} TgameTask;
+
+// result of task that was not played yet
+#define GAME_NOT_PLAYED 2
+
+
+typedef struct TgameScheduler TgameScheduler;
+
+/**
+ * called after every finished game (never by two threads at once)
+ *
+ * @return false to stop the run (no other game is started and games being
+ *         played are cancelled)
+ */
+typedef bool (*TgameResultCallback)(TgameScheduler* sched, int taskIndex,
+                                    void* data);
+
+/**
+ * shared queue of games
+ *
+ * all games are known before run, so games of all rounds are played as
+ * independent tasks. Every thread takes next unplayed game as soon as it
+ * finishes its previous one, so long games don`t keep other threads waiting.
+ */
+struct TgameScheduler {
+
+  TgameTask* tasks;
+  int taskCount;
+  int taskCapacity;
+
+  // head of queue (index of next game to be taken), changed atomically
+  int nextTask;
+
+  // statistics of last run (one entry per thread)
+  int threadCount;
+  int* threadGames;
+  double* threadBusySeconds;
+  double wallSeconds;
+
+  // optional callback of finished games (NULL if not used) and its data
+  TgameResultCallback onResult;
+  void* onResultData;
+
+  // true if last run was stopped by onResult, games being played when it
+  // was set are cancelled (their result is GAME_NOT_PLAYED)
+  bool stopped;
+
+  // finished games are written here (NULL if not logged), see
+  // setGameSchedulerLog
+  TgameLog* log;
+
+  // positions of finished games are exported here (NULL if not exported)
+  TposDataset* dataset;
+
+};
+
+
+/**
+ * sets log used by every scheduler initialized later (NULL for none)
+ *
+ * tournaments create their own schedulers, so owner of log (evolution)
+ * sets it once for all of them
+ */
+void setGameSchedulerLog(TgameLog* log);
+
+/**
+ * sets position dataset used by every scheduler initialized later (NULL for
+ * none), same as setGameSchedulerLog
+ */
+void setGameSchedulerDataset(TposDataset* dataset);
+
+
+/**
+ * returns empty scheduler
+ */
+TgameScheduler* initGameScheduler(void);
+
+/**
+ * frees scheduler
+ */
+void freeGameScheduler(TgameScheduler* sched);
+
+/**
+ * removes all games (keeps allocated memory)
+ */
+void clearGameScheduler(TgameScheduler* sched);
+
+/**
+ * adds game to the end of queue
+ *
+ * @return index of task or -1 if error
+ */
+int gameSchedulerAdd(TgameScheduler* sched, const TchNet* white,
+                     const TchNet* black, int round, int index);
+
+/**
+ * same as gameSchedulerAdd, but game starts from position start
+ */
+int gameSchedulerAddFrom(TgameScheduler* sched, const TchNet* white,
+                         const TchNet* black, const Tboard* start,
+                         int round, int index);
+
+/**
+ * plays all games in queue on all threads (OpenMP)
+ *
+ * @param printResults log result of every game when it finishes at level
+ *        info (else at level debug)
+ *
+ * @note if onResult stops the run, unplayed games keep GAME_NOT_PLAYED
+ * @note cancelled games are not logged, log and dataset are flushed at the
+ *       end of run
+ */
+void runGameScheduler(TgameScheduler* sched, float timeForMove,
+                      bool printResults);
+
+/**
+ * prints games, busy time and utilization of every thread in last run
+ */
+void gameSchedulerReport(const TgameScheduler* sched);
+
+#endif
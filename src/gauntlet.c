@@ -0,0 +1,142 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "gauntlet.h"
+#include "game_sched.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+
+typedef struct {
+  Tgauntlet* gauntlet;
+  bool stopOnWinner;
+} TgauntletRun;
+
+/**
+ * records result of game, net i plays tasks 2i (white) and 2i+1 (black)
+ */
+static bool gauntletOnResult(TgameScheduler* sched, int taskIndex, void* data)
+{
+  TgauntletRun* run = data;
+  Tgauntlet* g = run->gauntlet;
+  int net = taskIndex / 2;
+  int result = sched->tasks[taskIndex].result;
+
+  if(result == GAME_NOT_PLAYED){
+    return true;
+  }
+
+  if(taskIndex % 2 == 0){
+    g->whiteResults[net] = result;
+    g->scores[net] += (result == 1) ? 1.0 : (result == 0) ? 0.5 : 0.0;
+  } else {
+    g->blackResults[net] = result;
+    g->scores[net] += (result == -1) ? 1.0 : (result == 0) ? 0.5 : 0.0;
+  }
+  ++g->gamesPlayed;
+
+  if(g->winner == -1 && g->whiteResults[net] == 1 &&
+     g->blackResults[net] == -1){
+    g->winner = net;
+    return !run->stopOnWinner;
+  }
+  return true;
+}
+
+Tgauntlet* runGauntlet(TchNet** population, int populationCount,
+                       float timeForMove, bool stopOnWinner)
+{
+  Tgauntlet* g = malloc(sizeof(Tgauntlet));
+  TgameScheduler* sched = initGameScheduler();
+  if(g == NULL || sched == NULL){
+    free(g);
+    if(sched != NULL){
+      freeGameScheduler(sched);
+    }
+    return NULL;
+  }
+
+  g->netCount = populationCount;
+  g->whiteResults = malloc(populationCount * sizeof(int));
+  g->blackResults = malloc(populationCount * sizeof(int));
+  g->scores = calloc(populationCount, sizeof(float));
+  g->gamesPlayed = 0;
+  g->winner = -1;
+
+  bool ok = g->whiteResults != NULL && g->blackResults != NULL &&
+            g->scores != NULL;
+  // callback finds net by task index, so no game can be left out
+  for(int i = 0; ok && i < populationCount; ++i){
+    g->whiteResults[i] = GAME_NOT_PLAYED;
+    g->blackResults[i] = GAME_NOT_PLAYED;
+    ok = gameSchedulerAdd(sched, population[i], NULL, 0, 2*i) >= 0 &&
+         gameSchedulerAdd(sched, NULL, population[i], 0, 2*i + 1) >= 0;
+  }
+  if(!ok){
+    freeGameScheduler(sched);
+    freeGauntlet(g);
+    return NULL;
+  }
+
+  TgauntletRun run = {g, stopOnWinner};
+  sched->onResult = gauntletOnResult;
+  sched->onResultData = &run;
+  runGameScheduler(sched, timeForMove, false);
+
+  g->gamesCancelled = 2*populationCount - g->gamesPlayed;
+  g->seconds = sched->wallSeconds;
+
+  freeGameScheduler(sched);
+  return g;
+}
+
+void freeGauntlet(Tgauntlet* gauntlet)
+{
+  free(gauntlet->whiteResults);
+  free(gauntlet->blackResults);
+  free(gauntlet->scores);
+  free(gauntlet);
+}
+
+
+/**
+ * returns result of game from view of net
+ */
+static const char* gauntletResultName(int result, bool netIsWhite)
+{
+  if(result == GAME_NOT_PLAYED){
+    return "-";
+  }
+  if(result == 0){
+    return "draw";
+  }
+  return ((result == 1) == netIsWhite) ? "won" : "lost";
+}
+
+void printGauntlet(const Tgauntlet* gauntlet)
+{
+  float scoreSum = 0;
+  for(int i = 0; i < gauntlet->netCount; ++i){
+    scoreSum += gauntlet->scores[i];
+    if(gauntlet->whiteResults[i] == GAME_NOT_PLAYED &&
+       gauntlet->blackResults[i] == GAME_NOT_PLAYED){
+      continue;
+    }
+    printf("net %3d: white %-4s black %-4s score %.1f\n", i,
+           gauntletResultName(gauntlet->whiteResults[i], true),
+           gauntletResultName(gauntlet->blackResults[i], false),
+           gauntlet->scores[i]);
+  }
+
+  printf("gauntlet: %d games played, %d cancelled in %.2f s, "
+         "score %.1f/%d\n",
+         gauntlet->gamesPlayed, gauntlet->gamesCancelled, gauntlet->seconds,
+         scoreSum, gauntlet->gamesPlayed);
+  if(gauntlet->winner >= 0){
+    printf("net %d won as white and as black\n", gauntlet->winner);
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_GAUNTLET_H
+#define __MODULE_GAUNTLET_H
+
+#include "chess_net.h"
+
+#include <stdbool.h>
+
+
+/**
+ * results of every net of population against primitiveEval
+ */
+typedef struct {
+
+  int netCount;
+
+  // results of game() of net i as white and as black
+  // (GAME_NOT_PLAYED if game was cancelled or not started)
+  int* whiteResults;
+  int* blackResults;
+
+  // points of net i (1 for win, 0.5 for draw)
+  float* scores;
+
+  // games finished and games cancelled or not started
+  int gamesPlayed;
+  int gamesCancelled;
+
+  // first net that won both games (-1 if none)
+  int winner;
+
+  double seconds;
+
+} Tgauntlet;
+
+
+/**
+ * lets every net play one game as white and one as black against
+ * primitiveEval, all 2*populationCount games are played in parallel
+ *
+ * @param stopOnWinner cancel remaining games (also ones being played) as
+ *        soon as some net wins both games
+ * @return results (NULL if error)
+ */
+Tgauntlet* runGauntlet(TchNet** population, int populationCount,
+                       float timeForMove, bool stopOnWinner);
+
+/**
+ * frees results of gauntlet
+ */
+void freeGauntlet(Tgauntlet* gauntlet);
+
+/**
+ * prints results of every net which played and statistics of gauntlet
+ */
+void printGauntlet(const Tgauntlet* gauntlet);
+
+#endif
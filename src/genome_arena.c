@@ -0,0 +1,194 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "genome_arena.h"
+#include "chess_net.h"
+#include "fcnn.h"
+#include "dense.h"
+#include "rng.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+
+// first bytes of snapshot
+#define GENOME_ARENA_MAGIC "NNARENA1"
+#define GENOME_ARENA_MAGIC_LEN 8
+
+// more layers are not expected in snapshot
+#define GENOME_ARENA_MAX_LAYERS 64
+
+
+/**
+ * returns arena with zeroed genomes (nets are not initialized)
+ */
+static TgenomeArena* allocGenomeArena(int netCount, int fcnnLayerCount,
+                                      const int* fcnnNeuronsInLayersCount,
+                                      Tactivation activation,
+                                      TchNetInput inputMode)
+{
+  if(netCount < 1 || fcnnNeuronsInLayersCount[0] != PREPR_NEURONS_COUNT){
+    return NULL;
+  }
+
+  TgenomeArena* arena = malloc(sizeof(TgenomeArena));
+  arena->netCount = netCount;
+  arena->genomeSize = chNetGenomeSize(fcnnLayerCount,
+                                      fcnnNeuronsInLayersCount);
+
+  size_t blockSize = (size_t)netCount * arena->genomeSize * sizeof(float);
+  arena->block = aligned_alloc(DENSE_ALIGN, blockSize);
+  arena->nets = malloc(netCount * sizeof(TchNet*));
+  if(arena->block == NULL || arena->nets == NULL){
+    free(arena->block);
+    free(arena->nets);
+    free(arena);
+    return NULL;
+  }
+  memset(arena->block, 0, blockSize);
+
+  for(int id = 0; id < netCount; ++id){
+    arena->nets[id] = initChNetView(fcnnLayerCount, fcnnNeuronsInLayersCount,
+                                    activation,
+                                    arena->block +
+                                    (size_t)id * arena->genomeSize);
+    arena->nets[id]->inputMode = inputMode;
+    arena->nets[id]->id = id;
+  }
+
+  return arena;
+}
+
+
+TgenomeArena* initRandGenomeArena(int netCount, int fcnnLayerCount,
+                                  const int* fcnnNeuronsInLayersCount,
+                                  Tactivation activation,
+                                  TchNetInput inputMode, uint64_t seed)
+{
+  TgenomeArena* arena = allocGenomeArena(netCount, fcnnLayerCount,
+                                         fcnnNeuronsInLayersCount,
+                                         activation, inputMode);
+  if(arena == NULL){
+    return NULL;
+  }
+
+  #pragma omp parallel for
+  for(int id = 0; id < netCount; ++id){
+    Trng rng;
+    rngSeed(&rng, seed, 0, id);
+    randomizeChNet(arena->nets[id], &rng);
+  }
+
+  return arena;
+}
+
+TgenomeArena* cloneGenomeArena(const TgenomeArena* arena)
+{
+  const Tfcnn* fcnn = arena->nets[0]->fcnn;
+  TgenomeArena* clone = allocGenomeArena(arena->netCount, fcnn->layerCount,
+                                         fcnn->neuronsInLayersCount,
+                                         fcnn->activation,
+                                         arena->nets[0]->inputMode);
+  if(clone == NULL){
+    return NULL;
+  }
+  copyGenomeArena(clone, arena);
+
+  return clone;
+}
+
+void copyGenomeArena(TgenomeArena* dest, const TgenomeArena* src)
+{
+  memcpy(dest->block, src->block,
+         (size_t)src->netCount * src->genomeSize * sizeof(float));
+  for(int id = 0; id < src->netCount; ++id){
+    dest->nets[id]->inputMode = src->nets[id]->inputMode;
+    dest->nets[id]->fcnn->activation = src->nets[id]->fcnn->activation;
+    if(dest->nets[id]->evalCache != NULL){
+      clearEvalCache(dest->nets[id]->evalCache);
+    }
+  }
+}
+
+void freeGenomeArena(TgenomeArena* arena)
+{
+  for(int id = 0; id < arena->netCount; ++id){
+    freeChNet(arena->nets[id]);
+  }
+  free(arena->nets);
+  free(arena->block);
+  free(arena);
+}
+
+
+bool fwriteGenomeArena(FILE* out, const TgenomeArena* arena)
+{
+  const Tfcnn* fcnn = arena->nets[0]->fcnn;
+
+  int32_t header[5] = {
+    arena->netCount, arena->genomeSize, fcnn->activation,
+    arena->nets[0]->inputMode, fcnn->layerCount
+  };
+
+  return fwrite(GENOME_ARENA_MAGIC, 1, GENOME_ARENA_MAGIC_LEN, out) ==
+           GENOME_ARENA_MAGIC_LEN &&
+         fwrite(header, sizeof(int32_t), 5, out) == 5 &&
+         fwrite(fcnn->neuronsInLayersCount, sizeof(int32_t),
+                fcnn->layerCount, out) == (size_t)fcnn->layerCount &&
+         fwrite(arena->block, sizeof(float) * arena->genomeSize,
+                arena->netCount, out) == (size_t)arena->netCount;
+}
+
+TgenomeArena* freadGenomeArena(FILE* in)
+{
+  char magic[GENOME_ARENA_MAGIC_LEN];
+  int32_t header[5];
+  if(fread(magic, 1, GENOME_ARENA_MAGIC_LEN, in) != GENOME_ARENA_MAGIC_LEN ||
+     memcmp(magic, GENOME_ARENA_MAGIC, GENOME_ARENA_MAGIC_LEN) != 0 ||
+     fread(header, sizeof(int32_t), 5, in) != 5){
+    return NULL;
+  }
+
+  int netCount = header[0], genomeSize = header[1], layerCount = header[4];
+  Tactivation activation = header[2];
+  TchNetInput inputMode = header[3];
+  if(netCount < 1 || layerCount < 2 || layerCount > GENOME_ARENA_MAX_LAYERS ||
+     activation < 0 || activation >= ACT_COUNT ||
+     inputMode < 0 || inputMode >= CHNET_INPUT_COUNT){
+    return NULL;
+  }
+
+  int32_t counts[GENOME_ARENA_MAX_LAYERS];
+  if(fread(counts, sizeof(int32_t), layerCount, in) != (size_t)layerCount){
+    return NULL;
+  }
+  for(int i = 0; i < layerCount; ++i){
+    if(counts[i] < 1){
+      return NULL;
+    }
+  }
+  if(chNetGenomeSize(layerCount, counts) != genomeSize){
+    return NULL;
+  }
+
+  TgenomeArena* arena = allocGenomeArena(netCount, layerCount, counts,
+                                         activation, inputMode);
+  if(arena == NULL){
+    return NULL;
+  }
+  if(fread(arena->block, sizeof(float) * genomeSize, netCount, in) !=
+     (size_t)netCount){
+    freeGenomeArena(arena);
+    return NULL;
+  }
+
+  for(int id = 0; id < netCount; ++id){
+    chNetGenomeChanged(arena->nets[id]);
+  }
+
+  return arena;
+}
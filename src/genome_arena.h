@@ -0,0 +1,89 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_GENOME_ARENA_H
+#define __MODULE_GENOME_ARENA_H
+
+#include "chess_net.h"
+#include "neuron.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/**
+ * whole population in one contiguous block of memory
+ *
+ * every net has fixed size slot (genome) with all its weights and biases,
+ * slot of net is given by its id. Nets are never freed during evolution,
+ * child is written to slot of dead net (chNetSexInto).
+ */
+typedef struct {
+
+  // number of slots (nets)
+  int netCount;
+
+  // floats in one slot (chNetGenomeSize)
+  int genomeSize;
+
+  // netCount*genomeSize floats aligned to DENSE_ALIGN
+  float* block;
+
+  // nets[id] is net using slot id
+  TchNet** nets;
+
+} TgenomeArena;
+
+
+/**
+ * returns arena with netCount random nets of same topology
+ *
+ * returns NULL if error (see initRandChNet)
+ *
+ * @param seed net with id is randomized by rngSeed(seed, 0, id), so
+ *        same seed gives same population
+ */
+TgenomeArena* initRandGenomeArena(int netCount, int fcnnLayerCount,
+                                  const int* fcnnNeuronsInLayersCount,
+                                  Tactivation activation,
+                                  TchNetInput inputMode, uint64_t seed);
+
+/**
+ * returns copy of arena (same topology, same genomes)
+ *
+ * returns NULL if error
+ */
+TgenomeArena* cloneGenomeArena(const TgenomeArena* arena);
+
+/**
+ * copies genomes (and input modes) of all nets from src to dest
+ *
+ * @note arenas must have same topology (dest is clone of src)
+ */
+void copyGenomeArena(TgenomeArena* dest, const TgenomeArena* src);
+
+/**
+ * frees arena and all its nets
+ */
+void freeGenomeArena(TgenomeArena* arena);
+
+/**
+ * writes snapshot of whole population to binary file
+ * (small header and then whole block in one write)
+ *
+ * @return false if writing failed
+ */
+bool fwriteGenomeArena(FILE* out, const TgenomeArena* arena);
+
+/**
+ * reads snapshot written by fwriteGenomeArena
+ *
+ * @return arena or NULL if error
+ */
+TgenomeArena* freadGenomeArena(FILE* in);
+
+#endif
@@ -0,0 +1,526 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "logger.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <omp.h>
+
+
+static const char* levelNames[LOG_LEVEL_COUNT] = {
+  "debug", "info", "warn", "error"
+};
+
+
+/**
+ * one logged event
+ */
+typedef struct {
+
+  // seconds since start of logger
+  double time;
+
+  int thread;
+  int level;
+  char event[LOG_EVENT_LEN];
+  char fields[LOG_FIELDS_LEN];
+
+} TlogRecord;
+
+/**
+ * records of one thread (single producer, single consumer)
+ *
+ * producer writes record to slot head, then publishes it by incrementing
+ * head, consumer reads slots up to head and frees them by incrementing
+ * tail. Counters are on their own cache lines, so producer and consumer
+ * don`t fight for them.
+ */
+typedef struct {
+
+  _Alignas(64) uint64_t head;
+  _Alignas(64) uint64_t tail;
+
+  // records lost because ring was full (and how many were reported)
+  _Alignas(64) long dropped;
+  long droppedReported;
+
+  // ring belongs to running thread (ring of ended thread gets reused)
+  bool isOwned;
+  int index;
+
+  TlogRecord records[LOG_RING_LEN];
+
+} TlogRing;
+
+
+// state of logger (there is only one consumer)
+static struct {
+
+  // rings of threads, ringCount can exceed LOG_MAX_THREADS (those threads
+  // have no ring)
+  TlogRing* rings[LOG_MAX_THREADS];
+  int ringCount;
+
+  // records of threads without ring
+  long lost;
+
+  int minLevel;
+  bool isRunning;
+
+  FILE* out;
+  bool ownsOut;
+  bool json;
+  double startTime;
+
+  // consumer thread, lock is held while rings are drained
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool quit;
+
+} logger = {
+  .minLevel = LOG_INFO,
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .wake = PTHREAD_COND_INITIALIZER,
+};
+
+// ring of calling thread (NULL until its first record)
+static _Thread_local TlogRing* threadRing = NULL;
+
+// frees ring when its thread ends
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+
+
+const char* logLevelName(TlogLevel level)
+{
+  return (level >= 0 && level < LOG_LEVEL_COUNT) ? levelNames[level] : "?";
+}
+
+bool isLogLevelEnabled(TlogLevel level)
+{
+  return level >= __atomic_load_n(&logger.minLevel, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * called when thread with ring ends
+ */
+static void releaseRing(void* ring)
+{
+  __atomic_store_n(&((TlogRing*)ring)->isOwned, false, __ATOMIC_RELEASE);
+}
+
+static void createRingKey(void)
+{
+  pthread_key_create(&ringKey, releaseRing);
+}
+
+/**
+ * returns ring of calling thread (NULL if there are too many threads)
+ */
+static TlogRing* getThreadRing(void)
+{
+  if(threadRing != NULL){
+    return threadRing;
+  }
+  pthread_once(&ringKeyOnce, createRingKey);
+
+  // ring of ended thread first
+  int count = __atomic_load_n(&logger.ringCount, __ATOMIC_ACQUIRE);
+  for(int i = 0; threadRing == NULL && i < count && i < LOG_MAX_THREADS;
+      ++i){
+    TlogRing* ring = __atomic_load_n(&logger.rings[i], __ATOMIC_ACQUIRE);
+    bool expected = false;
+    if(ring != NULL &&
+       __atomic_compare_exchange_n(&ring->isOwned, &expected, true, false,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+      threadRing = ring;
+    }
+  }
+
+  if(threadRing == NULL){
+    int i = __atomic_fetch_add(&logger.ringCount, 1, __ATOMIC_ACQ_REL);
+    if(i >= LOG_MAX_THREADS){
+      return NULL;
+    }
+    TlogRing* ring = aligned_alloc(_Alignof(TlogRing), sizeof(TlogRing));
+    if(ring == NULL){
+      return NULL;
+    }
+    ring->head = ring->tail = 0;
+    ring->dropped = ring->droppedReported = 0;
+    ring->isOwned = true;
+    ring->index = i;
+    __atomic_store_n(&logger.rings[i], ring, __ATOMIC_RELEASE);
+    threadRing = ring;
+  }
+
+  pthread_setspecific(ringKey, threadRing);
+  return threadRing;
+}
+
+
+void logEvent(TlogLevel level, const char* event, const char* fields, ...)
+{
+  if(!isLogLevelEnabled(level)){
+    return;
+  }
+
+  va_list args;
+  va_start(args, fields);
+
+  // without consumer, record is written right away
+  if(!__atomic_load_n(&logger.isRunning, __ATOMIC_ACQUIRE)){
+    char line[LOG_FIELDS_LEN];
+    vsnprintf(line, sizeof(line), fields, args);
+    va_end(args);
+    fprintf(stderr, "%-5s %s %s\n", logLevelName(level), event, line);
+    return;
+  }
+
+  TlogRing* ring = getThreadRing();
+  if(ring == NULL){
+    va_end(args);
+    __atomic_fetch_add(&logger.lost, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  uint64_t head = ring->head;
+  if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_LEN){
+    va_end(args);
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  TlogRecord* record = &ring->records[head & (LOG_RING_LEN - 1)];
+  record->time = omp_get_wtime() - logger.startTime;
+  record->thread = ring->index;
+  record->level = level;
+  snprintf(record->event, LOG_EVENT_LEN, "%s", event);
+  vsnprintf(record->fields, LOG_FIELDS_LEN, fields, args);
+  va_end(args);
+
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  // burst of records, consumer doesn`t wait for its period (signal without
+  // waiting consumer costs no syscall)
+  if(head + 1 - ring->tail == LOG_RING_LEN / 2){
+    pthread_cond_signal(&logger.wake);
+  }
+}
+
+
+/**
+ * writes len chars of s as JSON string
+ */
+static void fprintJsonString(FILE* out, const char* s, size_t len)
+{
+  fputc('"', out);
+  for(size_t i = 0; i < len; ++i){
+    unsigned char c = s[i];
+    if(c == '"' || c == '\\'){
+      fputc('\\', out);
+      fputc(c, out);
+    } else if(c < 0x20){
+      fprintf(out, "\\u%04x", c);
+    } else {
+      fputc(c, out);
+    }
+  }
+  fputc('"', out);
+}
+
+/**
+ * returns true if s is JSON number
+ */
+static bool isJsonNumber(const char* s)
+{
+  if(*s == '-') ++s;
+  if(*s == '0'){
+    ++s;
+  } else if(isdigit(*s)){
+    while(isdigit(*s)) ++s;
+  } else {
+    return false;
+  }
+  if(*s == '.'){
+    ++s;
+    if(!isdigit(*s)) return false;
+    while(isdigit(*s)) ++s;
+  }
+  if(*s == 'e' || *s == 'E'){
+    ++s;
+    if(*s == '+' || *s == '-') ++s;
+    if(!isdigit(*s)) return false;
+    while(isdigit(*s)) ++s;
+  }
+  return *s == '\0';
+}
+
+/**
+ * writes key=value fields as members of JSON object (key without value is
+ * true)
+ */
+static void fprintJsonFields(FILE* out, const char* fields)
+{
+  const char* p = fields;
+  while(true){
+    while(*p == ' ') ++p;
+    if(*p == '\0'){
+      break;
+    }
+
+    const char* key = p;
+    while(*p != '\0' && *p != '=' && *p != ' ') ++p;
+    size_t keyLen = p - key;
+
+    char value[LOG_FIELDS_LEN];
+    size_t valueLen = 0;
+    bool hasValue = (*p == '='), isQuoted = false;
+    if(hasValue){
+      ++p;
+      isQuoted = (*p == '"');
+      if(isQuoted){
+        ++p;
+        while(*p != '\0' && *p != '"'){
+          if(*p == '\\' && p[1] != '\0') ++p;
+          value[valueLen++] = *p++;
+        }
+        if(*p == '"') ++p;
+      } else {
+        while(*p != '\0' && *p != ' ') value[valueLen++] = *p++;
+      }
+    }
+    value[valueLen] = '\0';
+
+    fputc(',', out);
+    fprintJsonString(out, key, keyLen);
+    fputc(':', out);
+    if(!hasValue){
+      fputs("true", out);
+    } else if(!isQuoted && isJsonNumber(value)){
+      fputs(value, out);
+    } else {
+      fprintJsonString(out, value, valueLen);
+    }
+  }
+}
+
+/**
+ * writes record as one line of output
+ */
+static void writeLogRecord(const TlogRecord* record)
+{
+  if(!logger.json){
+    fprintf(logger.out, "%8.3f %-5s t%-2d %s %s\n", record->time,
+            logLevelName(record->level), record->thread, record->event,
+            record->fields);
+    return;
+  }
+
+  fprintf(logger.out, "{\"time\":%.6f,\"level\":\"%s\",\"thread\":%d,"
+                      "\"event\":", record->time,
+          logLevelName(record->level), record->thread);
+  fprintJsonString(logger.out, record->event, strlen(record->event));
+  fprintJsonFields(logger.out, record->fields);
+  fputs("}\n", logger.out);
+}
+
+/**
+ * writes warning about lost records as record of consumer
+ */
+static void writeLostWarning(int thread, long count)
+{
+  TlogRecord record;
+  record.time = omp_get_wtime() - logger.startTime;
+  record.thread = thread;
+  record.level = LOG_WARN;
+  strcpy(record.event, "log_dropped");
+  snprintf(record.fields, LOG_FIELDS_LEN, "records=%ld", count);
+  writeLogRecord(&record);
+}
+
+/**
+ * writes all published records of all rings ordered by time
+ *
+ * @note logger.lock must be held
+ */
+static void drainLogger(void)
+{
+  int count = __atomic_load_n(&logger.ringCount, __ATOMIC_ACQUIRE);
+  if(count > LOG_MAX_THREADS){
+    count = LOG_MAX_THREADS;
+  }
+
+  // records published so far (later ones wait for next drain)
+  uint64_t heads[LOG_MAX_THREADS];
+  for(int i = 0; i < count; ++i){
+    TlogRing* ring = __atomic_load_n(&logger.rings[i], __ATOMIC_ACQUIRE);
+    heads[i] = (ring != NULL) ? __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)
+                              : 0;
+  }
+
+  // merge of rings, every ring is ordered by time
+  while(true){
+    TlogRing* next = NULL;
+    for(int i = 0; i < count; ++i){
+      TlogRing* ring = logger.rings[i];
+      if(ring == NULL || ring->tail == heads[i]){
+        continue;
+      }
+      if(next == NULL ||
+         ring->records[ring->tail & (LOG_RING_LEN - 1)].time <
+           next->records[next->tail & (LOG_RING_LEN - 1)].time){
+        next = ring;
+      }
+    }
+    if(next == NULL){
+      break;
+    }
+
+    writeLogRecord(&next->records[next->tail & (LOG_RING_LEN - 1)]);
+    __atomic_store_n(&next->tail, next->tail + 1, __ATOMIC_RELEASE);
+  }
+
+  for(int i = 0; i < count; ++i){
+    TlogRing* ring = logger.rings[i];
+    if(ring == NULL){
+      continue;
+    }
+    long dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    if(dropped > ring->droppedReported){
+      writeLostWarning(i, dropped - ring->droppedReported);
+      ring->droppedReported = dropped;
+    }
+  }
+
+  fflush(logger.out);
+}
+
+/**
+ * consumer, drains rings every LOG_DRAIN_MS until logger is stopped
+ */
+static void* loggerThread(void* data)
+{
+  (void)data;
+
+  pthread_mutex_lock(&logger.lock);
+  while(!logger.quit){
+    drainLogger();
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += LOG_DRAIN_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    pthread_cond_timedwait(&logger.wake, &logger.lock, &deadline);
+  }
+  drainLogger();
+  pthread_mutex_unlock(&logger.lock);
+
+  return NULL;
+}
+
+
+bool startLogger(FILE* out, TlogLevel minLevel, bool json)
+{
+  stopLogger();
+
+  logger.out = out;
+  logger.ownsOut = false;
+  logger.json = json;
+  __atomic_store_n(&logger.minLevel, minLevel, __ATOMIC_RELAXED);
+  logger.startTime = omp_get_wtime();
+  logger.quit = false;
+
+  if(pthread_create(&logger.thread, NULL, loggerThread, NULL) != 0){
+    return false;
+  }
+  __atomic_store_n(&logger.isRunning, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool startLoggerFromEnv(void)
+{
+  TlogLevel level = LOG_INFO;
+  const char* levelName = getenv("NN_LOG_LEVEL");
+  if(levelName != NULL){
+    int i = 0;
+    while(i < LOG_LEVEL_COUNT && strcmp(levelNames[i], levelName) != 0){
+      ++i;
+    }
+    if(i < LOG_LEVEL_COUNT){
+      level = i;
+    } else {
+      fprintf(stderr, "unknown NN_LOG_LEVEL %s\n", levelName);
+    }
+  }
+
+  const char* format = getenv("NN_LOG_FORMAT");
+  bool json = (format != NULL && strcmp(format, "json") == 0);
+
+  FILE* out = stderr;
+  const char* fileName = getenv("NN_LOG_FILE");
+  if(fileName != NULL){
+    out = fopen(fileName, "a");
+    if(out == NULL){
+      fprintf(stderr, "can not open %s\n", fileName);
+      out = stderr;
+    }
+  }
+
+  if(!startLogger(out, level, json)){
+    if(out != stderr){
+      fclose(out);
+    }
+    return false;
+  }
+  logger.ownsOut = (out != stderr);
+  return true;
+}
+
+void stopLogger(void)
+{
+  if(!__atomic_load_n(&logger.isRunning, __ATOMIC_ACQUIRE)){
+    return;
+  }
+  __atomic_store_n(&logger.isRunning, false, __ATOMIC_RELEASE);
+
+  pthread_mutex_lock(&logger.lock);
+  logger.quit = true;
+  pthread_cond_signal(&logger.wake);
+  pthread_mutex_unlock(&logger.lock);
+  pthread_join(logger.thread, NULL);
+
+  long lost = __atomic_exchange_n(&logger.lost, 0, __ATOMIC_RELAXED);
+  if(lost > 0){
+    writeLostWarning(-1, lost);
+  }
+
+  if(logger.ownsOut){
+    fclose(logger.out);
+  } else {
+    fflush(logger.out);
+  }
+  logger.out = NULL;
+}
+
+void flushLogger(void)
+{
+  if(!__atomic_load_n(&logger.isRunning, __ATOMIC_ACQUIRE)){
+    return;
+  }
+  pthread_mutex_lock(&logger.lock);
+  drainLogger();
+  pthread_mutex_unlock(&logger.lock);
+}
@@ -0,0 +1,95 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_LOGGER_H
+#define __MODULE_LOGGER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+
+// records one thread can have waiting for consumer (power of two), newer
+// ones are dropped when ring is full
+#define LOG_RING_LEN 1024
+
+// max threads with their own ring (records of others are dropped)
+#define LOG_MAX_THREADS 256
+
+// max length of event name and of its fields
+#define LOG_EVENT_LEN 24
+#define LOG_FIELDS_LEN 216
+
+// consumer drains rings at least this often
+#define LOG_DRAIN_MS 20
+
+
+typedef enum {
+  LOG_DEBUG,
+  LOG_INFO,
+  LOG_WARN,
+  LOG_ERROR,
+  LOG_LEVEL_COUNT
+} TlogLevel;
+
+
+/**
+ * starts consumer thread writing records to out
+ *
+ * every thread writes its records to its own ring (no lock, no syscall),
+ * consumer merges them by time. Each line is either text
+ * ("  1.234 info  t3 game round=1 index=2") or JSON object
+ * ({"time":1.234,"level":"info","thread":3,"event":"game","round":1,...}).
+ *
+ * @param minLevel records of lower level are discarded by caller
+ * @param json true for JSON lines, false for text
+ * @return false if consumer can not be started (records are then written
+ *         directly to stderr)
+ */
+bool startLogger(FILE* out, TlogLevel minLevel, bool json);
+
+/**
+ * same as startLogger, settings are taken from environment variables
+ * NN_LOG_LEVEL=[debug | info | warn | error] (default info),
+ * NN_LOG_FORMAT=[text | json] (default text) and NN_LOG_FILE (appended,
+ * default stderr)
+ */
+bool startLoggerFromEnv(void);
+
+/**
+ * writes all waiting records, stops consumer and closes its file (can be
+ * passed to atexit)
+ */
+void stopLogger(void);
+
+/**
+ * writes all records waiting so far (called between parallel regions, so
+ * their records come before following output)
+ */
+void flushLogger(void);
+
+/**
+ * returns true if records of level are not discarded
+ */
+bool isLogLevelEnabled(TlogLevel level);
+
+/**
+ * adds record to ring of calling thread
+ *
+ * fields are space separated key=value pairs, values with spaces must be
+ * quoted (ex. "round=%d fen=\"%s\""). Numbers stay numbers in JSON, other
+ * values become strings.
+ *
+ * @param event name of event (ex. "game")
+ */
+void logEvent(TlogLevel level, const char* event, const char* fields, ...)
+  __attribute__((format(printf, 3, 4)));
+
+/**
+ * returns name of level ("debug", "info", ...)
+ */
+const char* logLevelName(TlogLevel level);
+
+#endif
@@ -5,14 +5,557 @@
  */
 
 #include "ai.h"
+#include "dense.h"
+#include "quant.h"
+#include "pop_batch.h"
+#include "sprt.h"
+#include "swiss.h"
+#include "checkpoint.h"
+#include "net_file.h"
+#include "pop_archive.h"
+#include "game_log.h"
+#include "pos_dataset.h"
+#include "epd.h"
+#include "uci.h"
+#include "logger.h"
+#include "chess_net.h"
+#include "fcnn.h"
+#include "chess_structs.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <omp.h>
 
 
-int main(){
+/**
+ * prints comparison of net in file with its quantized version
+ * 
+ * @param fenFileName positions to compare on (if NULL, random positions)
+ */
+static int quantTool(const char* netFileName, const char* fenFileName)
+{
+  const int randomPositionCount = 1000;
+  const int randomPositionMaxMoves = 80;
+
+  TchNet* net = loadNamedNet(netFileName);
+  if(net == NULL){
+    fprintf(stderr, "%s is not valid net\n", netFileName);
+    return EXIT_FAILURE;
+  }
+
+  int positionCount = randomPositionCount;
+  Tboard** positions;
+  if(fenFileName != NULL){
+    positions = loadFenFile(fenFileName, &positionCount);
+    if(positions == NULL){
+      fprintf(stderr, "can not open %s\n", fenFileName);
+      freeChNet(net);
+      return EXIT_FAILURE;
+    }
+  } else {
+    positions = randomPositions(positionCount, randomPositionMaxMoves);
+  }
+
+  quantReport(net, positions, positionCount);
+
+  for(int i = 0; i < positionCount; ++i){
+    freeBoard(positions[i]);
+  }
+  free(positions);
+  freeChNet(net);
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * prints comparison of evaluating random population one net after another
+ * and all nets at once (population batch)
+ * 
+ * @param fenFileName positions to evaluate (if NULL, random positions)
+ */
+static int popBatchTool(int netCount, const char* fenFileName)
+{
+  const int netStruct[3] = {64, 10, 1};
+  const int netStructLayerCount = sizeof(netStruct) / sizeof(*netStruct);
+  const int randomPositionCount = 1000;
+  const int randomPositionMaxMoves = 80;
+
+  if(netCount < 1){
+    fprintf(stderr, "net count must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  int positionCount = randomPositionCount;
+  Tboard** positions;
+  if(fenFileName != NULL){
+    positions = loadFenFile(fenFileName, &positionCount);
+    if(positions == NULL){
+      fprintf(stderr, "can not open %s\n", fenFileName);
+      return EXIT_FAILURE;
+    }
+  } else {
+    positions = randomPositions(positionCount, randomPositionMaxMoves);
+  }
+
+  TchNet** population = malloc(netCount * sizeof(TchNet*));
+  for(int i = 0; i < netCount; ++i){
+    population[i] = initRandChNet(netStructLayerCount, netStruct,
+                                  ACT_SIGMOID);
+  }
+
+  popBatchReport(population, netCount, positions, positionCount);
+
+  for(int i = 0; i < netCount; ++i){
+    freeChNet(population[i]);
+  }
+  free(population);
+  for(int i = 0; i < positionCount; ++i){
+    freeBoard(positions[i]);
+  }
+  free(positions);
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * frees both nets of sprt match (NULL ones are primitiveEval)
+ */
+static void freeSprtNets(TchNet** nets)
+{
+  for(int i = 0; i < 2; ++i){
+    if(nets[i] != NULL){
+      freeChNet(nets[i]);
+    }
+  }
+}
+
+
+/**
+ * sets one setting of sprt match from "key=value" argument
+ *
+ * keys are elo0, elo1, alpha, beta, pairs and time (seconds for move)
+ *
+ * @return true if OK (key is known and value is number)
+ */
+static bool parseSprtOption(TsprtConfig* config, const char* arg)
+{
+  const char* value = strchr(arg, '=');
+  if(value == NULL){
+    return false;
+  }
+  int keyLen = value - arg;
+  ++value;
+
+  char* end;
+  double number = strtod(value, &end);
+  if(end == value || *end != '\0'){
+    return false;
+  }
+
+  if(keyLen == 4 && strncmp(arg, "elo0", 4) == 0){
+    config->elo0 = number;
+  } else if(keyLen == 4 && strncmp(arg, "elo1", 4) == 0){
+    config->elo1 = number;
+  } else if(keyLen == 5 && strncmp(arg, "alpha", 5) == 0){
+    config->alpha = number;
+  } else if(keyLen == 4 && strncmp(arg, "beta", 4) == 0){
+    config->beta = number;
+  } else if(keyLen == 5 && strncmp(arg, "pairs", 5) == 0){
+    config->maxPairs = (int)number;
+  } else if(keyLen == 4 && strncmp(arg, "time", 4) == 0){
+    config->timeForMove = number;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * plays SPRT match of two nets (or net and primitive evaluation)
+ * 
+ * @param secondFileName "primitive" means primitiveEval
+ * @param args optional openings file (if missing, random short openings)
+ *        and "key=value" settings, see parseSprtOption
+ */
+static int sprtTool(const char* firstFileName, const char* secondFileName,
+                    int argCount, char** args)
+{
+  TsprtConfig config = {
+    .elo0 = 0,
+    .elo1 = 50,
+    .alpha = 0.05,
+    .beta = 0.05,
+    .maxPairs = 500,
+    .timeForMove = 0.05
+  };
+  const char* fenFileName = NULL;
+  for(int i = 0; i < argCount; ++i){
+    if(strchr(args[i], '=') == NULL && fenFileName == NULL){
+      fenFileName = args[i];
+    } else if(!parseSprtOption(&config, args[i])){
+      fprintf(stderr, "invalid sprt option %s\n", args[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  if(config.elo1 <= config.elo0 || config.alpha <= 0 || config.alpha >= 1 ||
+     config.beta <= 0 || config.beta >= 1 || config.maxPairs < 1 ||
+     config.timeForMove <= 0){
+    fprintf(stderr, "sprt needs elo0 < elo1, alpha and beta in (0, 1), "
+                    "pairs > 0 and time > 0\n");
+    return EXIT_FAILURE;
+  }
+  const int randomOpeningCount = 200;
+  const int randomOpeningMaxMoves = 8;
+
+  TchNet* nets[2] = {NULL, NULL};
+  const char* fileNames[2] = {firstFileName, secondFileName};
+  for(int i = 0; i < 2; ++i){
+    if(strcmp(fileNames[i], "primitive") == 0){
+      continue;
+    }
+    nets[i] = loadNamedNet(fileNames[i]);
+    if(nets[i] == NULL){
+      fprintf(stderr, "%s is not valid net\n", fileNames[i]);
+      freeSprtNets(nets);
+      return EXIT_FAILURE;
+    }
+  }
+
+  int openingCount = randomOpeningCount;
+  Tboard** openings;
+  if(fenFileName != NULL){
+    openings = loadFenFile(fenFileName, &openingCount);
+    if(openings == NULL){
+      fprintf(stderr, "can not open %s\n", fenFileName);
+      freeSprtNets(nets);
+      return EXIT_FAILURE;
+    }
+  } else {
+    openings = randomPositions(openingCount, randomOpeningMaxMoves);
+  }
+
+  printf("sprt: elo0 %.1f, elo1 %.1f, alpha %.3f, beta %.3f, "
+         "pairs %d, time %.3f\n",
+         config.elo0, config.elo1, config.alpha, config.beta,
+         config.maxPairs, config.timeForMove);
+  TsprtState state;
+  sprtMatch(nets[0], nets[1], openings, openingCount, &config, &state);
+  printSprtState(&state);
+
+  for(int i = 0; i < openingCount; ++i){
+    freeBoard(openings[i]);
+  }
+  free(openings);
+  freeSprtNets(nets);
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ * converts net between binary and text format
+ * 
+ * @param outFileName if it ends with ".txt", text format is written,
+ *        else binary one (if NULL, text is printed to stdout)
+ */
+static int exportTool(const char* inFileName, const char* outFileName)
+{
+  TchNet* net = loadNamedNet(inFileName);
+  if(net == NULL){
+    fprintf(stderr, "%s is not valid net\n", inFileName);
+    return EXIT_FAILURE;
+  }
+
+  bool ok;
+  size_t len = (outFileName != NULL) ? strlen(outFileName) : 0;
+  if(outFileName == NULL){
+    fprintChNet(stdout, net);
+    ok = true;
+  } else if(len >= 4 && strcmp(outFileName + len - 4, ".txt") == 0){
+    FILE* file = fopen(outFileName, "w");
+    ok = (file != NULL);
+    if(ok){
+      fprintChNet(file, net);
+      ok = (fclose(file) == 0);
+    }
+  } else {
+    ok = saveChNetBinary(outFileName, net);
+  }
+  freeChNet(net);
+
+  if(!ok){
+    fprintf(stderr, "can not write %s\n", outFileName);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * converts binary game log to PGN
+ * 
+ * @param outFileName PGN file (if NULL, PGN is printed to stdout)
+ */
+static int pgnTool(const char* logFileName, const char* outFileName)
+{
+  FILE* out = (outFileName != NULL) ? fopen(outFileName, "w") : stdout;
+  if(out == NULL){
+    fprintf(stderr, "can not write %s\n", outFileName);
+    return EXIT_FAILURE;
+  }
+
+  int count = exportGameLogPgn(logFileName, out);
+  if(outFileName != NULL){
+    fclose(out);
+  }
+
+  if(count < 0){
+    fprintf(stderr, "can not read %s\n", logFileName);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "%d games exported\n", count);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * exports positions of all games of game log to dataset shards
+ * 
+ * games are read in batches, every batch is replayed on all threads
+ */
+static int datasetTool(const char* logFileName, const char* prefix)
+{
+  const int batchSize = 256;
+
+  FILE* in = fopen(logFileName, "rb");
+  if(in == NULL){
+    fprintf(stderr, "can not read %s\n", logFileName);
+    return EXIT_FAILURE;
+  }
+  TposDataset* dataset = createPosDataset(prefix, POS_DATASET_SEEN_CAPACITY);
+  if(dataset == NULL){
+    fprintf(stderr, "can not create %s shards\n", prefix);
+    fclose(in);
+    return EXIT_FAILURE;
+  }
+
+  TgameRecord* records[batchSize];
+  for(int i = 0; i < batchSize; ++i){
+    records[i] = initGameRecord();
+  }
+
+  int count;
+  bool ok = true;
+  do {
+    for(count = 0; count < batchSize; ++count){
+      if(!freadGameRecord(in, records[count])){
+        break;
+      }
+    }
+
+    #pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+    for(int i = 0; i < count; ++i){
+      ok = posDatasetAddGame(dataset, records[i]) && ok;
+    }
+  } while(count == batchSize);
+
+  for(int i = 0; i < batchSize; ++i){
+    freeGameRecord(records[i]);
+  }
+  fclose(in);
+  closePosDataset(dataset);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * scans dataset shards (mapped to memory) and prints their statistics
+ */
+static int datastatTool(int shardCount, char** shardFileNames)
+{
+  long positions = 0, results[3] = {0, 0, 0}, blackToMove = 0;
+  double scoreSum = 0;
+  double start = omp_get_wtime();
+
+  for(int i = 0; i < shardCount; ++i){
+    TposShard* shard = mapPosShard(shardFileNames[i]);
+    if(shard == NULL){
+      fprintf(stderr, "%s is not position shard\n", shardFileNames[i]);
+      return EXIT_FAILURE;
+    }
+    for(size_t k = 0; k < shard->count; ++k){
+      const TpackedPos* p = &shard->positions[k];
+      scoreSum += p->score;
+      blackToMove += p->flags & 1;
+      if(p->result >= -1 && p->result <= 1){
+        ++results[p->result + 1];
+      }
+    }
+    positions += shard->count;
+    unmapPosShard(shard);
+  }
+  double seconds = omp_get_wtime() - start;
+
+  printf("positions:     %ld (%ld bytes each)\n", positions,
+         (long)sizeof(TpackedPos));
+  printf("white/draw/black: %ld / %ld / %ld\n",
+         results[2], results[1], results[0]);
+  printf("black to move: %ld\n", blackToMove);
+  printf("mean score:    %.3f\n", (positions > 0) ? scoreSum/positions : 0);
+  printf("scan:          %.3f s (%.1f M positions/s)\n", seconds,
+         (seconds > 0) ? positions / seconds / 1e6 : 0);
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * searches every position of EPD file and prints solve rate and speed
+ * 
+ * @param netName net (see loadNamedNet) or "primitive" (if NULL, primitive)
+ * @param maxDepth depth limit (0 for none)
+ */
+static int epdTool(const char* epdFileName, float seconds,
+                   const char* netName, int maxDepth)
+{
+  TchNet* net = NULL;
+  if(netName != NULL && strcmp(netName, "primitive") != 0){
+    net = loadNamedNet(netName);
+    if(net == NULL){
+      fprintf(stderr, "%s is not valid net\n", netName);
+      return EXIT_FAILURE;
+    }
+  }
+
+  int count;
+  TepdEntry* entries = loadEpdFile(epdFileName, &count);
+  if(entries == NULL){
+    fprintf(stderr, "can not open %s\n", epdFileName);
+    if(net != NULL){
+      freeChNet(net);
+    }
+    return EXIT_FAILURE;
+  }
+
+  printf("epd: %d positions, %.2f s per position, depth limit %d\n",
+         count, seconds, maxDepth);
+  double wallSeconds = 0;
+  TepdResult* results = runEpdSuite(entries, count, net, seconds, maxDepth,
+                                    &wallSeconds);
+  if(results != NULL){
+    printEpdReport(entries, results, count, wallSeconds);
+  }
+
+  free(results);
+  freeEpdEntries(entries, count);
+  if(net != NULL){
+    freeChNet(net);
+  }
+  return (results != NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/**
+ * searches bench positions to depth, prints nodes and nodes/sec
+ */
+static int benchTool(int depth, const char* netName, int threads)
+{
+  TchNet* net = NULL;
+  if(netName != NULL && strcmp(netName, "primitive") != 0){
+    net = loadNamedNet(netName);
+    if(net == NULL){
+      fprintf(stderr, "%s is not valid net\n", netName);
+      return EXIT_FAILURE;
+    }
+  }
+
+  runBench(net, depth, threads);
+
+  if(net != NULL){
+    freeChNet(net);
+  }
+  return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char** argv){
   srand(time(NULL));
 
-  chNetEvolution();
+  if(!startLoggerFromEnv()){
+    fprintf(stderr, "can not start logger\n");
+  }
+  atexit(stopLogger);
+
+  if(argc > 1 && strcmp(argv[1], "selftest") == 0){
+    bool denseOk = denseSelfTest();
+    bool fcnnOk = fcnnSelfTest();
+    bool netFileOk = netFileSelfTest();
+    bool swissOk = swissSelfTest();
+    return (denseOk && fcnnOk && netFileOk && swissOk) ? EXIT_SUCCESS
+                                                       : EXIT_FAILURE;
+  }
+  if(argc > 1 && strcmp(argv[1], "actbench") == 0){
+    activationBenchmark();
+    return EXIT_SUCCESS;
+  }
+
+  if(argc > 2 && strcmp(argv[1], "quant") == 0){
+    return quantTool(argv[2], (argc > 3) ? argv[3] : NULL);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "popbench") == 0){
+    return popBatchTool((argc > 2) ? atoi(argv[2]) : 100,
+                        (argc > 3) ? argv[3] : NULL);
+  }
+
+  if(argc > 3 && strcmp(argv[1], "sprt") == 0){
+    return sprtTool(argv[2], argv[3], argc - 4, argv + 4);
+  }
+
+  if(argc > 2 && strcmp(argv[1], "export") == 0){
+    return exportTool(argv[2], (argc > 3) ? argv[3] : NULL);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "pgn") == 0){
+    return pgnTool((argc > 2) ? argv[2] : GAME_LOG_FILE,
+                   (argc > 3) ? argv[3] : NULL);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "dataset") == 0){
+    return datasetTool((argc > 2) ? argv[2] : GAME_LOG_FILE,
+                       (argc > 3) ? argv[3] : POS_DATASET_PREFIX);
+  }
+
+  if(argc > 2 && strcmp(argv[1], "datastat") == 0){
+    return datastatTool(argc - 2, argv + 2);
+  }
+
+  if(argc > 2 && strcmp(argv[1], "epd") == 0){
+    return epdTool(argv[2], (argc > 3) ? atof(argv[3]) : 1.0,
+                   (argc > 4) ? argv[4] : NULL,
+                   (argc > 5) ? atoi(argv[5]) : 0);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "uci") == 0){
+    if(!uciLoop((argc > 2) ? argv[2] : NULL)){
+      fprintf(stderr, "%s is not valid net\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if(argc > 1 && strcmp(argv[1], "bench") == 0){
+    int depth = (argc > 2) ? atoi(argv[2]) : 0;
+    return benchTool((depth > 0) ? depth : BENCH_DEFAULT_DEPTH,
+                     (argc > 3) ? argv[3] : NULL,
+                     (argc > 4) ? atoi(argv[4]) : 1);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "resume") == 0){
+    chNetEvolution((argc > 2) ? argv[2] : CHECKPOINT_FILE);
+    return EXIT_SUCCESS;
+  }
+
+  chNetEvolution(NULL);
 }
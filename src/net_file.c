@@ -0,0 +1,283 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "net_file.h"
+#include "chess_net.h"
+#include "dense.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+uint64_t netFileChecksum(const void* data, size_t size)
+{
+  const unsigned char* bytes = data;
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for(size_t i = 0; i < size; ++i){
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+
+/**
+ * returns offset of genome for net with layerCount layers
+ */
+static uint32_t genomeOffset(int layerCount)
+{
+  size_t size = sizeof(TnetFileHeader) + layerCount * sizeof(int32_t);
+  return (size + DENSE_ALIGN - 1) / DENSE_ALIGN * DENSE_ALIGN;
+}
+
+/**
+ * checks header and neuron counts (copied to counts)
+ *
+ * @return true if net described by header can be created
+ */
+static bool checkHeader(const TnetFileHeader* h, const int32_t* fileCounts,
+                        int* counts)
+{
+  if(h->layerCount < 2 || h->layerCount > NET_FILE_MAX_LAYERS){
+    return false;
+  }
+  for(uint32_t i = 0; i < h->layerCount; ++i){
+    if(fileCounts[i] < 1){
+      return false;
+    }
+    counts[i] = fileCounts[i];
+  }
+
+  return h->activation < ACT_COUNT &&
+         h->inputMode < CHNET_INPUT_COUNT &&
+         counts[0] == PREPR_NEURONS_COUNT &&
+         h->genomeOffset == genomeOffset(h->layerCount) &&
+         (int)h->genomeSize == chNetGenomeSize(h->layerCount, counts);
+}
+
+/**
+ * returns true if header starts binary net of supported version
+ */
+static bool checkMagic(const TnetFileHeader* h)
+{
+  return memcmp(h->magic, NET_FILE_MAGIC, NET_FILE_MAGIC_LEN) == 0 &&
+         h->version == NET_FILE_VERSION &&
+         h->dtype == NET_FILE_DTYPE_F32;
+}
+
+
+size_t chNetBinarySize(const TchNet* net)
+{
+  const Tfcnn* fcnn = net->fcnn;
+  return genomeOffset(fcnn->layerCount) +
+         chNetGenomeSize(fcnn->layerCount, fcnn->neuronsInLayersCount) *
+           sizeof(float);
+}
+
+bool fwriteChNetBinary(FILE* out, const TchNet* net)
+{
+  const Tfcnn* fcnn = net->fcnn;
+  int genomeSize = chNetGenomeSize(fcnn->layerCount,
+                                   fcnn->neuronsInLayersCount);
+
+  TnetFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, NET_FILE_MAGIC, NET_FILE_MAGIC_LEN);
+  h.version = NET_FILE_VERSION;
+  h.dtype = NET_FILE_DTYPE_F32;
+  h.activation = fcnn->activation;
+  h.inputMode = net->inputMode;
+  h.layerCount = fcnn->layerCount;
+  h.genomeSize = genomeSize;
+  h.genomeOffset = genomeOffset(fcnn->layerCount);
+  h.checksum = netFileChecksum(net->genome, genomeSize * sizeof(float));
+
+  int32_t counts[NET_FILE_MAX_LAYERS];
+  if(fcnn->layerCount > NET_FILE_MAX_LAYERS){
+    return false;
+  }
+  for(int i = 0; i < fcnn->layerCount; ++i){
+    counts[i] = fcnn->neuronsInLayersCount[i];
+  }
+
+  char padding[DENSE_ALIGN] = {0};
+  size_t paddingSize = h.genomeOffset - sizeof(h) -
+                       fcnn->layerCount * sizeof(int32_t);
+
+  return fwrite(&h, sizeof(h), 1, out) == 1 &&
+         fwrite(counts, sizeof(int32_t), fcnn->layerCount, out) ==
+           (size_t)fcnn->layerCount &&
+         fwrite(padding, 1, paddingSize, out) == paddingSize &&
+         fwrite(net->genome, sizeof(float), genomeSize, out) ==
+           (size_t)genomeSize;
+}
+
+TchNet* freadChNetBinary(FILE* in)
+{
+  TnetFileHeader h;
+  int32_t fileCounts[NET_FILE_MAX_LAYERS];
+  int counts[NET_FILE_MAX_LAYERS];
+
+  if(fread(&h, sizeof(h), 1, in) != 1 || !checkMagic(&h) ||
+     h.layerCount > NET_FILE_MAX_LAYERS ||
+     fread(fileCounts, sizeof(int32_t), h.layerCount, in) != h.layerCount ||
+     !checkHeader(&h, fileCounts, counts)){
+    return NULL;
+  }
+
+  char padding[DENSE_ALIGN];
+  size_t paddingSize = h.genomeOffset - sizeof(h) -
+                       h.layerCount * sizeof(int32_t);
+  if(fread(padding, 1, paddingSize, in) != paddingSize){
+    return NULL;
+  }
+
+  TchNet* net = initChNetView(h.layerCount, counts, h.activation, NULL);
+  if(net == NULL){
+    return NULL;
+  }
+  if(fread(net->genome, sizeof(float), h.genomeSize, in) != h.genomeSize ||
+     netFileChecksum(net->genome, h.genomeSize * sizeof(float)) !=
+       h.checksum){
+    freeChNet(net);
+    return NULL;
+  }
+  // preprOutputs are part of genome, so nothing has to be recomputed
+  net->inputMode = h.inputMode;
+
+  return net;
+}
+
+bool saveChNetBinary(const char* fileName, const TchNet* net)
+{
+  FILE* out = fopen(fileName, "wb");
+  if(out == NULL){
+    return false;
+  }
+  bool ok = fwriteChNetBinary(out, net);
+  return (fclose(out) == 0) && ok;
+}
+
+
+TchNet* mapChNet(const char* fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  if(fd < 0){
+    return NULL;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TnetFileHeader)){
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = st.st_size;
+  // private writable mapping, net may write its genome (copy on write)
+  void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    return NULL;
+  }
+
+  const TnetFileHeader* h = map;
+  const int32_t* fileCounts = (const int32_t*)(h + 1);
+  int counts[NET_FILE_MAX_LAYERS];
+  float* genome = (float*)((char*)map + h->genomeOffset);
+
+  if(!checkMagic(h) || h->layerCount > NET_FILE_MAX_LAYERS ||
+     sizeof(*h) + h->layerCount * sizeof(int32_t) > size ||
+     !checkHeader(h, fileCounts, counts) ||
+     h->genomeOffset + (size_t)h->genomeSize * sizeof(float) > size ||
+     netFileChecksum(genome, h->genomeSize * sizeof(float)) != h->checksum){
+    munmap(map, size);
+    return NULL;
+  }
+
+  TchNet* net = initChNetView(h->layerCount, counts, h->activation, genome);
+  if(net == NULL){
+    munmap(map, size);
+    return NULL;
+  }
+  net->inputMode = h->inputMode;
+  net->fileMap = map;
+  net->fileMapSize = size;
+
+  return net;
+}
+
+
+TchNet* loadChNetFile(const char* fileName)
+{
+  FILE* file = fopen(fileName, "rb");
+  if(file == NULL){
+    return NULL;
+  }
+
+  char magic[NET_FILE_MAGIC_LEN];
+  bool isBinary = fread(magic, 1, NET_FILE_MAGIC_LEN, file) ==
+                    NET_FILE_MAGIC_LEN &&
+                  memcmp(magic, NET_FILE_MAGIC, NET_FILE_MAGIC_LEN) == 0;
+  if(isBinary){
+    fclose(file);
+    return mapChNet(fileName);
+  }
+
+  rewind(file);
+  TchNet* net = fgetChNet(file);
+  fclose(file);
+  return net;
+}
+
+
+bool netFileSelfTest(void)
+{
+  const int counts[] = {PREPR_NEURONS_COUNT, 10, 1};
+  const int positionCount = 1000;
+
+  char fileName[] = "/tmp/nnetXXXXXX";
+  int fd = mkstemp(fileName);
+  if(fd < 0){
+    printf("net file: can not create temporary file FAILED\n");
+    return false;
+  }
+  close(fd);
+
+  TchNet* net = initRandChNet(3, counts, ACT_SIGMOID);
+  TchNet* mapped = saveChNetBinary(fileName, net) ?
+                   loadChNetFile(fileName) : NULL;
+  remove(fileName);
+  if(mapped == NULL || mapped->fileMap == NULL){
+    printf("net file: saved net can not be mapped FAILED\n");
+    if(mapped != NULL){
+      freeChNet(mapped);
+    }
+    freeChNet(net);
+    return false;
+  }
+
+  double maxErr = 0;
+  uint8_t pieceIndices[64];
+  for(int p = 0; p < positionCount; ++p){
+    for(int s = 0; s < 64; ++s){
+      pieceIndices[s] = rand() % CHNET_PIECE_INDEX_COUNT;
+    }
+    maxErr = fmax(maxErr, fabs(chNetPredictIndices(mapped, pieceIndices) -
+                               chNetPredictIndices(net, pieceIndices)));
+  }
+
+  bool ok = (maxErr == 0);
+  printf("net file: mapped net max error: %e %s\n", maxErr,
+         ok ? "OK" : "FAILED");
+
+  freeChNet(mapped);
+  freeChNet(net);
+  return ok;
+}
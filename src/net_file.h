@@ -0,0 +1,116 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_NET_FILE_H
+#define __MODULE_NET_FILE_H
+
+#include "chess_net.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define NET_FILE_MAGIC "NNCHNET\0"
+#define NET_FILE_MAGIC_LEN 8
+#define NET_FILE_VERSION 1
+
+// type of values in genome block
+#define NET_FILE_DTYPE_F32 0
+
+// max number of fcnn layers in file
+#define NET_FILE_MAX_LAYERS 16
+
+
+/**
+ * header of binary net file (native byte order, little endian on x86)
+ *
+ * header is followed by layerCount int32 neuron counts of fcnn and
+ * (at genomeOffset, aligned to DENSE_ALIGN) by raw genome of net
+ * (chNetGenomeSize floats, same layout as in memory), so mapped file can be
+ * used for inference in place
+ */
+typedef struct {
+
+  char magic[NET_FILE_MAGIC_LEN];
+  uint32_t version;
+  uint32_t dtype;
+
+  uint32_t activation;
+  uint32_t inputMode;
+  uint32_t layerCount;
+
+  // number of values in genome and byte offset of genome in file
+  uint32_t genomeSize;
+  uint32_t genomeOffset;
+  uint32_t reserved;
+
+  // netFileChecksum of genome
+  uint64_t checksum;
+
+} TnetFileHeader;
+
+
+/**
+ * returns 64 bit FNV-1a hash of bytes
+ */
+uint64_t netFileChecksum(const void* data, size_t size);
+
+/**
+ * returns number of bytes written by fwriteChNetBinary (multiple of
+ * DENSE_ALIGN)
+ */
+size_t chNetBinarySize(const TchNet* net);
+
+/**
+ * writes net in binary format
+ *
+ * @return false if writing failed
+ */
+bool fwriteChNetBinary(FILE* out, const TchNet* net);
+
+/**
+ * reads binary net (genome is copied to memory owned by net)
+ *
+ * @return net or NULL if file is not valid binary net (or checksum differs)
+ */
+TchNet* freadChNetBinary(FILE* in);
+
+/**
+ * writes net to file in binary format
+ */
+bool saveChNetBinary(const char* fileName, const TchNet* net);
+
+/**
+ * maps file with binary net to memory, net uses mapped genome in place
+ * (file is unmapped by freeChNet)
+ *
+ * mapping is private, so changes of net never reach the file, but file
+ * must not be rewritten while net is used (population archive is rewritten
+ * by evolution, so its records are read by freadChNetBinary)
+ *
+ * @return NULL if file is not valid binary net
+ */
+TchNet* mapChNet(const char* fileName);
+
+/**
+ * loads net from file in binary (mapped by mapChNet) or text (fprintChNet)
+ * format
+ *
+ * @return net or NULL if error
+ */
+TchNet* loadChNetFile(const char* fileName);
+
+/**
+ * saves random net in binary format, maps it and compares its predictions
+ * with predictions of original net, prints result to stdout
+ *
+ * @return true if mapped net predicts exactly same values
+ */
+bool netFileSelfTest(void);
+
+#endif
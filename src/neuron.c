@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
 
@@ -111,11 +112,117 @@ float sigmoid(float x)
 }
 
 
+// tanh approximation stops being < 1 here
+#define TANH_RATIONAL_LIMIT 4.97f
+
+float sigmoidRational(float x)
+{
+  float y = x * 0.5f;
+  if(y > TANH_RATIONAL_LIMIT) y = TANH_RATIONAL_LIMIT;
+  if(y < -TANH_RATIONAL_LIMIT) y = -TANH_RATIONAL_LIMIT;
+
+  // Lambert`s continued fraction of tanh cut after 7th term
+  float y2 = y * y;
+  float tanhY = y * (135135 + y2*(17325 + y2*(378 + y2))) /
+                (135135 + y2*(62370 + y2*(3150 + y2*28)));
+
+  return 0.5f + 0.5f * tanhY;
+}
+
+
+static float sigmoidLutTable[SIGMOID_LUT_SIZE + 1];
+
+/**
+ * fills sigmoidLutTable before main() starts
+ */
+__attribute__((constructor))
+static void initSigmoidLutTable(void)
+{
+  for(int i = 0; i <= SIGMOID_LUT_SIZE; ++i){
+    sigmoidLutTable[i] = sigmoid(SIGMOID_LUT_MIN + i / SIGMOID_LUT_SCALE);
+  }
+}
+
+const float* getSigmoidLutTable(void)
+{
+  return sigmoidLutTable;
+}
+
+float sigmoidLut(float x)
+{
+  float t = (x - SIGMOID_LUT_MIN) * SIGMOID_LUT_SCALE;
+  if(t < 0) t = 0;
+  if(t > SIGMOID_LUT_SIZE) t = SIGMOID_LUT_SIZE;
+
+  int i = (int)t;
+  if(i > SIGMOID_LUT_SIZE - 1) i = SIGMOID_LUT_SIZE - 1;
+  float f = t - i;
+
+  return sigmoidLutTable[i] + f * (sigmoidLutTable[i+1] - sigmoidLutTable[i]);
+}
+
+
+float hardSigmoid(float x)
+{
+  return clippedRelu(x * 0.25f + 0.5f);
+}
+
+
+float clippedRelu(float x)
+{
+  // not fminf/fmaxf, those are not inlined because of NaN rules
+  return (x < 0) ? 0 : ((x > 1) ? 1 : x);
+}
+
+
+float activate(Tactivation a, float x)
+{
+  switch(a){
+    case ACT_SIGMOID_RATIONAL: return sigmoidRational(x);
+    case ACT_SIGMOID_LUT:      return sigmoidLut(x);
+    case ACT_HARD_SIGMOID:     return hardSigmoid(x);
+    case ACT_CLIPPED_RELU:     return clippedRelu(x);
+    case ACT_SIGMOID:
+    default:                   return sigmoid(x);
+  }
+}
+
+
+static const char* activationNames[ACT_COUNT] = {
+  "sigmoid", "sigmoid_rational", "sigmoid_lut", "hard_sigmoid", "clipped_relu"
+};
+
+const char* activationName(Tactivation a)
+{
+  if(a < ACT_SIGMOID || a >= ACT_COUNT){
+    return "unknown";
+  }
+  return activationNames[a];
+}
+
+Tactivation activationFromName(const char* name)
+{
+  for(int i = 0; i < ACT_COUNT; ++i){
+    if(strcmp(name, activationNames[i]) == 0){
+      return i;
+    }
+  }
+  return ACT_COUNT;
+}
+
+
 float calcNeuronOutput(const Tneuron* n, const float* inputs)
+{
+  return calcNeuronOutputAct(n, inputs, ACT_SIGMOID);
+}
+
+
+float calcNeuronOutputAct(const Tneuron* n, const float* inputs,
+                          Tactivation a)
 {
   float sum = 0;
   for(int i = 0; i < n->inputCount; i++){
     sum += inputs[i] * n->weights[i];
   }
-  return sigmoid(sum + n->bias);
+  return activate(a, sum + n->bias);
 }
@@ -9,6 +9,41 @@
 
 #include <stdio.h>
 
+
+// sigmoidLut() table covers [SIGMOID_LUT_MIN, -SIGMOID_LUT_MIN]
+#define SIGMOID_LUT_MIN -16.0f
+
+// number of table entries per unit of x
+#define SIGMOID_LUT_SCALE 64.0f
+
+// number of intervals in table (table has SIGMOID_LUT_SIZE+1 entries)
+#define SIGMOID_LUT_SIZE 2048
+
+
+/**
+ * activation function of neurons
+ * 
+ * max errors are measured against sigmoid() over [-30, 30]
+ */
+typedef enum {
+  // exact logistic function (double precision exp)
+  ACT_SIGMOID = 0,
+
+  // 0.5 + 0.5*tanh(x/2) with [7/6] rational tanh, max error 5e-5
+  ACT_SIGMOID_RATIONAL,
+
+  // table with linear interpolation, max error 4e-6
+  ACT_SIGMOID_LUT,
+
+  // clamp(x/4 + 1/2, 0, 1), differs from sigmoid by up to 0.12 (at |x| == 2)
+  ACT_HARD_SIGMOID,
+
+  // clamp(x, 0, 1), differs from sigmoid by up to 0.5 (at x == 0)
+  ACT_CLIPPED_RELU,
+
+  ACT_COUNT
+} Tactivation;
+
 /**
  * neuron to be used in neural network
  * 
@@ -87,9 +122,57 @@ Tneuron* cpyNeuron(const Tneuron* origin);
  */
 float sigmoid(float x);
 
+/**
+ * sigmoid approximated by rational function (see ACT_SIGMOID_RATIONAL)
+ */
+float sigmoidRational(float x);
+
+/**
+ * sigmoid interpolated from table (see ACT_SIGMOID_LUT)
+ */
+float sigmoidLut(float x);
+
+/**
+ * returns table used by sigmoidLut()
+ * 
+ * table[i] == sigmoid(SIGMOID_LUT_MIN + i/SIGMOID_LUT_SCALE)
+ */
+const float* getSigmoidLutTable(void);
+
+/**
+ * y = min(max(x/4 + 1/2, 0), 1)
+ */
+float hardSigmoid(float x);
+
+/**
+ * y = min(max(x, 0), 1)
+ */
+float clippedRelu(float x);
+
+/**
+ * returns activation function a applied on x
+ */
+float activate(Tactivation a, float x);
+
+/**
+ * returns name of activation (ex. "sigmoid_lut")
+ */
+const char* activationName(Tactivation a);
+
+/**
+ * returns activation with name or ACT_COUNT if there is no such activation
+ */
+Tactivation activationFromName(const char* name);
+
 /**
  * takes array of inputs and returns output of neuron
  */
 float calcNeuronOutput(const Tneuron* n, const float* inputs);
 
+/**
+ * takes array of inputs and returns output of neuron with activation a
+ */
+float calcNeuronOutputAct(const Tneuron* n, const float* inputs,
+                          Tactivation a);
+
 #endif
@@ -0,0 +1,185 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "persist.h"
+#include "checkpoint.h"
+#include "eval_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+/**
+ * saves snapshot to archive and checkpoint
+ */
+static bool persisterWrite(Tpersister* p)
+{
+  int netCount = p->snapshot->netCount;
+  bool ok = true;
+
+  if(p->archive != NULL){
+    ok = popArchiveSave(p->archive, p->population, netCount,
+                        p->generation - 1, p->fitness);
+  }
+  ok = saveCheckpoint(p->checkpointFileName, p->generation, p->seed,
+                      p->snapshot, p->population, p->fitness) && ok;
+
+  return ok;
+}
+
+/**
+ * writer thread, saves every submitted snapshot
+ */
+static void* persisterThread(void* data)
+{
+  Tpersister* p = data;
+
+  pthread_mutex_lock(&p->lock);
+  while(true){
+    while(!p->pending && !p->quit){
+      pthread_cond_wait(&p->changed, &p->lock);
+    }
+    if(!p->pending){
+      break;
+    }
+    p->pending = false;
+    p->busy = true;
+    pthread_mutex_unlock(&p->lock);
+
+    double start = omp_get_wtime();
+    bool ok = persisterWrite(p);
+    double seconds = omp_get_wtime() - start;
+    if(!ok){
+      fprintf(stderr, "can not save generation %d\n", p->generation);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->busy = false;
+    p->writeSeconds += seconds;
+    ++p->saves;
+    if(!ok){
+      ++p->failures;
+    }
+    pthread_cond_broadcast(&p->changed);
+  }
+  pthread_mutex_unlock(&p->lock);
+
+  return NULL;
+}
+
+
+Tpersister* startPersister(const TgenomeArena* arena,
+                           const char* archiveFileName,
+                           const char* checkpointFileName)
+{
+  Tpersister* p = calloc(1, sizeof(Tpersister));
+  if(p == NULL){
+    return NULL;
+  }
+  p->snapshot = cloneGenomeArena(arena);
+  p->population = malloc(arena->netCount * sizeof(TchNet*));
+  p->fitness = calloc(arena->netCount, sizeof(float));
+  if(p->snapshot == NULL || p->population == NULL || p->fitness == NULL){
+    if(p->snapshot != NULL){
+      freeGenomeArena(p->snapshot);
+    }
+    free(p->population);
+    free(p->fitness);
+    free(p);
+    return NULL;
+  }
+
+  // snapshot nets are never evaluated
+  for(int id = 0; id < arena->netCount; ++id){
+    TchNet* net = p->snapshot->nets[id];
+    if(net->evalCache != NULL){
+      freeEvalCache(net->evalCache);
+      net->evalCache = NULL;
+    }
+  }
+
+  p->archive = createPopArchive(archiveFileName, arena->netCount,
+                                arena->nets[0]);
+  if(p->archive == NULL){
+    fprintf(stderr, "can not create %s\n", archiveFileName);
+  }
+  p->checkpointFileName = checkpointFileName;
+
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->changed, NULL);
+  if(pthread_create(&p->thread, NULL, persisterThread, p) != 0){
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->changed);
+    if(p->archive != NULL){
+      closePopArchive(p->archive);
+    }
+    freeGenomeArena(p->snapshot);
+    free(p->population);
+    free(p->fitness);
+    free(p);
+    return NULL;
+  }
+
+  return p;
+}
+
+
+void persisterSubmit(Tpersister* persister, const TgenomeArena* arena,
+                     TchNet** population, const float* fitness,
+                     int generation, uint64_t seed)
+{
+  Tpersister* p = persister;
+  double start = omp_get_wtime();
+
+  pthread_mutex_lock(&p->lock);
+  // backpressure, snapshot can`t be overwritten while it is saved
+  while(p->pending || p->busy){
+    pthread_cond_wait(&p->changed, &p->lock);
+  }
+  p->waitSeconds += omp_get_wtime() - start;
+
+  copyGenomeArena(p->snapshot, arena);
+  for(int i = 0; i < arena->netCount; ++i){
+    // same slot in snapshot as in arena
+    size_t id = (population[i]->genome - arena->block) / arena->genomeSize;
+    p->population[i] = p->snapshot->nets[id];
+    p->fitness[i] = (fitness != NULL) ? fitness[i] : 0;
+  }
+  p->generation = generation;
+  p->seed = seed;
+
+  p->pending = true;
+  pthread_cond_broadcast(&p->changed);
+  pthread_mutex_unlock(&p->lock);
+}
+
+
+void stopPersister(Tpersister* persister)
+{
+  Tpersister* p = persister;
+
+  pthread_mutex_lock(&p->lock);
+  p->quit = true;
+  pthread_cond_broadcast(&p->changed);
+  pthread_mutex_unlock(&p->lock);
+  pthread_join(p->thread, NULL);
+
+  printf("persister: %d saves (%d failed), writing %.3f s, "
+         "main loop waited %.3f s\n",
+         p->saves, p->failures, p->writeSeconds, p->waitSeconds);
+
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->changed);
+  if(p->archive != NULL){
+    closePopArchive(p->archive);
+  }
+  freeGenomeArena(p->snapshot);
+  free(p->population);
+  free(p->fitness);
+  free(p);
+}
@@ -0,0 +1,86 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_PERSIST_H
+#define __MODULE_PERSIST_H
+
+#include "genome_arena.h"
+#include "pop_archive.h"
+#include "chess_net.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/**
+ * background writer of population archive and checkpoint
+ *
+ * main loop only copies arena to snapshot (one memcpy of whole block)
+ * and continues, writer thread saves snapshot. There is one snapshot, so
+ * next submit waits until previous one is written (bounded backpressure).
+ */
+typedef struct {
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+
+  // snapshot waits for writer / writer is saving it / writer should end
+  bool pending;
+  bool busy;
+  bool quit;
+
+  // copy of arena and population order, fitness and state of evolution
+  TgenomeArena* snapshot;
+  TchNet** population;
+  float* fitness;
+  int generation;
+  uint64_t seed;
+
+  // destinations (archive can be NULL if it couldn`t be created)
+  TpopArchive* archive;
+  const char* checkpointFileName;
+
+  // statistics
+  int saves;
+  int failures;
+  double waitSeconds;
+  double writeSeconds;
+
+} Tpersister;
+
+
+/**
+ * starts writer thread for population of arena
+ *
+ * @return NULL if error
+ */
+Tpersister* startPersister(const TgenomeArena* arena,
+                           const char* archiveFileName,
+                           const char* checkpointFileName);
+
+/**
+ * snapshots state of evolution and lets writer save it
+ *
+ * waits only if previous snapshot is still being written
+ *
+ * @param population permutation of arena->nets (ordered by fitness)
+ * @param fitness fitness of population, children written over worse half
+ *        have 0 (they didn`t play yet)
+ * @param generation next generation (same as saveCheckpoint)
+ */
+void persisterSubmit(Tpersister* persister, const TgenomeArena* arena,
+                     TchNet** population, const float* fitness,
+                     int generation, uint64_t seed);
+
+/**
+ * writes last snapshot, stops writer thread, prints statistics and frees
+ * persister
+ */
+void stopPersister(Tpersister* persister);
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "pop_archive.h"
+#include "net_file.h"
+#include "dense.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+TpopArchive* createPopArchive(const char* fileName, int slotCount,
+                              const TchNet* net)
+{
+  if(slotCount < 1){
+    return NULL;
+  }
+
+  TpopArchive* archive = calloc(1, sizeof(TpopArchive));
+  if(archive == NULL){
+    return NULL;
+  }
+  archive->file = fopen(fileName, "w+b");
+  archive->index = malloc(slotCount * sizeof(TpopArchiveEntry));
+  archive->slotNets = calloc(slotCount, sizeof(TchNet*));
+  archive->slotChecksums = calloc(slotCount, sizeof(uint64_t));
+  archive->slotGenerations = calloc(slotCount, sizeof(uint32_t));
+  if(archive->file == NULL || archive->index == NULL ||
+     archive->slotNets == NULL || archive->slotChecksums == NULL ||
+     archive->slotGenerations == NULL){
+    closePopArchive(archive);
+    return NULL;
+  }
+
+  TpopArchiveHeader* h = &archive->header;
+  memcpy(h->magic, POP_ARCHIVE_MAGIC, POP_ARCHIVE_MAGIC_LEN);
+  h->slotCount = slotCount;
+  h->recordSize = chNetBinarySize(net);
+  h->generation = 0;
+  h->reserved = 0;
+  size_t indexEnd = sizeof(TpopArchiveHeader) +
+                    slotCount * sizeof(TpopArchiveEntry);
+  h->dataOffset = (indexEnd + DENSE_ALIGN - 1) / DENSE_ALIGN * DENSE_ALIGN;
+
+  for(int i = 0; i < slotCount; ++i){
+    archive->index[i] = (TpopArchiveEntry){-1, 0, 0, 0, 0};
+  }
+
+  return archive;
+}
+
+void closePopArchive(TpopArchive* archive)
+{
+  if(archive->file != NULL){
+    fclose(archive->file);
+  }
+  free(archive->index);
+  free(archive->slotNets);
+  free(archive->slotChecksums);
+  free(archive->slotGenerations);
+  free(archive);
+}
+
+
+/**
+ * returns slot of net (new one if net was not saved yet), -1 if full
+ */
+static int popArchiveSlot(TpopArchive* archive, const TchNet* net)
+{
+  int freeSlot = -1;
+  for(uint32_t slot = 0; slot < archive->header.slotCount; ++slot){
+    if(archive->slotNets[slot] == net){
+      return slot;
+    }
+    if(freeSlot == -1 && archive->slotNets[slot] == NULL){
+      freeSlot = slot;
+    }
+  }
+  if(freeSlot != -1){
+    archive->slotNets[freeSlot] = net;
+  }
+  return freeSlot;
+}
+
+bool popArchiveSave(TpopArchive* archive, TchNet** population,
+                    int populationCount, int generation,
+                    const float* fitness)
+{
+  TpopArchiveHeader* h = &archive->header;
+  if(populationCount != (int)h->slotCount){
+    return false;
+  }
+
+  // checksums of genomes in slot order
+  uint64_t* checksums = calloc(populationCount, sizeof(uint64_t));
+  if(checksums == NULL){
+    return false;
+  }
+
+  for(int rank = 0; rank < populationCount; ++rank){
+    const TchNet* net = population[rank];
+    int slot = popArchiveSlot(archive, net);
+    if(slot < 0 || chNetBinarySize(net) != h->recordSize){
+      free(checksums);
+      return false;
+    }
+    checksums[slot] = netFileChecksum(net->genome,
+                                      chNetGenomeSize(net->fcnn->layerCount,
+                                        net->fcnn->neuronsInLayersCount) *
+                                      sizeof(float));
+
+    archive->index[rank].slot = slot;
+    archive->index[rank].fitness = (fitness != NULL) ? fitness[rank] : 0;
+  }
+
+  // changed records in slot order, so writes go through file sequentially
+  bool ok = true;
+  archive->lastWritten = 0;
+  for(int slot = 0; ok && slot < populationCount; ++slot){
+    if(archive->slotChecksums[slot] == checksums[slot]){
+      continue;
+    }
+    ok = fseek(archive->file, h->dataOffset + (long)slot * h->recordSize,
+               SEEK_SET) == 0 &&
+         fwriteChNetBinary(archive->file, archive->slotNets[slot]);
+    if(ok){
+      archive->slotChecksums[slot] = checksums[slot];
+      archive->slotGenerations[slot] = generation;
+      ++archive->lastWritten;
+    }
+  }
+
+  for(int rank = 0; rank < populationCount; ++rank){
+    int slot = archive->index[rank].slot;
+    archive->index[rank].checksum = archive->slotChecksums[slot];
+    archive->index[rank].generation = archive->slotGenerations[slot];
+  }
+  h->generation = generation;
+
+  ok = ok &&
+       fseek(archive->file, 0, SEEK_SET) == 0 &&
+       fwrite(h, sizeof(TpopArchiveHeader), 1, archive->file) == 1 &&
+       fwrite(archive->index, sizeof(TpopArchiveEntry), populationCount,
+              archive->file) == (size_t)populationCount &&
+       fflush(archive->file) == 0;
+
+  free(checksums);
+  return ok;
+}
+
+
+TchNet* loadPopArchiveNet(const char* fileName, int rank)
+{
+  FILE* in = fopen(fileName, "rb");
+  if(in == NULL){
+    return NULL;
+  }
+
+  TpopArchiveHeader h;
+  TpopArchiveEntry entry;
+  TchNet* net = NULL;
+  if(fread(&h, sizeof(h), 1, in) == 1 &&
+     memcmp(h.magic, POP_ARCHIVE_MAGIC, POP_ARCHIVE_MAGIC_LEN) == 0 &&
+     rank >= 0 && rank < (int)h.slotCount &&
+     fseek(in, sizeof(h) + rank * sizeof(entry), SEEK_SET) == 0 &&
+     fread(&entry, sizeof(entry), 1, in) == 1 &&
+     entry.slot >= 0 && entry.slot < (int)h.slotCount &&
+     fseek(in, h.dataOffset + (long)entry.slot * h.recordSize,
+           SEEK_SET) == 0){
+    net = freadChNetBinary(in);
+  }
+  fclose(in);
+
+  // record must be the one index points to
+  if(net != NULL &&
+     netFileChecksum(net->genome,
+                     chNetGenomeSize(net->fcnn->layerCount,
+                                     net->fcnn->neuronsInLayersCount) *
+                     sizeof(float)) != entry.checksum){
+    freeChNet(net);
+    net = NULL;
+  }
+
+  return net;
+}
+
+TchNet* loadNamedNet(const char* name)
+{
+  const char* at = strrchr(name, '@');
+  if(at == NULL){
+    return loadChNetFile(name);
+  }
+
+  char fileName[1024];
+  size_t len = at - name;
+  if(len >= sizeof(fileName)){
+    return NULL;
+  }
+  memcpy(fileName, name, len);
+  fileName[len] = '\0';
+
+  return loadPopArchiveNet(fileName, atoi(at + 1) - 1);
+}
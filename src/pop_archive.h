@@ -0,0 +1,136 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_POP_ARCHIVE_H
+#define __MODULE_POP_ARCHIVE_H
+
+#include "chess_net.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// default archive of evolution
+#define POP_ARCHIVE_FILE "population/population.arc"
+
+#define POP_ARCHIVE_MAGIC "NNPOPAR1"
+#define POP_ARCHIVE_MAGIC_LEN 8
+
+
+/**
+ * header at the beginning of archive file
+ *
+ * header is followed by index (slotCount entries, one per rank) and
+ * at dataOffset by slotCount records of recordSize bytes, record of slot
+ * is binary net file (net_file.h), so genome of every net is aligned
+ */
+typedef struct {
+
+  char magic[POP_ARCHIVE_MAGIC_LEN];
+  uint32_t slotCount;
+  uint32_t recordSize;
+
+  // generation of last save
+  uint32_t generation;
+  uint32_t reserved;
+
+  uint64_t dataOffset;
+
+} TpopArchiveHeader;
+
+/**
+ * index entry of net on one rank of population
+ */
+typedef struct {
+
+  // record of net
+  int32_t slot;
+
+  // fitness of net at last save (0 for child that didn`t play yet)
+  float fitness;
+
+  // generation when record was written
+  uint32_t generation;
+  uint32_t reserved;
+
+  // netFileChecksum of genome
+  uint64_t checksum;
+
+} TpopArchiveEntry;
+
+
+/**
+ * archive opened for writing
+ *
+ * slot of net is assigned when it is saved first time (nets must stay
+ * same objects between saves, like nets of genome arena), next saves
+ * write only records of nets whose genome changed
+ */
+typedef struct {
+
+  FILE* file;
+
+  TpopArchiveHeader header;
+
+  // index of last save (entry of every rank)
+  TpopArchiveEntry* index;
+
+  // net in slot, checksum of its record (0 if not written yet) and
+  // generation when record was written
+  const TchNet** slotNets;
+  uint64_t* slotChecksums;
+  uint32_t* slotGenerations;
+
+  // records written by last save
+  int lastWritten;
+
+} TpopArchive;
+
+
+/**
+ * creates (or truncates) archive for slotCount nets like net
+ *
+ * @return NULL if file can not be created
+ */
+TpopArchive* createPopArchive(const char* fileName, int slotCount,
+                              const TchNet* net);
+
+/**
+ * closes archive
+ */
+void closePopArchive(TpopArchive* archive);
+
+/**
+ * saves population (ordered by fitness) to archive
+ *
+ * only changed nets are written (each to its own place), then index and
+ * header are patched
+ *
+ * @param fitness fitness of population (can be NULL)
+ * @return false if writing failed or population doesn`t fit to archive
+ */
+bool popArchiveSave(TpopArchive* archive, TchNet** population,
+                    int populationCount, int generation,
+                    const float* fitness);
+
+/**
+ * reads net on rank (0 is best) from archive file
+ *
+ * @return NULL if error
+ */
+TchNet* loadPopArchiveNet(const char* fileName, int rank);
+
+/**
+ * loads net given by name (command line, option of UCI)
+ *
+ * @param name net file (binary or text) or "archive@rank" for net of
+ *        population archive (rank 1 is the best net)
+ * @return NULL if error
+ */
+TchNet* loadNamedNet(const char* name);
+
+#endif
@@ -0,0 +1,281 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "pop_batch.h"
+#include "chess_net.h"
+#include "chess_structs.h"
+#include "fcnn.h"
+#include "neuron.h"
+#include "dense.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+
+/**
+ * returns zeroed block of count floats aligned to DENSE_ALIGN
+ */
+static float* allocLanes(int count)
+{
+  size_t size = count * sizeof(float);
+  size = (size + DENSE_ALIGN - 1) / DENSE_ALIGN * DENSE_ALIGN;
+  float* block = aligned_alloc(DENSE_ALIGN, size);
+  if(block != NULL){
+    memset(block, 0, size);
+  }
+  return block;
+}
+
+/**
+ * returns true if nets have same fcnn topology and activation
+ */
+static bool sameTopology(const TchNet* a, const TchNet* b)
+{
+  if(a->fcnn->layerCount != b->fcnn->layerCount ||
+     a->fcnn->activation != b->fcnn->activation){
+    return false;
+  }
+  for(int l = 0; l < a->fcnn->layerCount; ++l){
+    if(a->fcnn->neuronsInLayersCount[l] != b->fcnn->neuronsInLayersCount[l]){
+      return false;
+    }
+  }
+  return true;
+}
+
+
+TpopBatch* initPopBatch(TchNet** nets, int netCount)
+{
+  if(netCount < 1){
+    return NULL;
+  }
+  for(int p = 1; p < netCount; ++p){
+    if(!sameTopology(nets[0], nets[p])){
+      return NULL;
+    }
+  }
+
+  const Tfcnn* first = nets[0]->fcnn;
+
+  TpopBatch* batch = calloc(1, sizeof(TpopBatch));
+  if(batch == NULL){
+    return NULL;
+  }
+  batch->netCount = netCount;
+  batch->laneCount = denseStride(netCount);
+  batch->layerCount = first->layerCount;
+  batch->activation = first->activation;
+  batch->neuronsInLayersCount = malloc(first->layerCount * sizeof(int));
+  batch->weights = calloc(first->layerCount - 1, sizeof(float*));
+  batch->biases = calloc(first->layerCount - 1, sizeof(float*));
+  batch->preprOutputs = allocLanes(PREPR_NEURONS_COUNT * CHNET_PIECE_INDEX_COUNT *
+                                   batch->laneCount);
+  if(batch->neuronsInLayersCount == NULL || batch->weights == NULL ||
+     batch->biases == NULL || batch->preprOutputs == NULL){
+    freePopBatch(batch);
+    return NULL;
+  }
+  memcpy(batch->neuronsInLayersCount, first->neuronsInLayersCount,
+         first->layerCount * sizeof(int));
+
+  const int lanes = batch->laneCount;
+
+  for(int s = 0; s < PREPR_NEURONS_COUNT; ++s){
+    for(int k = 0; k < CHNET_PIECE_INDEX_COUNT; ++k){
+      for(int p = 0; p < netCount; ++p){
+        batch->preprOutputs[(s*CHNET_PIECE_INDEX_COUNT + k)*lanes + p] =
+          nets[p]->preprOutputs[s*CHNET_PIECE_INDEX_COUNT + k];
+      }
+    }
+  }
+
+  for(int l = 0; l < batch->layerCount - 1; ++l){
+    int in = batch->neuronsInLayersCount[l];
+    int out = batch->neuronsInLayersCount[l+1];
+    int stride = denseStride(out);
+
+    batch->weights[l] = allocLanes(in * out * lanes);
+    batch->biases[l] = allocLanes(out * lanes);
+    if(batch->weights[l] == NULL || batch->biases[l] == NULL){
+      freePopBatch(batch);
+      return NULL;
+    }
+
+    for(int p = 0; p < netCount; ++p){
+      const Tfcnn* f = nets[p]->fcnn;
+      for(int j = 0; j < out; ++j){
+        for(int i = 0; i < in; ++i){
+          batch->weights[l][(i*out + j)*lanes + p] =
+            f->weights[l][i*stride + j];
+        }
+        batch->biases[l][j*lanes + p] = f->biases[l][j];
+      }
+    }
+  }
+
+  return batch;
+}
+
+
+void freePopBatch(TpopBatch* batch)
+{
+  if(batch == NULL){
+    return;
+  }
+  for(int l = 0; l < batch->layerCount - 1; ++l){
+    if(batch->weights != NULL){
+      free(batch->weights[l]);
+    }
+    if(batch->biases != NULL){
+      free(batch->biases[l]);
+    }
+  }
+  free(batch->weights);
+  free(batch->biases);
+  free(batch->preprOutputs);
+  free(batch->neuronsInLayersCount);
+  free(batch);
+}
+
+
+/**
+ * returns number of neurons in biggest layer of batch
+ */
+static int maxLayerSize(const TpopBatch* batch)
+{
+  int max = 0;
+  for(int l = 0; l < batch->layerCount; ++l){
+    if(batch->neuronsInLayersCount[l] > max){
+      max = batch->neuronsInLayersCount[l];
+    }
+  }
+  return max;
+}
+
+/**
+ * popBatchPredict with preallocated buffers
+ *
+ * @param a, b buffers for maxLayerSize(batch)*laneCount floats
+ */
+static bool popBatchPredictBuf(const TpopBatch* batch, const char* posString,
+                               float* outputs, float* a, float* b)
+{
+  const int lanes = batch->laneCount;
+
+  for(int s = 0; s < PREPR_NEURONS_COUNT; ++s){
+    int k = chNetPieceIndex(posString[s]);
+    if(k < 0){
+      return false;
+    }
+    memcpy(a + s*lanes, batch->preprOutputs + (s*CHNET_PIECE_INDEX_COUNT + k)*lanes,
+           lanes * sizeof(float));
+  }
+
+  for(int l = 0; l < batch->layerCount - 1; ++l){
+    denseLayerLanes(batch->weights[l], batch->biases[l], a, b,
+                    batch->neuronsInLayersCount[l],
+                    batch->neuronsInLayersCount[l+1], lanes,
+                    batch->activation);
+    float* temp = a;
+    a = b;
+    b = temp;
+  }
+
+  // output layer has one neuron
+  memcpy(outputs, a, batch->netCount * sizeof(float));
+  return true;
+}
+
+bool popBatchPredict(const TpopBatch* batch, const char* posString,
+                     float* outputs)
+{
+  int size = maxLayerSize(batch) * batch->laneCount;
+  float* a = allocLanes(size);
+  float* b = allocLanes(size);
+  bool ok = (a != NULL && b != NULL) &&
+            popBatchPredictBuf(batch, posString, outputs, a, b);
+  free(a);
+  free(b);
+  return ok;
+}
+
+void popBatchPredictPositions(const TpopBatch* batch, char** posStrings,
+                              int count, float* outputs)
+{
+  int size = maxLayerSize(batch) * batch->laneCount;
+  float* a = allocLanes(size);
+  float* b = allocLanes(size);
+
+  for(int i = 0; i < count; ++i){
+    float* out = outputs + (size_t)i * batch->netCount;
+    if(a == NULL || b == NULL ||
+       !popBatchPredictBuf(batch, posStrings[i], out, a, b)){
+      for(int p = 0; p < batch->netCount; ++p){
+        out[p] = NAN;
+      }
+    }
+  }
+
+  free(a);
+  free(b);
+}
+
+
+void popBatchReport(TchNet** nets, int netCount, Tboard** positions,
+                    int positionCount)
+{
+  TpopBatch* batch = initPopBatch(nets, netCount);
+  if(batch == NULL){
+    printf("nets can not be stacked (different topology or activation)\n");
+    return;
+  }
+
+  char** posStrings = malloc(positionCount * sizeof(char*));
+  float* single = malloc((size_t)positionCount * netCount * sizeof(float));
+  float* stacked = malloc((size_t)positionCount * netCount * sizeof(float));
+  for(int i = 0; i < positionCount; ++i){
+    posStrings[i] = boardToPosString(positions[i]);
+  }
+
+  clock_t start = clock();
+  for(int i = 0; i < positionCount; ++i){
+    for(int p = 0; p < netCount; ++p){
+      single[i*netCount + p] = chNetPredict(nets[p], posStrings[i]);
+    }
+  }
+  double singleTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  start = clock();
+  popBatchPredictPositions(batch, posStrings, positionCount, stacked);
+  double stackedTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  double maxErr = 0;
+  for(int i = 0; i < positionCount * netCount; ++i){
+    maxErr = fmax(maxErr, fabs(single[i] - stacked[i]));
+  }
+
+  double evalCount = (double)positionCount * netCount;
+
+  printf("nets:                 %d\n", netCount);
+  printf("positions:            %d\n", positionCount);
+  printf("max eval difference:  %e\n", maxErr);
+  printf("one by one:           %8.1f ns/eval\n",
+         singleTime * 1e9 / evalCount);
+  printf("population batch:     %8.1f ns/eval (%.1fx)\n",
+         stackedTime * 1e9 / evalCount,
+         (stackedTime > 0) ? singleTime / stackedTime : 0);
+
+  for(int i = 0; i < positionCount; ++i){
+    free(posStrings[i]);
+  }
+  free(posStrings);
+  free(single);
+  free(stacked);
+  freePopBatch(batch);
+}
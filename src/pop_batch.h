@@ -0,0 +1,104 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_POP_BATCH_H
+#define __MODULE_POP_BATCH_H
+
+#include "chess_net.h"
+#include "chess_structs.h"
+
+#include <stdbool.h>
+
+
+/**
+ * whole population of chess nets with same topology stacked together
+ *
+ * every parameter is stored for all nets next to each other (net index is
+ * innermost), so one position goes through all nets at once and vector
+ * instructions work across nets
+ */
+typedef struct {
+
+  // number of stacked nets
+  int netCount;
+
+  // netCount rounded up by denseStride(), padding nets have zero weights
+  int laneCount;
+
+  //nuber of layers of fcnn including input and output layer
+  int layerCount;
+
+  //number of neurons for each layer
+  int* neuronsInLayersCount;
+
+  // activation of all neurons
+  Tactivation activation;
+
+  /**
+   * output of preprocessing neuron of every square for every piece
+   *
+   * preprOutputs[(square*CHNET_PIECE_INDEX_COUNT + pieceIndex)*laneCount
+   *              + net]
+   */
+  float* preprOutputs;
+
+  /**
+   * weights of layers (there is one less layer than layerCount)
+   *
+   * weight of i-th input of j-th neuron of net p is
+   * weights[l][(i*neuronsInLayersCount[l+1] + j)*laneCount + p]
+   */
+  float** weights;
+
+  // biases[l][j*laneCount + p]
+  float** biases;
+
+} TpopBatch;
+
+
+/**
+ * returns stacked copy of netCount nets
+ *
+ * returns NULL if nets differ in topology or activation (or netCount < 1)
+ *
+ * @note later changes of nets are not reflected in batch
+ */
+TpopBatch* initPopBatch(TchNet** nets, int netCount);
+
+/**
+ * frees population batch
+ */
+void freePopBatch(TpopBatch* batch);
+
+/**
+ * evaluates one position by all nets of batch
+ *
+ * @param outputs gets filled by netCount evaluations, outputs[p] is same
+ *        (up to DENSE_TOLERANCE) as chNetPredict(nets[p], posString)
+ *
+ * @return false if posString is not valid (outputs are not changed)
+ */
+bool popBatchPredict(const TpopBatch* batch, const char* posString,
+                     float* outputs);
+
+/**
+ * evaluates count positions by all nets of batch
+ *
+ * @param outputs gets filled by count*netCount evaluations, evaluation of
+ *        i-th position by p-th net is outputs[i*netCount + p]
+ *        (NAN for invalid position)
+ */
+void popBatchPredictPositions(const TpopBatch* batch, char** posStrings,
+                              int count, float* outputs);
+
+/**
+ * evaluates positions by every net one by one (chNetPredict) and by
+ * population batch and prints max difference and speed of both to stdout
+ */
+void popBatchReport(TchNet** nets, int netCount, Tboard** positions,
+                    int positionCount);
+
+#endif
@@ -0,0 +1,380 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "pos_dataset.h"
+#include "chess_logic.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+
+// pieces of codes 1-6 (white) and 9-14 (black), board uses lowercase for
+// white
+static const char codePieces[16] = {' ', 'p', 'n', 'b', 'r', 'q', 'k', ' ',
+                                    ' ', 'P', 'N', 'B', 'R', 'Q', 'K', ' '};
+
+// slots probed before position is considered new
+#define SEEN_MAX_PROBES 32
+
+
+/**
+ * returns 4 bit code of piece (0 for empty square)
+ */
+static int pieceCode(char piece)
+{
+  for(int code = 1; code < 16; ++code){
+    if(codePieces[code] == piece && piece != ' '){
+      return code;
+    }
+  }
+  return 0;
+}
+
+void packPosition(const Tboard* b, float score, int result, TpackedPos* p)
+{
+  memset(p, 0, sizeof(TpackedPos));
+
+  int count = 0;
+  for(int square = 0; square < 64; ++square){
+    // row 0 of board is rank 8
+    char piece = b->pieces[7 - square/8][square%8];
+    int code = pieceCode(piece);
+    if(code == 0 || count == 32){
+      continue;
+    }
+    p->occupancy |= (uint64_t)1 << square;
+    p->pieces[count/2] |= code << (4 * (count%2));
+    ++count;
+  }
+
+  p->score = score;
+  p->result = result;
+  p->flags = (b->move%2 != 0) |
+             (b->canWhiteCastle[0] << 1) | (b->canWhiteCastle[1] << 2) |
+             (b->canBlackCastle[0] << 3) | (b->canBlackCastle[1] << 4);
+
+  // en passant is possible after jump of pawn by two
+  const char* m = b->lastMove;
+  if(m[0] >= 'A' && m[0] <= 'H' && m[0] == m[2] &&
+     ((m[1] == '2' && m[3] == '4' && b->pieces[4][m[2]-'A'] == 'p') ||
+      (m[1] == '7' && m[3] == '5' && b->pieces[3][m[2]-'A'] == 'P'))){
+    p->epFile = m[0] - 'A' + 1;
+  }
+}
+
+Tboard* unpackPosition(const TpackedPos* p)
+{
+  Tboard* b = malloc(sizeof(Tboard));
+  if(b == NULL){
+    return NULL;
+  }
+  b->lastMove = malloc(MAX_INP_LEN * sizeof(char));
+  b->boringPoss = malloc(0);
+  b->boringMoveCount = 0;
+  b->pieceCount = 0;
+  b->arena = NULL;
+  b->move = p->flags & 1;
+  b->canWhiteCastle[0] = (p->flags >> 1) & 1;
+  b->canWhiteCastle[1] = (p->flags >> 2) & 1;
+  b->canBlackCastle[0] = (p->flags >> 3) & 1;
+  b->canBlackCastle[1] = (p->flags >> 4) & 1;
+
+  for(int square = 0; square < 64; ++square){
+    char piece = ' ';
+    if(p->occupancy & ((uint64_t)1 << square)){
+      int count = b->pieceCount;
+      int code = (p->pieces[count/2] >> (4 * (count%2))) & 15;
+      piece = codePieces[code];
+      ++b->pieceCount;
+    }
+    b->pieces[7 - square/8][square%8] = piece;
+  }
+
+  strcpy(b->lastMove, "0000");
+  if(p->epFile > 0 && p->epFile <= 8){
+    char file = 'A' + p->epFile - 1;
+    // side to move is the one who can take
+    strcpy(b->lastMove, (b->move == 1) ?
+                        (char[]){file, '2', file, '4', '\0'} :
+                        (char[]){file, '7', file, '5', '\0'});
+  }
+
+  return b;
+}
+
+uint64_t packedPosHash(const TpackedPos* p)
+{
+  uint64_t words[3];
+  memcpy(&words[0], p->pieces, 8);
+  memcpy(&words[1], p->pieces + 8, 8);
+  words[2] = p->flags | ((uint64_t)p->epFile << 8);
+
+  uint64_t hash = p->occupancy;
+  for(int i = 0; i < 3; ++i){
+    hash = (hash ^ words[i]) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+  }
+  hash ^= hash >> 32;
+  return (hash == 0) ? 1 : hash;
+}
+
+
+/**
+ * returns true if hash was not in set before (and inserts it)
+ */
+static bool posDatasetInsertSeen(TposDataset* dataset, uint64_t hash)
+{
+  size_t mask = dataset->seenCapacity - 1;
+  for(size_t i = 0; i < SEEN_MAX_PROBES; ++i){
+    uint64_t* slot = &dataset->seen[(hash + i) & mask];
+    uint64_t expected = 0;
+    if(__atomic_compare_exchange_n(slot, &expected, hash, false,
+                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+      return true;
+    }
+    if(expected == hash){
+      return false;
+    }
+  }
+  // set is full around hash, duplicate is better than lost position
+  return true;
+}
+
+
+/**
+ * opens shard for appending, header h is written if file is empty
+ *
+ * @return NULL if error or existing file is not shard of same records
+ */
+static FILE* openPosShard(const char* fileName, const TposShardHeader* h)
+{
+  // in append mode every write goes to end of file, header can be read
+  FILE* f = fopen(fileName, "a+b");
+  if(f == NULL){
+    return NULL;
+  }
+
+  bool ok;
+  if(fseek(f, 0, SEEK_END) == 0 && ftell(f) == 0){
+    ok = fwrite(h, sizeof(TposShardHeader), 1, f) == 1;
+  } else {
+    TposShardHeader old;
+    rewind(f);
+    ok = fread(&old, sizeof(old), 1, f) == 1 &&
+         memcmp(old.magic, h->magic, POS_DATASET_MAGIC_LEN) == 0 &&
+         old.recordSize == h->recordSize;
+
+    // run killed while writing leaves part of record at the end, new
+    // records would be shifted by it, so it is cut off
+    if(ok){
+      long size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+      long torn = (size - (long)sizeof(TposShardHeader)) % h->recordSize;
+      ok = size >= 0;
+      if(ok && torn != 0){
+        fprintf(stderr, "%s: dropping %ld bytes of torn record\n",
+                fileName, torn);
+        ok = ftruncate(fileno(f), size - torn) == 0 &&
+             fseek(f, 0, SEEK_END) == 0;
+      }
+    }
+  }
+
+  if(!ok){
+    fprintf(stderr, "%s is not position shard\n", fileName);
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+TposDataset* createPosDataset(const char* prefix, size_t seenCapacity)
+{
+  TposDataset* dataset = calloc(1, sizeof(TposDataset));
+  if(dataset == NULL){
+    return NULL;
+  }
+  dataset->seenCapacity = 1;
+  while(dataset->seenCapacity < seenCapacity){
+    dataset->seenCapacity *= 2;
+  }
+  dataset->seen = calloc(dataset->seenCapacity, sizeof(uint64_t));
+  dataset->shardCount = omp_get_max_threads();
+  dataset->shards = calloc(dataset->shardCount, sizeof(FILE*));
+  dataset->buffers = calloc(dataset->shardCount, sizeof(TpackedPos*));
+  dataset->bufferFilled = calloc(dataset->shardCount, sizeof(int));
+  bool ok = dataset->seen != NULL && dataset->shards != NULL &&
+            dataset->buffers != NULL && dataset->bufferFilled != NULL;
+
+  TposShardHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, POS_DATASET_MAGIC, POS_DATASET_MAGIC_LEN);
+  h.recordSize = sizeof(TpackedPos);
+
+  for(int t = 0; ok && t < dataset->shardCount; ++t){
+    char fileName[256];
+    snprintf(fileName, sizeof(fileName), "%s.%d.pos", prefix, t);
+    dataset->shards[t] = openPosShard(fileName, &h);
+    dataset->buffers[t] = malloc(POS_DATASET_BUFFER_LEN *
+                                 sizeof(TpackedPos));
+    ok = dataset->shards[t] != NULL && dataset->buffers[t] != NULL;
+  }
+
+  if(!ok){
+    for(int t = 0; dataset->shards != NULL && dataset->buffers != NULL &&
+                   t < dataset->shardCount; ++t){
+      if(dataset->shards[t] != NULL){
+        fclose(dataset->shards[t]);
+      }
+      free(dataset->buffers[t]);
+    }
+    free(dataset->shards);
+    free(dataset->buffers);
+    free(dataset->bufferFilled);
+    free(dataset->seen);
+    free(dataset);
+    return NULL;
+  }
+
+  return dataset;
+}
+
+void closePosDataset(TposDataset* dataset)
+{
+  if(!posDatasetFlush(dataset)){
+    fprintf(stderr, "can not write position dataset\n");
+  }
+  printf("position dataset: %ld positions in %d shards, "
+         "%ld duplicates skipped\n",
+         dataset->positions, dataset->shardCount, dataset->duplicates);
+
+  for(int t = 0; t < dataset->shardCount; ++t){
+    fclose(dataset->shards[t]);
+    free(dataset->buffers[t]);
+  }
+  free(dataset->shards);
+  free(dataset->buffers);
+  free(dataset->bufferFilled);
+  free(dataset->seen);
+  free(dataset);
+}
+
+
+bool posDatasetAddGame(TposDataset* dataset, const TgameRecord* record)
+{
+  Tboard* b;
+  if(record->startFen[0] == '\0'){
+    b = initBoard();
+  } else {
+    b = fenToBoard(record->startFen);
+    if(b == NULL){
+      return false;
+    }
+  }
+
+  // thread without own shard (nested parallelism) writes directly
+  int thread = omp_get_thread_num();
+  bool isBuffered = thread < dataset->shardCount;
+  FILE* shard = dataset->shards[thread % dataset->shardCount];
+
+  bool ok = true;
+  long positions = 0, duplicates = 0;
+  char move[MAX_INP_LEN];
+  for(int i = 0; i < record->moveCount; ++i){
+    TpackedPos p;
+    packPosition(b, record->moves[i].evaluation, record->result, &p);
+
+    if(!posDatasetInsertSeen(dataset, packedPosHash(&p))){
+      ++duplicates;
+    } else if(isBuffered){
+      dataset->buffers[thread][dataset->bufferFilled[thread]++] = p;
+      if(dataset->bufferFilled[thread] == POS_DATASET_BUFFER_LEN){
+        ok = fwrite(dataset->buffers[thread], sizeof(TpackedPos),
+                    POS_DATASET_BUFFER_LEN, shard) ==
+               POS_DATASET_BUFFER_LEN && ok;
+        dataset->bufferFilled[thread] = 0;
+      }
+      ++positions;
+    } else {
+      ok = fwrite(&p, sizeof(p), 1, shard) == 1 && ok;
+      ++positions;
+    }
+
+    gameLogDecodeMove(record->moves[i].move, move);
+    moveBoard(move, b);
+  }
+  freeBoard(b);
+
+  __atomic_fetch_add(&dataset->positions, positions, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dataset->duplicates, duplicates, __ATOMIC_RELAXED);
+  return ok;
+}
+
+bool posDatasetFlush(TposDataset* dataset)
+{
+  bool ok = true;
+  for(int t = 0; t < dataset->shardCount; ++t){
+    int filled = dataset->bufferFilled[t];
+    if(filled > 0){
+      ok = fwrite(dataset->buffers[t], sizeof(TpackedPos), filled,
+                  dataset->shards[t]) == (size_t)filled && ok;
+      dataset->bufferFilled[t] = 0;
+    }
+    ok = (fflush(dataset->shards[t]) == 0) && ok;
+  }
+  return ok;
+}
+
+
+TposShard* mapPosShard(const char* fileName)
+{
+  int fd = open(fileName, O_RDONLY);
+  if(fd < 0){
+    return NULL;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TposShardHeader)){
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = st.st_size;
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    return NULL;
+  }
+
+  const TposShardHeader* h = map;
+  TposShard* shard = malloc(sizeof(TposShard));
+  if(shard == NULL ||
+     memcmp(h->magic, POS_DATASET_MAGIC, POS_DATASET_MAGIC_LEN) != 0 ||
+     h->recordSize != sizeof(TpackedPos)){
+    free(shard);
+    munmap(map, size);
+    return NULL;
+  }
+  // scans go through shard once from start to end
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  shard->positions = (const TpackedPos*)(h + 1);
+  // incomplete record at the end (interrupted write) is ignored
+  shard->count = (size - sizeof(TposShardHeader)) / sizeof(TpackedPos);
+  shard->map = map;
+  shard->mapSize = size;
+  return shard;
+}
+
+void unmapPosShard(TposShard* shard)
+{
+  munmap(shard->map, shard->mapSize);
+  free(shard);
+}
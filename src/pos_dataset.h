@@ -0,0 +1,178 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_POS_DATASET_H
+#define __MODULE_POS_DATASET_H
+
+#include "chess_structs.h"
+#include "game_log.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// default shards of evolution are POS_DATASET_PREFIX.<thread>.pos
+#define POS_DATASET_PREFIX "population/positions"
+
+#define POS_DATASET_MAGIC "NNPOSDS1"
+#define POS_DATASET_MAGIC_LEN 8
+
+// positions buffered by thread before they are written to its shard
+#define POS_DATASET_BUFFER_LEN 2048
+
+// default number of remembered position hashes (power of two)
+#define POS_DATASET_SEEN_CAPACITY (1 << 22)
+
+
+/**
+ * position packed to 32 bytes
+ *
+ * squares are numbered a1 = 0, b1 = 1, ..., h8 = 63, piece codes are
+ * 1-6 for white pawn, knight, bishop, rook, queen, king and 9-14 for black
+ * ones (4 bits each)
+ */
+typedef struct {
+
+  // bit of square is set if it is occupied
+  uint64_t occupancy;
+
+  // codes of pieces of occupied squares in order of squares (two per byte,
+  // lower nibble first)
+  uint8_t pieces[16];
+
+  // score of search from white`s point of view
+  float score;
+
+  // result of game from white`s point of view (1, 0, -1)
+  int8_t result;
+
+  // bit 0 - black to move, bits 1-4 - castling (white long, white short,
+  // black long, black short)
+  uint8_t flags;
+
+  // file of en passant square + 1 (0 if there is none)
+  uint8_t epFile;
+
+  uint8_t reserved;
+
+} TpackedPos;
+
+/**
+ * header of shard file, followed by TpackedPos records
+ */
+typedef struct {
+
+  char magic[POS_DATASET_MAGIC_LEN];
+  uint32_t recordSize;
+  uint32_t reserved[5];
+
+} TposShardHeader;
+
+
+/**
+ * dataset being written
+ *
+ * every thread has its own shard file and buffer, so threads never wait
+ * for each other. Positions are deduplicated across all shards by hash
+ * (lock free set, when it is full, positions are written without check).
+ * The set is per run, it starts empty, so positions written to shards by
+ * earlier runs (before resume) are not checked.
+ */
+typedef struct {
+
+  int shardCount;
+  FILE** shards;
+  TpackedPos** buffers;
+  int* bufferFilled;
+
+  // hashes of written positions (0 is empty slot), open addressing
+  uint64_t* seen;
+  size_t seenCapacity;
+
+  // statistics (changed atomically)
+  long positions;
+  long duplicates;
+
+} TposDataset;
+
+/**
+ * shard mapped to memory for reading
+ */
+typedef struct {
+
+  const TpackedPos* positions;
+  size_t count;
+
+  void* map;
+  size_t mapSize;
+
+} TposShard;
+
+
+/**
+ * packs position of b
+ */
+void packPosition(const Tboard* b, float score, int result, TpackedPos* p);
+
+/**
+ * returns board of packed position (NULL if error)
+ *
+ * @note history (repetitions, boring moves) is not part of packed position
+ */
+Tboard* unpackPosition(const TpackedPos* p);
+
+/**
+ * returns hash of position (score and result are ignored), never 0
+ */
+uint64_t packedPosHash(const TpackedPos* p);
+
+
+/**
+ * opens one shard per thread (prefix.<thread>.pos) for appending, shard
+ * that does not exist yet is created with header
+ *
+ * @param seenCapacity number of remembered hashes (rounded up to power of
+ *        two)
+ * @return NULL if error (or existing file is not shard)
+ */
+TposDataset* createPosDataset(const char* prefix, size_t seenCapacity);
+
+/**
+ * flushes all buffers, prints statistics and closes dataset
+ */
+void closePosDataset(TposDataset* dataset);
+
+/**
+ * adds position before every move of game (score is evaluation of search,
+ * result is result of game) to shard of calling thread
+ *
+ * @return false if game can not be replayed or writing failed
+ */
+bool posDatasetAddGame(TposDataset* dataset, const TgameRecord* record);
+
+/**
+ * writes buffers of all threads to their shards
+ *
+ * @note must not be called while other threads add games
+ */
+bool posDatasetFlush(TposDataset* dataset);
+
+
+/**
+ * maps shard file to memory
+ *
+ * @return NULL if file is not shard
+ */
+TposShard* mapPosShard(const char* fileName);
+
+/**
+ * unmaps shard
+ */
+void unmapPosShard(TposShard* shard);
+
+#endif
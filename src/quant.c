@@ -0,0 +1,369 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "quant.h"
+#include "chess_net.h"
+#include "chess_logic.h"
+#include "chess_structs.h"
+#include "fcnn.h"
+#include "neuron.h"
+#include "dense.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QUANT_X86
+#include <immintrin.h>
+#endif
+
+
+static int16_t quantizeActivation(float x)
+{
+  long q = lrintf(x * QUANT_ACT_ONE);
+  if(q > INT16_MAX) q = INT16_MAX;
+  if(q < INT16_MIN) q = INT16_MIN;
+  return q;
+}
+
+/**
+ * returns size of buffer for activations of layer with count neurons
+ * (padded to stride and to even count, because inputs go in pairs)
+ */
+static int activationBufferSize(int count)
+{
+  return denseStride(count + 1);
+}
+
+
+/**
+ * acc[j] = sum(x[i] * weight of i-th input of j-th neuron)
+ */
+
+static void qDenseScalar(const int8_t* w, const int16_t* x, int32_t* acc,
+                         int inputCount, int outputCount)
+{
+  int stride = denseStride(outputCount);
+  for(int j = 0; j < outputCount; ++j){
+    int32_t sum = 0;
+    for(int i = 0; i < inputCount; ++i){
+      sum += x[i] * w[(i/2)*stride*2 + j*2 + i%2];
+    }
+    acc[j] = sum;
+  }
+}
+
+#ifdef QUANT_X86
+
+__attribute__((target("sse4.2")))
+static void qDenseSse42(const int8_t* w, const int16_t* x, int32_t* acc,
+                        int inputCount, int outputCount)
+{
+  int stride = denseStride(outputCount);
+  int pairCount = (inputCount + 1) / 2;
+  for(int j = 0; j < outputCount; j += 4){
+    __m128i sum = _mm_setzero_si128();
+    for(int p = 0; p < pairCount; ++p){
+      int32_t pair = (uint16_t)x[2*p] | ((uint32_t)(uint16_t)x[2*p+1] << 16);
+      __m128i weights = _mm_cvtepi8_epi16(
+        _mm_loadl_epi64((const __m128i*)(w + p*stride*2 + j*2)));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(weights, _mm_set1_epi32(pair)));
+    }
+    _mm_storeu_si128((__m128i*)(acc + j), sum);
+  }
+}
+
+__attribute__((target("avx2")))
+static void qDenseAvx2(const int8_t* w, const int16_t* x, int32_t* acc,
+                       int inputCount, int outputCount)
+{
+  int stride = denseStride(outputCount);
+  int pairCount = (inputCount + 1) / 2;
+  for(int j = 0; j < outputCount; j += 8){
+    __m256i sum = _mm256_setzero_si256();
+    for(int p = 0; p < pairCount; ++p){
+      int32_t pair = (uint16_t)x[2*p] | ((uint32_t)(uint16_t)x[2*p+1] << 16);
+      __m256i weights = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128((const __m128i*)(w + p*stride*2 + j*2)));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(weights,
+                                                    _mm256_set1_epi32(pair)));
+    }
+    _mm256_storeu_si256((__m256i*)(acc + j), sum);
+  }
+}
+
+#endif
+
+/**
+ * integer results are same for all levels,
+ * avx512 level uses avx2 kernel (avx512f has no int16 madd)
+ */
+static void qDense(const int8_t* w, const int16_t* x, int32_t* acc,
+                   int inputCount, int outputCount)
+{
+  switch(getSimdLevel()){
+#ifdef QUANT_X86
+    case SIMD_AVX512:
+    case SIMD_AVX2:
+      qDenseAvx2(w, x, acc, inputCount, outputCount);
+      return;
+    case SIMD_SSE42:
+      qDenseSse42(w, x, acc, inputCount, outputCount);
+      return;
+#endif
+    default:
+      qDenseScalar(w, x, acc, inputCount, outputCount);
+      return;
+  }
+}
+
+
+TqNet* quantizeChNet(const TchNet* net)
+{
+  const Tfcnn* fcnn = net->fcnn;
+  for(int l = 0; l < fcnn->layerCount - 1; ++l){
+    if(fcnn->neuronsInLayersCount[l] > QUANT_MAX_INPUTS){
+      return NULL;
+    }
+  }
+
+  TqNet* q = malloc(sizeof(TqNet));
+  q->layerCount = fcnn->layerCount;
+  q->activation = fcnn->activation;
+  q->neuronsInLayersCount = malloc(q->layerCount * sizeof(int));
+  memcpy(q->neuronsInLayersCount, fcnn->neuronsInLayersCount,
+         q->layerCount * sizeof(int));
+
+  // preprocessing neurons have one hot inputs, so their outputs are tabled
+  q->preprOutputs = calloc(PREPR_NEURONS_COUNT * QUANT_PREPR_STRIDE,
+                           sizeof(int16_t));
+  for(int s = 0; s < PREPR_NEURONS_COUNT; ++s){
+    for(int k = 0; k < CHNET_PIECE_INDEX_COUNT; ++k){
+      q->preprOutputs[s*QUANT_PREPR_STRIDE + k] = quantizeActivation(
+        net->preprOutputs[s*CHNET_PIECE_INDEX_COUNT + k]);
+    }
+  }
+
+  q->weights = malloc((q->layerCount-1) * sizeof(int8_t*));
+  q->weightScales = malloc((q->layerCount-1) * sizeof(float));
+  q->biases = malloc((q->layerCount-1) * sizeof(float*));
+
+  for(int l = 1; l < q->layerCount; ++l){
+    int in = q->neuronsInLayersCount[l-1], out = q->neuronsInLayersCount[l];
+    int stride = denseStride(out);
+    int pairCount = (in + 1) / 2;
+
+    float maxAbs = 0;
+    for(int i = 0; i < in; ++i){
+      for(int j = 0; j < out; ++j){
+        maxAbs = fmaxf(maxAbs, fabsf(fcnn->weights[l-1][i*stride + j]));
+      }
+    }
+    q->weightScales[l-1] = (maxAbs > 0) ? (QUANT_WEIGHT_MAX / maxAbs) : 1;
+
+    q->weights[l-1] = calloc(pairCount * stride * 2, sizeof(int8_t));
+    for(int i = 0; i < in; ++i){
+      for(int j = 0; j < out; ++j){
+        q->weights[l-1][(i/2)*stride*2 + j*2 + i%2] =
+          lrintf(fcnn->weights[l-1][i*stride + j] * q->weightScales[l-1]);
+      }
+    }
+
+    q->biases[l-1] = malloc(stride * sizeof(float));
+    memcpy(q->biases[l-1], fcnn->biases[l-1], stride * sizeof(float));
+  }
+
+  return q;
+}
+
+
+void freeQNet(TqNet* net)
+{
+  for(int l = 0; l < net->layerCount - 1; ++l){
+    free(net->weights[l]);
+    free(net->biases[l]);
+  }
+  free(net->weights);
+  free(net->weightScales);
+  free(net->biases);
+  free(net->preprOutputs);
+  free(net->neuronsInLayersCount);
+  free(net);
+}
+
+
+int qNetSize(const TqNet* net)
+{
+  int size = PREPR_NEURONS_COUNT * QUANT_PREPR_STRIDE * sizeof(int16_t);
+  for(int l = 1; l < net->layerCount; ++l){
+    int stride = denseStride(net->neuronsInLayersCount[l]);
+    int pairCount = (net->neuronsInLayersCount[l-1] + 1) / 2;
+    size += pairCount * stride * 2 * sizeof(int8_t);
+    size += stride * sizeof(float);
+  }
+  return size;
+}
+
+
+int chNetSize(const TchNet* net)
+{
+  int size = PREPR_NEURONS_COUNT * (PREPR_NEURON_INP_COUNT + 1) * sizeof(float);
+  for(int l = 1; l < net->fcnn->layerCount; ++l){
+    int stride = denseStride(net->fcnn->neuronsInLayersCount[l]);
+    size += (net->fcnn->neuronsInLayersCount[l-1] + 1) * stride * sizeof(float);
+  }
+  return size;
+}
+
+
+float qNetPredict(const TqNet* net, const char* posString)
+{
+  int bufferSize = 0;
+  for(int l = 0; l < net->layerCount; ++l){
+    if(activationBufferSize(net->neuronsInLayersCount[l]) > bufferSize){
+      bufferSize = activationBufferSize(net->neuronsInLayersCount[l]);
+    }
+  }
+
+  int16_t x[bufferSize];
+  int32_t acc[bufferSize];
+  float y[bufferSize];
+
+  for(int s = 0; s < PREPR_NEURONS_COUNT; ++s){
+    int k = chNetPieceIndex(posString[s]);
+    if(k < 0){
+      return NAN;
+    }
+    x[s] = net->preprOutputs[s*QUANT_PREPR_STRIDE + k];
+  }
+  x[PREPR_NEURONS_COUNT] = 0;
+
+  for(int l = 1; l < net->layerCount; ++l){
+    int in = net->neuronsInLayersCount[l-1], out = net->neuronsInLayersCount[l];
+
+    qDense(net->weights[l-1], x, acc, in, out);
+
+    float scale = 1 / (QUANT_ACT_ONE * net->weightScales[l-1]);
+    for(int j = 0; j < out; ++j){
+      y[j] = acc[j] * scale + net->biases[l-1][j];
+    }
+    activateVector(net->activation, y, out);
+
+    for(int j = 0; j < out; ++j){
+      x[j] = quantizeActivation(y[j]);
+    }
+    x[out] = 0;
+  }
+
+  return y[0];
+}
+
+
+/**
+ * returns index of best move found by one ply search with chNet or qNet
+ */
+static int bestMoveIndex(const Tboard* b, const TmoveList* ml,
+                         const TchNet* net, const TqNet* qnet)
+{
+  bool isWhite = (b->move % 2 == 0);
+  int best = 0;
+  float bestEval = 0;
+
+  for(int i = 0; i < ml->filled; ++i){
+    Tboard* copy = copyBoard(b);
+    moveBoard(ml->moves[i], copy);
+    char* posString = boardToPosString(copy);
+
+    float eval = (qnet != NULL) ? qNetPredict(qnet, posString) :
+                                  chNetPredict(net, posString);
+
+    if(i == 0 || (isWhite && eval > bestEval) ||
+       (!isWhite && eval < bestEval)){
+      best = i;
+      bestEval = eval;
+    }
+
+    free(posString);
+    freeBoard(copy);
+  }
+
+  return best;
+}
+
+
+void quantReport(const TchNet* net, Tboard** positions, int positionCount)
+{
+  const int speedRepetitions = 100;
+
+  TqNet* qnet = quantizeChNet(net);
+  if(qnet == NULL){
+    printf("net can not be quantized (too many inputs of neuron)\n");
+    return;
+  }
+
+  char** posStrings = malloc(positionCount * sizeof(char*));
+  double maxErr = 0, sumErr = 0;
+  int sameMoveCount = 0, moveCount = 0;
+
+  for(int i = 0; i < positionCount; ++i){
+    posStrings[i] = boardToPosString(positions[i]);
+
+    double err = fabs(chNetPredict(net, posStrings[i]) -
+                      qNetPredict(qnet, posStrings[i]));
+    maxErr = fmax(maxErr, err);
+    sumErr += err;
+
+    TmoveList* ml = initMoveList(16);
+    generateAllPossibleMoves(positions[i], ml);
+    if(ml->filled > 0){
+      moveCount++;
+      if(bestMoveIndex(positions[i], ml, net, NULL) ==
+         bestMoveIndex(positions[i], ml, NULL, qnet)){
+        sameMoveCount++;
+      }
+    }
+    freeMoveList(ml);
+  }
+
+  volatile float sink = 0;
+  clock_t start = clock();
+  for(int r = 0; r < speedRepetitions; ++r){
+    for(int i = 0; i < positionCount; ++i){
+      sink += chNetPredict(net, posStrings[i]);
+    }
+  }
+  double floatTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  start = clock();
+  for(int r = 0; r < speedRepetitions; ++r){
+    for(int i = 0; i < positionCount; ++i){
+      sink += qNetPredict(qnet, posStrings[i]);
+    }
+  }
+  double quantTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+  (void)sink;
+
+  double evalCount = (double)positionCount * speedRepetitions;
+
+  printf("positions:            %d\n", positionCount);
+  printf("max eval error:       %e\n", maxErr);
+  printf("mean eval error:      %e\n", sumErr / positionCount);
+  printf("same best move:       %d/%d (%.2f %%)\n", sameMoveCount, moveCount,
+         (moveCount > 0) ? (100.0 * sameMoveCount / moveCount) : 0);
+  printf("float net:            %8.1f ns/eval %8d B\n",
+         floatTime * 1e9 / evalCount, chNetSize(net));
+  printf("quantized net:        %8.1f ns/eval %8d B\n",
+         quantTime * 1e9 / evalCount, qNetSize(qnet));
+
+  for(int i = 0; i < positionCount; ++i){
+    free(posStrings[i]);
+  }
+  free(posStrings);
+  freeQNet(qnet);
+}
@@ -0,0 +1,106 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_QUANT_H
+#define __MODULE_QUANT_H
+
+#include "chess_net.h"
+#include "chess_structs.h"
+
+#include <stdint.h>
+
+
+// activations between layers are fixed point numbers, this is 1.0
+#define QUANT_ACT_ONE 16384
+
+// weights are scaled to [-QUANT_WEIGHT_MAX, QUANT_WEIGHT_MAX]
+#define QUANT_WEIGHT_MAX 127
+
+// more inputs of one neuron could overflow int32 accumulator
+#define QUANT_MAX_INPUTS 1024
+
+
+/**
+ * chess network with int8 weights
+ *
+ * activations are int16 (QUANT_ACT_ONE == 1.0), dot products are
+ * accumulated in int32 and activation functions are computed in float
+ */
+typedef struct {
+
+  //nuber of layers of fcnn including input and output layer
+  int layerCount;
+
+  //number of neurons for each layer
+  int* neuronsInLayersCount;
+
+  // activation of all neurons
+  Tactivation activation;
+
+  /**
+   * output of preprocessing neuron of every square for every piece
+   *
+   * preprOutputs[square*QUANT_PREPR_STRIDE + chNetPieceIndex(piece)]
+   */
+  int16_t* preprOutputs;
+
+  /**
+   * weights of layers (there is one less layer than layerCount)
+   *
+   * inputs go in pairs (for madd instruction), weight of i-th input of j-th
+   * neuron is weights[l][(i/2)*stride*2 + j*2 + i%2],
+   * stride == denseStride(neuronsInLayersCount[l+1])
+   */
+  int8_t** weights;
+
+  // real weight == weights[l][...] / weightScales[l]
+  float* weightScales;
+
+  // biases of layers (float, padded to stride)
+  float** biases;
+
+} TqNet;
+
+// padded count of preprocessing neuron inputs (12 pieces + empty square)
+#define QUANT_PREPR_STRIDE 16
+
+
+/**
+ * returns quantized copy of net
+ *
+ * returns NULL if some layer has more than QUANT_MAX_INPUTS inputs
+ */
+TqNet* quantizeChNet(const TchNet* net);
+
+/**
+ * frees quantized net
+ */
+void freeQNet(TqNet* net);
+
+/**
+ * returns number of bytes used by weights, biases and tables of net
+ */
+int qNetSize(const TqNet* net);
+
+/**
+ * returns number of bytes used by weights and biases of net
+ */
+int chNetSize(const TchNet* net);
+
+/**
+ * same as chNetPredict, but uses quantized net
+ */
+float qNetPredict(const TqNet* net, const char* posString);
+
+/**
+ * compares quantized net with float net on positions and prints:
+ * max and mean difference of evaluations,
+ * rate of same best move (choosen by one ply search),
+ * speed and size of both nets
+ */
+void quantReport(const TchNet* net, Tboard** positions, int positionCount);
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "rng.h"
+
+#include <stdint.h>
+
+
+uint64_t rngSplitMix64(uint64_t* state)
+{
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+void rngSeed(Trng* rng, uint64_t seed, uint64_t generation, uint64_t index)
+{
+  // every counter goes through whole mixing function, so close counters
+  // give unrelated sequences
+  uint64_t key = seed;
+  key = rngSplitMix64(&key) ^ generation;
+  key = rngSplitMix64(&key) ^ index;
+  key = rngSplitMix64(&key);
+
+  for(int i = 0; i < 4; ++i){
+    rng->s[i] = rngSplitMix64(&key);
+  }
+}
+
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+uint64_t rngNext(Trng* rng)
+{
+  uint64_t* s = rng->s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+float rngUnit(Trng* rng)
+{
+  // 24 bits fit exactly to float mantissa
+  return (rngNext(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+float rngFloat(Trng* rng, float min, float max)
+{
+  return rngUnit(rng) * (max - min) + min;
+}
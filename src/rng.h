@@ -0,0 +1,52 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_RNG_H
+#define __MODULE_RNG_H
+
+#include <stdint.h>
+
+
+/**
+ * state of xoshiro256** generator
+ *
+ * every thread (or every child in reproduction) has its own generator,
+ * so nothing is shared and results don`t depend on scheduling
+ */
+typedef struct {
+  uint64_t s[4];
+} Trng;
+
+
+/**
+ * returns next number of splitmix64 sequence given by state
+ */
+uint64_t rngSplitMix64(uint64_t* state);
+
+/**
+ * seeds generator, sequence depends only on (seed, generation, index)
+ *
+ * @param generation generation of evolution (or other counter)
+ * @param index index of child (or other counter)
+ */
+void rngSeed(Trng* rng, uint64_t seed, uint64_t generation, uint64_t index);
+
+/**
+ * returns next 64 random bits
+ */
+uint64_t rngNext(Trng* rng);
+
+/**
+ * returns uniformly distributed float from [0, 1)
+ */
+float rngUnit(Trng* rng);
+
+/**
+ * returns uniformly distributed float from [min, max)
+ */
+float rngFloat(Trng* rng, float min, float max);
+
+#endif
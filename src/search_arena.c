@@ -0,0 +1,151 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "search_arena.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+
+// arena of calling thread (NULL until its first search)
+static _Thread_local TsearchArena* threadArena = NULL;
+
+// frees arena when its thread ends
+static pthread_key_t arenaKey;
+static pthread_once_t arenaKeyOnce = PTHREAD_ONCE_INIT;
+
+
+TsearchArena* initSearchArena(void)
+{
+  TsearchArena* arena = calloc(1, sizeof(TsearchArena));
+  if(arena == NULL){
+    return NULL;
+  }
+  arena->blockCapacity = 4;
+  arena->blocks = malloc(arena->blockCapacity * sizeof(unsigned char*));
+  arena->blockSizes = malloc(arena->blockCapacity * sizeof(size_t));
+  if(arena->blocks == NULL || arena->blockSizes == NULL){
+    free(arena->blocks);
+    free(arena->blockSizes);
+    free(arena);
+    return NULL;
+  }
+  arena->block = -1;
+  return arena;
+}
+
+void freeSearchArena(TsearchArena* arena)
+{
+  for(int i = 0; i < arena->blockCount; ++i){
+    free(arena->blocks[i]);
+  }
+  free(arena->blocks);
+  free(arena->blockSizes);
+  free(arena);
+}
+
+
+static void freeThreadSearchArena(void* arena)
+{
+  freeSearchArena(arena);
+}
+
+static void createArenaKey(void)
+{
+  pthread_key_create(&arenaKey, freeThreadSearchArena);
+}
+
+TsearchArena* getThreadSearchArena(void)
+{
+  if(threadArena == NULL){
+    pthread_once(&arenaKeyOnce, createArenaKey);
+    threadArena = initSearchArena();
+    if(threadArena != NULL){
+      pthread_setspecific(arenaKey, threadArena);
+    }
+  }
+  return threadArena;
+}
+
+
+/**
+ * moves arena to start of next block that has at least size bytes
+ *
+ * @return false if block can not be allocated
+ */
+static bool searchArenaNextBlock(TsearchArena* arena, size_t size)
+{
+  int next = arena->block + 1;
+  size_t blockSize = (size > SEARCH_ARENA_BLOCK_SIZE) ?
+                     size : SEARCH_ARENA_BLOCK_SIZE;
+
+  // blocks after current one are unused, too small one is replaced
+  if(next < arena->blockCount && arena->blockSizes[next] < size){
+    free(arena->blocks[next]);
+    arena->blocks[next] = malloc(blockSize);
+    arena->blockSizes[next] = (arena->blocks[next] != NULL) ? blockSize : 0;
+    if(arena->blocks[next] == NULL){
+      return false;
+    }
+  }
+
+  if(next == arena->blockCount){
+    if(arena->blockCount == arena->blockCapacity){
+      int capacity = 2 * arena->blockCapacity;
+      unsigned char** blocks = realloc(arena->blocks,
+                                       capacity * sizeof(unsigned char*));
+      if(blocks == NULL){
+        return false;
+      }
+      arena->blocks = blocks;
+      size_t* sizes = realloc(arena->blockSizes, capacity * sizeof(size_t));
+      if(sizes == NULL){
+        return false;
+      }
+      arena->blockSizes = sizes;
+      arena->blockCapacity = capacity;
+    }
+    arena->blocks[next] = malloc(blockSize);
+    if(arena->blocks[next] == NULL){
+      return false;
+    }
+    arena->blockSizes[next] = blockSize;
+    ++arena->blockCount;
+  }
+
+  arena->block = next;
+  arena->used = 0;
+  return true;
+}
+
+void* searchArenaAlloc(TsearchArena* arena, size_t size)
+{
+  size = (size + SEARCH_ARENA_ALIGN - 1) & ~(size_t)(SEARCH_ARENA_ALIGN - 1);
+
+  if(arena->block < 0 ||
+     arena->used + size > arena->blockSizes[arena->block]){
+    if(!searchArenaNextBlock(arena, size)){
+      return NULL;
+    }
+  }
+
+  void* p = arena->blocks[arena->block] + arena->used;
+  arena->used += size;
+  return p;
+}
+
+
+TsearchArenaMark searchArenaMark(const TsearchArena* arena)
+{
+  return (TsearchArenaMark){arena->block, arena->used};
+}
+
+void searchArenaReset(TsearchArena* arena, TsearchArenaMark mark)
+{
+  arena->block = mark.block;
+  arena->used = mark.used;
+}
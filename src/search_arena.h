@@ -0,0 +1,79 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_SEARCH_ARENA_H
+#define __MODULE_SEARCH_ARENA_H
+
+#include <stddef.h>
+
+
+// size of one block of arena (bigger allocations get own block)
+#define SEARCH_ARENA_BLOCK_SIZE (256 * 1024)
+
+// alignment of every allocation
+#define SEARCH_ARENA_ALIGN 16
+
+
+/**
+ * stack (bump) allocator of one thread
+ *
+ * allocation only moves position in current block, memory is given back
+ * all at once by searchArenaReset to position of searchArenaMark (nodes
+ * of search mark arena when they start and reset it when they return).
+ * Blocks are kept after reset, so search allocates from malloc only until
+ * arena reaches its largest size.
+ */
+typedef struct {
+
+  unsigned char** blocks;
+  size_t* blockSizes;
+  int blockCount;
+  int blockCapacity;
+
+  // position (index of block and bytes used in it)
+  int block;
+  size_t used;
+
+} TsearchArena;
+
+/**
+ * position of arena
+ */
+typedef struct {
+  int block;
+  size_t used;
+} TsearchArenaMark;
+
+
+/**
+ * returns empty arena (NULL if error)
+ */
+TsearchArena* initSearchArena(void);
+
+void freeSearchArena(TsearchArena* arena);
+
+/**
+ * returns arena of calling thread (created by first call, freed when
+ * thread ends)
+ */
+TsearchArena* getThreadSearchArena(void);
+
+/**
+ * returns size bytes of arena (NULL if error)
+ */
+void* searchArenaAlloc(TsearchArena* arena, size_t size);
+
+/**
+ * returns current position of arena
+ */
+TsearchArenaMark searchArenaMark(const TsearchArena* arena);
+
+/**
+ * frees everything allocated after mark was taken (O(1))
+ */
+void searchArenaReset(TsearchArena* arena, TsearchArenaMark mark);
+
+#endif
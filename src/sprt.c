@@ -0,0 +1,204 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "sprt.h"
+#include "game_sched.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+
+void initSprtState(TsprtState* state, const TsprtConfig* config)
+{
+  for(int i = 0; i < 5; ++i){
+    state->pairs[i] = 0;
+  }
+  state->wins = 0;
+  state->draws = 0;
+  state->losses = 0;
+
+  state->llr = 0;
+  state->lowerBound = log(config->beta / (1.0 - config->alpha));
+  state->upperBound = log((1.0 - config->beta) / config->alpha);
+  state->decision = SPRT_CONTINUE;
+}
+
+
+/**
+ * returns expected score of player elo points better than opponent
+ */
+static double eloToScore(double elo)
+{
+  return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+double sprtLlr(const int pairs[5], double elo0, double elo1)
+{
+  int n = 0;
+  double sum = 0;
+  for(int i = 0; i < 5; ++i){
+    n += pairs[i];
+    sum += pairs[i] * (i / 4.0);
+  }
+  if(n == 0){
+    return 0;
+  }
+
+  double mean = sum / n;
+  double variance = 0;
+  for(int i = 0; i < 5; ++i){
+    variance += pairs[i] * (i/4.0 - mean) * (i/4.0 - mean);
+  }
+  variance /= n;
+  if(variance <= 0){
+    return 0;
+  }
+
+  double s0 = eloToScore(elo0), s1 = eloToScore(elo1);
+  return n * (s1 - s0) * (2*mean - s0 - s1) / (2 * variance);
+}
+
+
+/**
+ * returns points (in halves) of player for result of game()
+ */
+static int halfPoints(int result, bool isWhite)
+{
+  if(result == 0){
+    return 1;
+  }
+  return ((result == 1) == isWhite) ? 2 : 0;
+}
+
+void sprtAddPair(TsprtState* state, const TsprtConfig* config,
+                 int firstResult, int secondResult)
+{
+  int a = halfPoints(firstResult, true);
+  int b = halfPoints(secondResult, false);
+
+  ++state->pairs[a + b];
+  for(int i = 0; i < 2; ++i){
+    int points = (i == 0) ? a : b;
+    if(points == 2){
+      ++state->wins;
+    } else if(points == 1){
+      ++state->draws;
+    } else {
+      ++state->losses;
+    }
+  }
+
+  state->llr = sprtLlr(state->pairs, config->elo0, config->elo1);
+  if(state->llr >= state->upperBound){
+    state->decision = SPRT_ACCEPT_H1;
+  } else if(state->llr <= state->lowerBound){
+    state->decision = SPRT_ACCEPT_H0;
+  }
+}
+
+double sprtEloEstimate(const TsprtState* state)
+{
+  int games = state->wins + state->draws + state->losses;
+  if(games == 0){
+    return 0;
+  }
+  double score = (state->wins + 0.5 * state->draws) / games;
+  // keep estimate finite if one player won everything
+  score = fmin(fmax(score, 0.5 / games), 1.0 - 0.5 / games);
+
+  return -400.0 * log10(1.0 / score - 1.0);
+}
+
+
+typedef struct {
+  TsprtState* state;
+  const TsprtConfig* config;
+
+  // finished games of every pair (only changed inside callback)
+  int* pairGames;
+} TsprtMatch;
+
+/**
+ * adds pair to test when both its games are finished
+ *
+ * results are written by playing threads outside of callback, so both
+ * games finishing at once could see each other`s result and add the pair
+ * twice. Pair is complete when callback counts its second game.
+ */
+static bool sprtOnResult(TgameScheduler* sched, int taskIndex, void* data)
+{
+  TsprtMatch* match = data;
+  const TgameTask* first = &sched->tasks[taskIndex & ~1];
+  const TgameTask* second = &sched->tasks[taskIndex | 1];
+
+  if(++match->pairGames[taskIndex / 2] == 2 &&
+     first->result != GAME_NOT_PLAYED && second->result != GAME_NOT_PLAYED){
+    sprtAddPair(match->state, match->config, first->result, second->result);
+  }
+  return match->state->decision == SPRT_CONTINUE;
+}
+
+TsprtDecision sprtMatch(const TchNet* first, const TchNet* second,
+                        Tboard** openings, int openingCount,
+                        const TsprtConfig* config, TsprtState* state)
+{
+  initSprtState(state, config);
+
+  TgameScheduler* sched = initGameScheduler();
+  int* pairGames = calloc((config->maxPairs > 0) ? config->maxPairs : 1,
+                          sizeof(int));
+  if(sched == NULL || pairGames == NULL || openingCount < 1){
+    state->decision = SPRT_INCONCLUSIVE;
+    if(sched != NULL){
+      freeGameScheduler(sched);
+    }
+    free(pairGames);
+    return state->decision;
+  }
+
+  // pair i is tasks 2i and 2i+1 (half of pair can not be queued)
+  for(int i = 0; i < config->maxPairs; ++i){
+    const Tboard* opening = openings[i % openingCount];
+    if(gameSchedulerAddFrom(sched, first, second, opening, 0, 2*i) < 0 ||
+       gameSchedulerAddFrom(sched, second, first, opening, 0, 2*i + 1) < 0){
+      state->decision = SPRT_INCONCLUSIVE;
+      freeGameScheduler(sched);
+      free(pairGames);
+      return state->decision;
+    }
+  }
+
+  TsprtMatch match = {state, config, pairGames};
+  sched->onResult = sprtOnResult;
+  sched->onResultData = &match;
+  runGameScheduler(sched, config->timeForMove, false);
+
+  if(state->decision == SPRT_CONTINUE){
+    state->decision = SPRT_INCONCLUSIVE;
+  }
+
+  freeGameScheduler(sched);
+  free(pairGames);
+  return state->decision;
+}
+
+
+void printSprtState(const TsprtState* state)
+{
+  const char* decisionNames[] = {"running", "H0 accepted", "H1 accepted",
+                                 "inconclusive"};
+
+  printf("games: %d (+%d =%d -%d), pairs: %d %d %d %d %d\n",
+         state->wins + state->draws + state->losses,
+         state->wins, state->draws, state->losses,
+         state->pairs[0], state->pairs[1], state->pairs[2],
+         state->pairs[3], state->pairs[4]);
+  printf("llr: %.3f [%.3f, %.3f], elo: %+.1f\n",
+         state->llr, state->lowerBound, state->upperBound,
+         sprtEloEstimate(state));
+  printf("sprt: %s\n", decisionNames[state->decision]);
+}
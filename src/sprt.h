@@ -0,0 +1,115 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_SPRT_H
+#define __MODULE_SPRT_H
+
+#include "chess_net.h"
+#include "chess_structs.h"
+
+
+/**
+ * settings of head to head match
+ *
+ * H0: first player is elo0 better than second, H1: it is elo1 better
+ */
+typedef struct {
+
+  double elo0;
+  double elo1;
+
+  // probability of accepting H1 when H0 holds
+  double alpha;
+
+  // probability of accepting H0 when H1 holds
+  double beta;
+
+  // match is inconclusive after this many pairs of games
+  int maxPairs;
+
+  float timeForMove;
+
+} TsprtConfig;
+
+typedef enum {
+  SPRT_CONTINUE = 0,
+  SPRT_ACCEPT_H0,
+  SPRT_ACCEPT_H1,
+  SPRT_INCONCLUSIVE
+} TsprtDecision;
+
+/**
+ * state of sequential probability ratio test
+ *
+ * games are played in pairs (same opening, colors reversed), so result
+ * of pair is pentanomial (first player scores 0, 0.5, 1, 1.5 or 2 points)
+ */
+typedef struct {
+
+  // pairs[i] is number of pairs where first player scored i/2 points
+  int pairs[5];
+
+  // single games from view of first player
+  int wins;
+  int draws;
+  int losses;
+
+  // log likelihood ratio and its bounds (from alpha and beta)
+  double llr;
+  double lowerBound;
+  double upperBound;
+
+  TsprtDecision decision;
+
+} TsprtState;
+
+
+/**
+ * sets state to match without games
+ */
+void initSprtState(TsprtState* state, const TsprtConfig* config);
+
+/**
+ * returns log likelihood ratio of H1 and H0 for pentanomial counts
+ * (normalized Elo approximation, 0 if counts have no variance)
+ */
+double sprtLlr(const int pairs[5], double elo0, double elo1);
+
+/**
+ * adds pair of games to state and updates llr and decision
+ *
+ * @param firstResult,secondResult results of game() in pair, in first
+ *        game first player is white, in second it is black
+ */
+void sprtAddPair(TsprtState* state, const TsprtConfig* config,
+                 int firstResult, int secondResult);
+
+/**
+ * returns Elo difference of first and second player estimated from score
+ */
+double sprtEloEstimate(const TsprtState* state);
+
+/**
+ * plays pairs of games between first and second player in parallel until
+ * SPRT decides (or config->maxPairs pairs are played)
+ *
+ * pair i starts from openings[i % openingCount], first player is white in
+ * first game and black in second one
+ *
+ * @param first,second players (NULL means primitiveEval)
+ * @param state gets filled by final state of test
+ * @return decision (never SPRT_CONTINUE)
+ */
+TsprtDecision sprtMatch(const TchNet* first, const TchNet* second,
+                        Tboard** openings, int openingCount,
+                        const TsprtConfig* config, TsprtState* state);
+
+/**
+ * prints games, llr with bounds, Elo estimate and decision
+ */
+void printSprtState(const TsprtState* state);
+
+#endif
@@ -0,0 +1,589 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "swiss.h"
+#include "ai.h"
+#include "game_sched.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+
+// Glicko constant q = ln(10)/400
+#define GLICKO_Q 0.0057564627324851142
+
+
+void initRating(Trating* r)
+{
+  r->rating = GLICKO_INIT_RATING;
+  r->rd = GLICKO_INIT_RD;
+  r->games = 0;
+  r->whiteGames = 0;
+}
+
+
+/**
+ * weight of result against opponent with deviation rd
+ */
+static double glickoG(double rd)
+{
+  return 1.0 / sqrt(1.0 + 3.0 * GLICKO_Q*GLICKO_Q * rd*rd / (M_PI*M_PI));
+}
+
+double ratingExpectedScore(const Trating* player, const Trating* opponent)
+{
+  return 1.0 / (1.0 + pow(10.0, -glickoG(opponent->rd) *
+                               (player->rating - opponent->rating) / 400.0));
+}
+
+
+void updateRatings(Trating* ratings, int playerCount, const int* white,
+                   const int* black, const int* results, int gameCount)
+{
+  // sum of g^2*E*(1-E) and g*(s-E) over games of every player
+  double* information = calloc(playerCount, sizeof(double));
+  double* surprise = calloc(playerCount, sizeof(double));
+
+  for(int k = 0; k < gameCount; ++k){
+    if(results[k] < -1 || results[k] > 1){
+      continue;
+    }
+    const Trating* w = &ratings[white[k]];
+    const Trating* b = &ratings[black[k]];
+    double whiteScore = (results[k] == 1) ? 1.0 :
+                        (results[k] == 0) ? 0.5 : 0.0;
+
+    double gW = glickoG(w->rd), gB = glickoG(b->rd);
+    double eW = ratingExpectedScore(w, b), eB = ratingExpectedScore(b, w);
+
+    information[white[k]] += gB*gB * eW * (1.0 - eW);
+    surprise[white[k]] += gB * (whiteScore - eW);
+    information[black[k]] += gW*gW * eB * (1.0 - eB);
+    surprise[black[k]] += gW * ((1.0 - whiteScore) - eB);
+  }
+
+  for(int k = 0; k < gameCount; ++k){
+    if(results[k] < -1 || results[k] > 1){
+      continue;
+    }
+    ++ratings[white[k]].games;
+    ++ratings[white[k]].whiteGames;
+    ++ratings[black[k]].games;
+  }
+
+  for(int i = 0; i < playerCount; ++i){
+    if(information[i] <= 0){
+      continue;
+    }
+    Trating* r = &ratings[i];
+    double precision = 1.0 / (r->rd * r->rd) +
+                       GLICKO_Q*GLICKO_Q * information[i];
+
+    r->rating += GLICKO_Q / precision * surprise[i];
+    r->rd = fmax(sqrt(1.0 / precision), GLICKO_MIN_RD);
+  }
+
+  free(information);
+  free(surprise);
+}
+
+
+/**
+ * fills order by indices of players sorted by rating (best first)
+ */
+static void orderByRating(const Trating* ratings, int playerCount, int* order)
+{
+  for(int i = 0; i < playerCount; ++i){
+    int j;
+    for(j = i-1; (j >= 0 && ratings[order[j]].rating < ratings[i].rating);
+        --j){
+      order[j+1] = order[j];
+    }
+    order[j+1] = i;
+  }
+}
+
+/**
+ * returns P(X < 0) for X ~ N(mean, sd^2)
+ */
+static double probabilityBelowZero(double mean, double sd)
+{
+  return 0.5 * erfc(mean / (sd * M_SQRT2));
+}
+
+void ratingMisplacedProbabilities(const Trating* ratings, int playerCount,
+                                  double* probabilities)
+{
+  if(playerCount < 2){
+    for(int i = 0; i < playerCount; ++i){
+      probabilities[i] = 0;
+    }
+    return;
+  }
+  int* order = malloc(playerCount * sizeof(int));
+  orderByRating(ratings, playerCount, order);
+
+  int half = playerCount / 2;
+  double split = (ratings[order[half-1]].rating +
+                  ratings[order[half]].rating) / 2;
+
+  for(int i = 0; i < playerCount; ++i){
+    const Trating* r = &ratings[order[i]];
+    if(i < half){
+      probabilities[order[i]] = probabilityBelowZero(r->rating - split, r->rd);
+    } else {
+      probabilities[order[i]] = probabilityBelowZero(split - r->rating, r->rd);
+    }
+  }
+
+  free(order);
+}
+
+double ratingMisplacedHalf(const Trating* ratings, int playerCount)
+{
+  double* probabilities = malloc(playerCount * sizeof(double));
+  ratingMisplacedProbabilities(ratings, playerCount, probabilities);
+
+  double misplaced = 0;
+  for(int i = 0; i < playerCount; ++i){
+    misplaced += probabilities[i];
+  }
+
+  free(probabilities);
+  return misplaced;
+}
+
+
+int swissPairings(const Trating* ratings, int playerCount, const bool* played,
+                  int maxGames, int* white, int* black)
+{
+  double* uncertainty = malloc(playerCount * sizeof(double));
+  bool* paired = calloc(playerCount, sizeof(bool));
+  ratingMisplacedProbabilities(ratings, playerCount, uncertainty);
+
+  int gameCount = 0;
+  while(gameCount < maxGames){
+    // most uncertain player plays first
+    int a = -1;
+    for(int i = 0; i < playerCount; ++i){
+      if(!paired[i] && uncertainty[i] >= SWISS_MIN_UNCERTAINTY &&
+         (a == -1 || uncertainty[i] > uncertainty[a])){
+        a = i;
+      }
+    }
+    if(a == -1){
+      break;
+    }
+
+    // nearest uncertain player without rematch, else nearest uncertain
+    int opponent = -1;
+    bool isRematch = true;
+    double distance = 0;
+    for(int i = 0; i < playerCount; ++i){
+      if(i == a || paired[i] || uncertainty[i] < SWISS_MIN_UNCERTAINTY){
+        continue;
+      }
+      bool rematch = played[a*playerCount + i];
+      double d = fabs(ratings[i].rating - ratings[a].rating);
+      if(opponent == -1 || (isRematch && !rematch) ||
+         (rematch == isRematch && d < distance)){
+        opponent = i;
+        isRematch = rematch;
+        distance = d;
+      }
+    }
+    if(opponent == -1){
+      break;
+    }
+
+    paired[a] = true;
+    paired[opponent] = true;
+
+    if(2*ratings[a].whiteGames - ratings[a].games <=
+       2*ratings[opponent].whiteGames - ratings[opponent].games){
+      white[gameCount] = a;
+      black[gameCount] = opponent;
+    } else {
+      white[gameCount] = opponent;
+      black[gameCount] = a;
+    }
+    ++gameCount;
+  }
+
+  free(paired);
+  free(uncertainty);
+  return gameCount;
+}
+
+
+/**
+ * plays games of one round, results[k] is result of game of white[k] and
+ * black[k] (1 white won, 0 draw, -1 black won)
+ */
+typedef void (*TswissPlayFun)(const int* white, const int* black,
+                              int gameCount, int* results, void* data);
+
+/**
+ * plays Swiss tournament of players with initial ratings (see
+ * swissTournament), games are played by play
+ *
+ * @return number of played games
+ */
+static int swissRun(Trating* ratings, int playerCount, int maxGames,
+                    double maxMisplaced, Trng* rng, TswissPlayFun play,
+                    void* data)
+{
+  bool* played = calloc(playerCount * playerCount, sizeof(bool));
+  int* order = malloc(playerCount * sizeof(int));
+  int* white = malloc((playerCount/2 + 1) * sizeof(int));
+  int* black = malloc((playerCount/2 + 1) * sizeof(int));
+  int* results = malloc((playerCount/2 + 1) * sizeof(int));
+
+  // nothing is known in first round, so everyone plays random opponent
+  for(int i = 0; i < playerCount; ++i){
+    order[i] = i;
+  }
+  for(int i = playerCount - 1; i > 0; --i){
+    int j = rngNext(rng) % (i + 1);
+    int temp = order[i];
+    order[i] = order[j];
+    order[j] = temp;
+  }
+  int gameCount = 0;
+  for(int i = 0; i + 1 < playerCount && gameCount < maxGames; i += 2){
+    white[gameCount] = order[i];
+    black[gameCount] = order[i+1];
+    ++gameCount;
+  }
+
+  int roundGames = SWISS_ROUND_SHARE * playerCount / 2;
+  if(roundGames < 1){
+    roundGames = 1;
+  }
+
+  int games = 0;
+  while(gameCount > 0){
+    for(int k = 0; k < gameCount; ++k){
+      played[white[k]*playerCount + black[k]] = true;
+      played[black[k]*playerCount + white[k]] = true;
+    }
+    play(white, black, gameCount, results, data);
+    updateRatings(ratings, playerCount, white, black, results, gameCount);
+    games += gameCount;
+
+    // budget only caps tournament, normally it ends when split is certain
+    // enough
+    if(ratingMisplacedHalf(ratings, playerCount) <= maxMisplaced){
+      break;
+    }
+    int limit = (maxGames - games < roundGames) ? maxGames - games
+                                                : roundGames;
+    gameCount = swissPairings(ratings, playerCount, played, limit,
+                              white, black);
+  }
+
+  free(results);
+  free(black);
+  free(white);
+  free(order);
+  free(played);
+  return games;
+}
+
+
+/**
+ * games of tournament of nets
+ */
+typedef struct {
+  TchNet** population;
+  TgameScheduler* sched;
+  float timeForMove;
+  int round;
+} TswissGames;
+
+static void playSwissRound(const int* white, const int* black, int gameCount,
+                           int* results, void* data)
+{
+  TswissGames* t = data;
+
+  clearGameScheduler(t->sched);
+  // games that can not be queued are not played (and not rated)
+  int queued = 0;
+  while(queued < gameCount &&
+        gameSchedulerAdd(t->sched, t->population[white[queued]],
+                         t->population[black[queued]], t->round,
+                         queued) >= 0){
+    ++queued;
+  }
+  runGameScheduler(t->sched, t->timeForMove, false);
+
+  for(int k = 0; k < gameCount; ++k){
+    results[k] = (k < queued) ? t->sched->tasks[k].result : GAME_NOT_PLAYED;
+  }
+  ++t->round;
+  printf("swiss round %d: %d games in %.2f s\n",
+         t->round, gameCount, t->sched->wallSeconds);
+}
+
+int swissTournament(TchNet** population, int populationCount, int maxGames,
+                    double maxMisplaced, float timeForMove, Trng* rng,
+                    float* sortedRatings)
+{
+  Trating* ratings = malloc(populationCount * sizeof(Trating));
+  for(int i = 0; i < populationCount; ++i){
+    initRating(&ratings[i]);
+  }
+
+  TswissGames t = {
+    .population = population,
+    .sched = initGameScheduler(),
+    .timeForMove = timeForMove,
+    .round = 0
+  };
+  int games = swissRun(ratings, populationCount, maxGames, maxMisplaced,
+                       rng, playSwissRound, &t);
+  double misplaced = ratingMisplacedHalf(ratings, populationCount);
+
+  float* keys = malloc(populationCount * sizeof(float));
+  for(int i = 0; i < populationCount; ++i){
+    keys[i] = ratings[i].rating;
+  }
+  sortPopulation(population, keys, populationCount, false);
+  printf("swiss: %d games in %d rounds, expected misplaced %.2f, "
+         "best %.0f, worst %.0f\n",
+         games, t.round, misplaced, keys[0], keys[populationCount-1]);
+  if(sortedRatings != NULL){
+    memcpy(sortedRatings, keys, populationCount * sizeof(float));
+  }
+
+  freeGameScheduler(t.sched);
+  free(keys);
+  free(ratings);
+
+  return games;
+}
+
+
+// synthetic players of swissSelfTest
+#define SWISS_TEST_PLAYERS 100
+#define SWISS_TEST_SPREAD 800.0
+#define SWISS_TEST_TRIALS 500
+
+// with large game budget tournament is ended by certain split, players
+// far apart (easy ones) need fewer games than SWISS_TEST_SPREAD
+#define SWISS_TEST_EASY_SPREAD 8000.0
+#define SWISS_TEST_LONG_GAMES_PER_PLAYER 10
+#define SWISS_TEST_LONG_TRIALS 100
+
+/**
+ * synthetic players with known true ratings
+ */
+typedef struct {
+  double elo[SWISS_TEST_PLAYERS];
+  double spread;
+  double drawRate;
+  Trng rng;
+} TswissTestPlayers;
+
+/**
+ * sets true ratings evenly spread over t->spread, in random order
+ */
+static void spreadTestPlayers(TswissTestPlayers* t)
+{
+  for(int i = 0; i < SWISS_TEST_PLAYERS; ++i){
+    t->elo[i] = t->spread * i / (SWISS_TEST_PLAYERS - 1);
+  }
+  for(int i = SWISS_TEST_PLAYERS - 1; i > 0; --i){
+    int j = rngNext(&t->rng) % (i + 1);
+    double temp = t->elo[i];
+    t->elo[i] = t->elo[j];
+    t->elo[j] = temp;
+  }
+}
+
+/**
+ * returns result of game given by true ratings (Elo expected score,
+ * drawRate of games near equal players are draws)
+ */
+static int syntheticResult(TswissTestPlayers* t, int white, int black)
+{
+  double expected = 1.0 / (1.0 + pow(10.0, -(t->elo[white] - t->elo[black]) /
+                                           400.0));
+  double win = fmax(expected - t->drawRate / 2, 0);
+  double u = rngUnit(&t->rng);
+  return (u < win) ? 1 : (u < win + t->drawRate) ? 0 : -1;
+}
+
+static void playSyntheticRound(const int* white, const int* black,
+                               int gameCount, int* results, void* data)
+{
+  for(int k = 0; k < gameCount; ++k){
+    results[k] = syntheticResult(data, white[k], black[k]);
+  }
+}
+
+/**
+ * returns number of players in top half of order, that are in bottom half
+ * by true rating
+ */
+static int countMisplaced(const TswissTestPlayers* t, const int* order)
+{
+  int misplaced = 0;
+  for(int i = 0; i < SWISS_TEST_PLAYERS / 2; ++i){
+    if(t->elo[order[i]] < t->spread / 2){
+      ++misplaced;
+    }
+  }
+  return misplaced;
+}
+
+/**
+ * plays Swiss tournament of synthetic players (same stop as evolution)
+ *
+ * @param misplaced gets number of misplaced players
+ * @return number of played games
+ */
+static int swissTestMisplaced(TswissTestPlayers* t, int maxGames,
+                              int* misplaced)
+{
+  Trating ratings[SWISS_TEST_PLAYERS];
+  int order[SWISS_TEST_PLAYERS];
+  for(int i = 0; i < SWISS_TEST_PLAYERS; ++i){
+    initRating(&ratings[i]);
+  }
+  int games = swissRun(ratings, SWISS_TEST_PLAYERS, maxGames,
+                       SWISS_MAX_MISPLACED_SHARE * SWISS_TEST_PLAYERS,
+                       &t->rng, playSyntheticRound, t);
+  orderByRating(ratings, SWISS_TEST_PLAYERS, order);
+  *misplaced = countMisplaced(t, order);
+  return games;
+}
+
+/**
+ * plays old tournament (two rounds of random pairs scored as in
+ * quickTournament, players are sorted by score, ties stay in random order)
+ *
+ * @return number of misplaced players
+ */
+static int oldTournamentMisplaced(TswissTestPlayers* t)
+{
+  int order[SWISS_TEST_PLAYERS];
+  double score[SWISS_TEST_PLAYERS] = {0};
+  for(int i = 0; i < SWISS_TEST_PLAYERS; ++i){
+    order[i] = i;
+  }
+
+  for(int round = 0; round < 2; ++round){
+    for(int i = SWISS_TEST_PLAYERS - 1; i > 0; --i){
+      int j = rngNext(&t->rng) % (i + 1);
+      int temp = order[i];
+      order[i] = order[j];
+      order[j] = temp;
+    }
+    for(int i = 0; i + 1 < SWISS_TEST_PLAYERS; i += 2){
+      switch(syntheticResult(t, order[i], order[i+1])){
+        case 0:  //draw
+          score[order[i]] += 0.3;
+          score[order[i+1]] += 0.4;
+          break;
+
+        case 1: //win of white
+          score[order[i]] += 1.0;
+          break;
+
+        case -1:  //win of black
+          score[order[i+1]] += 1.1;
+          break;
+      }
+    }
+  }
+
+  for(int i = 1; i < SWISS_TEST_PLAYERS; ++i){
+    int player = order[i];
+    int j;
+    for(j = i-1; (j >= 0 && score[order[j]] < score[player]); --j){
+      order[j+1] = order[j];
+    }
+    order[j+1] = player;
+  }
+
+  return countMisplaced(t, order);
+}
+
+bool swissSelfTest(void)
+{
+  const double drawRates[] = {0, 0.3};
+  const int oldGames = SWISS_TEST_PLAYERS;
+  const int maxGames = SWISS_GAMES_PER_PLAYER * SWISS_TEST_PLAYERS;
+
+  bool ok = true;
+  for(int d = 0; d < (int)(sizeof(drawRates) / sizeof(*drawRates)); ++d){
+    TswissTestPlayers t;
+    t.spread = SWISS_TEST_SPREAD;
+    t.drawRate = drawRates[d];
+    rngSeed(&t.rng, 1, d, 0);
+
+    long swissGames = 0, swissMisplaced = 0, oldMisplaced = 0;
+    for(int trial = 0; trial < SWISS_TEST_TRIALS; ++trial){
+      spreadTestPlayers(&t);
+
+      int misplaced;
+      swissGames += swissTestMisplaced(&t, maxGames, &misplaced);
+      swissMisplaced += misplaced;
+      oldMisplaced += oldTournamentMisplaced(&t);
+    }
+
+    double games = (double)swissGames / SWISS_TEST_TRIALS;
+    double misplaced = (double)swissMisplaced / SWISS_TEST_TRIALS;
+    double old = (double)oldMisplaced / SWISS_TEST_TRIALS;
+    bool drawOk = games < oldGames && misplaced <= old;
+    printf("swiss (%2.0f %% draws) %5.1f games, %5.2f misplaced, "
+           "random pairs %d games, %5.2f misplaced %s\n",
+           100 * drawRates[d], games, misplaced, oldGames, old,
+           drawOk ? "OK" : "FAILED");
+    ok = ok && drawOk;
+  }
+
+  // without draws, large budget is not spent and easy players are sorted
+  // sooner
+  const double spreads[] = {SWISS_TEST_SPREAD, SWISS_TEST_EASY_SPREAD};
+  const int longMaxGames = SWISS_TEST_LONG_GAMES_PER_PLAYER *
+                           SWISS_TEST_PLAYERS;
+  double longGames[2];
+  bool earlyOk = true;
+  for(int e = 0; e < 2; ++e){
+    TswissTestPlayers t;
+    t.spread = spreads[e];
+    t.drawRate = 0;
+    rngSeed(&t.rng, 2, e, 0);
+
+    long swissGames = 0, swissMisplaced = 0;
+    int earlyStops = 0;
+    for(int trial = 0; trial < SWISS_TEST_LONG_TRIALS; ++trial){
+      spreadTestPlayers(&t);
+
+      int misplaced;
+      int games = swissTestMisplaced(&t, longMaxGames, &misplaced);
+      swissGames += games;
+      swissMisplaced += misplaced;
+      earlyStops += (games < longMaxGames);
+    }
+
+    longGames[e] = (double)swissGames / SWISS_TEST_LONG_TRIALS;
+    earlyOk = earlyOk && earlyStops == SWISS_TEST_LONG_TRIALS;
+    printf("swiss (%5.0f Elo) %5.1f games of %d, %5.2f misplaced, "
+           "%3d %% stopped early\n",
+           spreads[e], longGames[e], longMaxGames,
+           (double)swissMisplaced / SWISS_TEST_LONG_TRIALS,
+           100 * earlyStops / SWISS_TEST_LONG_TRIALS);
+  }
+  earlyOk = earlyOk && longGames[1] < longGames[0];
+  printf("swiss stop by expected misplaced %s\n", earlyOk ? "OK" : "FAILED");
+
+  return ok && earlyOk;
+}
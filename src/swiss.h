@@ -0,0 +1,144 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_SWISS_H
+#define __MODULE_SWISS_H
+
+#include "chess_net.h"
+#include "rng.h"
+
+#include <stdbool.h>
+
+
+// rating and deviation of player without games (Glicko)
+#define GLICKO_INIT_RATING 1500.0
+#define GLICKO_INIT_RD 350.0
+
+// deviation never falls below this (keeps new results meaningful)
+#define GLICKO_MIN_RD 30.0
+
+// games of tournament per player (old tournament of two rounds of random
+// pairs played one game per player)
+#define SWISS_GAMES_PER_PLAYER 0.8
+
+// rounds after the first one pair only this share of players (the ones on
+// most uncertain side of survival split), so ratings are updated more often
+#define SWISS_ROUND_SHARE 0.25
+
+// player that is on wrong side of split with lower probability doesn`t
+// play anymore
+#define SWISS_MIN_UNCERTAINTY 0.05
+
+// tournament ends when expected number of players on wrong side of split
+// falls to this share of players (game budget is only cap)
+#define SWISS_MAX_MISPLACED_SHARE 0.1
+
+
+/**
+ * Glicko rating of one player
+ */
+typedef struct {
+
+  double rating;
+
+  // rating deviation (uncertainty of rating)
+  double rd;
+
+  // statistics
+  int games;
+  int whiteGames;
+
+} Trating;
+
+
+/**
+ * sets rating to initial values
+ */
+void initRating(Trating* r);
+
+/**
+ * returns expected score of player against opponent (Glicko)
+ */
+double ratingExpectedScore(const Trating* player, const Trating* opponent);
+
+/**
+ * updates ratings by results of one rating period (round)
+ *
+ * all updates use ratings from before the period
+ *
+ * @param white,black indices of players of every game
+ * @param results result of every game (1 white won, 0 draw, -1 black won),
+ *        games with other results (not played) are skipped
+ */
+void updateRatings(Trating* ratings, int playerCount, const int* white,
+                   const int* black, const int* results, int gameCount);
+
+/**
+ * fills probabilities by probability of every player being on wrong side
+ * of split to top and bottom half
+ *
+ * true rating of every player is taken as normal distribution
+ * N(rating, rd^2) and split is the middle between ratings of last top
+ * and first bottom player
+ */
+void ratingMisplacedProbabilities(const Trating* ratings, int playerCount,
+                                  double* probabilities);
+
+/**
+ * returns expected number of players on wrong side of split to top and
+ * bottom half (sum of ratingMisplacedProbabilities)
+ */
+double ratingMisplacedHalf(const Trating* ratings, int playerCount);
+
+/**
+ * fills white and black by pairings of next Swiss round
+ *
+ * only players with probability of wrong side of split at least
+ * SWISS_MIN_UNCERTAINTY play. The most uncertain one is paired with the
+ * nearest rated uncertain player it has not played yet (if possible), so
+ * games are played where the order is most uncertain. White gets player
+ * with less white games.
+ *
+ * @param played playerCount*playerCount matrix, played[i*playerCount + j]
+ *        is true if i and j already played
+ * @param maxGames max number of games of round
+ * @return number of games (0 if survival split is stable)
+ */
+int swissPairings(const Trating* ratings, int playerCount, const bool* played,
+                  int maxGames, int* white, int* black);
+
+/**
+ * sorts population by Swiss tournament with Glicko ratings
+ *
+ * first round pairs all nets randomly, next ones pair SWISS_ROUND_SHARE
+ * of population by swissPairings(), until expected number of nets on wrong
+ * side of survival split (ratingMisplacedHalf) is at most maxMisplaced,
+ * maxGames games are played or split is stable, second half is sentenced
+ * to death
+ *
+ * @param rng generator of pairings of first round
+ * @param sortedRatings gets filled by ratings of sorted population
+ *        (can be NULL)
+ * @return number of played games
+ */
+int swissTournament(TchNet** population, int populationCount, int maxGames,
+                    double maxMisplaced, float timeForMove, Trng* rng,
+                    float* sortedRatings);
+
+/**
+ * compares Swiss tournament with old tournament of two rounds of random
+ * pairs on synthetic players (true ratings spread over 800 Elo) and prints
+ * average number of games and of nets on wrong side of split to stdout,
+ * then plays Swiss tournaments with large game budget on same players and
+ * on easy ones (spread over 8000 Elo)
+ *
+ * @return true if Swiss tournament plays fewer games and misplaces at most
+ *         as many nets, with large budget all tournaments stop before it
+ *         and easy ones play fewer games
+ */
+bool swissSelfTest(void);
+
+#endif
@@ -0,0 +1,540 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#include "uci.h"
+#include "chess_logic.h"
+#include "eval_cache.h"
+#include "pop_archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <omp.h>
+
+
+// longest command accepted (position with long game)
+#define UCI_LINE_LEN 65536
+
+// time management of "go wtime ... btime ...", moves expected till end of
+// game when movestogo is not given, part of increment used and max part
+// of remaining time used for one move
+#define UCI_DEFAULT_MOVES_TO_GO 30
+#define UCI_INC_USAGE 0.8
+#define UCI_MAX_TIME_USAGE 0.5
+
+// evaluation of primitiveEval is in tenths of pawn, evaluation of net is
+// probability of win of white (converted by logistic curve of this scale,
+// clamped to max)
+#define UCI_CENTIPAWNS_PER_EVAL 10
+#define UCI_NET_CENTIPAWN_SCALE 400
+#define UCI_MAX_CENTIPAWNS 10000
+
+
+// positions of bench (openings, middlegames, endgames)
+static const char* benchFens[] = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+  "2r3k1/1q1nbppp/r3p3/3pP3/pPpP4/P1Q2N2/2RN1PPP/2R4K b - - 0 22",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+  "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+};
+
+
+/**
+ * writes line to GUI (printf of one line is never mixed with line of
+ * other thread)
+ */
+static void uciSend(const char* format, ...)
+{
+  char line[1024];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  printf("%s\n", line);
+  fflush(stdout);
+}
+
+
+/**
+ * converts move of moveBoard to UCI notation ("E7E8" -> "e7e8q"), b is
+ * position before move
+ */
+static void moveToUci(const Tboard* b, const char* move, char* uci)
+{
+  if(strcmp(move, "nomo") == 0){
+    strcpy(uci, "0000");
+    return;
+  }
+
+  for(int i = 0; i < 4; ++i){
+    uci[i] = tolower(move[i]);
+  }
+  uci[4] = tolower(move[4]);
+  uci[5] = '\0';
+
+  // promotion to queen has no char in moveBoard notation
+  char piece = b->pieces['8' - move[1]][move[0] - 'A'];
+  if(move[4] == '\0' && (piece == 'p' || piece == 'P') &&
+     (move[3] == '1' || move[3] == '8')){
+    uci[4] = 'q';
+  }
+}
+
+/**
+ * converts UCI move to move of moveBoard
+ *
+ * @return false if move is not legal in b
+ */
+static bool uciToMove(Tboard* b, const char* uci, char* move)
+{
+  TmoveList* ml = initMoveList(32);
+  generateAllPossibleMoves(b, ml);
+
+  bool found = false;
+  char candidate[MAX_INP_LEN + 1];
+  for(int i = 0; !found && i < ml->filled; ++i){
+    moveToUci(b, ml->moves[i], candidate);
+    if(strcasecmp(candidate, uci) == 0){
+      strcpy(move, ml->moves[i]);
+      found = true;
+    }
+  }
+
+  freeMoveList(ml);
+  return found;
+}
+
+
+/**
+ * writes score of search from point of view of side to move ("cp 31" or
+ * "mate -2")
+ *
+ * @param isNet true if evaluation is output of net (else primitiveEval)
+ */
+static void formatUciScore(const TsearchInfo* info, bool isBlack, bool isNet,
+                           char* score, size_t size)
+{
+  float evaluation = info->evaluation;
+
+  if(fabsf(evaluation) >= MINIMAX_WIN_EVAL_COEF){
+    // mate found with remaining depth d is worth COEF * (d+1)
+    int remaining = lroundf(fabsf(evaluation) / MINIMAX_WIN_EVAL_COEF) - 1;
+    int moves = (info->depth - remaining + 1) / 2;
+    bool isWon = (evaluation > 0) != isBlack;
+    snprintf(score, size, "mate %d", isWon ? moves : -moves);
+    return;
+  }
+
+  double centipawns;
+  if(isNet){
+    double p = fmin(fmax(evaluation, 1e-6), 1 - 1e-6);
+    centipawns = UCI_NET_CENTIPAWN_SCALE * log10(p / (1 - p));
+  } else {
+    centipawns = evaluation * UCI_CENTIPAWNS_PER_EVAL;
+  }
+  centipawns = fmin(fmax(centipawns, -UCI_MAX_CENTIPAWNS),
+                    UCI_MAX_CENTIPAWNS);
+  snprintf(score, size, "cp %ld", lround(isBlack ? -centipawns : centipawns));
+}
+
+/**
+ * search callback, prints info line of finished depth
+ */
+static void uciOnDepth(const TsearchInfo* info, void* data)
+{
+  const TuciEngine* engine = data;
+  const Tboard* b = engine->searchBoard;
+  char score[32], move[MAX_INP_LEN + 1];
+  formatUciScore(info, b->move%2 != 0, engine->net != NULL,
+                 score, sizeof(score));
+  moveToUci(b, info->bestMove, move);
+
+  long ms = lround(info->elapsed * 1000);
+  uciSend("info depth %d score %s nodes %ld nps %.0f time %ld pv %s",
+          info->depth, score, info->nodes,
+          (info->elapsed > 0) ? info->nodes / info->elapsed : 0, ms, move);
+}
+
+
+/**
+ * sets size of eval cache of net to hashMb (rounded down to power of two
+ * entries)
+ */
+static void uciResizeHash(TuciEngine* engine)
+{
+  if(engine->net == NULL){
+    return;
+  }
+
+  int bits = 0;
+  while(((size_t)1 << (bits + 1)) * sizeof(TevalCacheEntry) <=
+        (size_t)engine->hashMb << 20){
+    ++bits;
+  }
+
+  if(engine->net->evalCache != NULL){
+    freeEvalCache(engine->net->evalCache);
+  }
+  engine->net->evalCache = initEvalCache(bits);
+}
+
+/**
+ * replaces net of engine by net of name ("primitive" or empty name for
+ * primitiveEval)
+ *
+ * @return false if net can not be loaded (engine keeps old net)
+ */
+static bool uciSetNet(TuciEngine* engine, const char* name)
+{
+  TchNet* net = NULL;
+  if(name[0] != '\0' && strcmp(name, "<empty>") != 0 &&
+     strcmp(name, "primitive") != 0){
+    net = loadNamedNet(name);
+    if(net == NULL){
+      return false;
+    }
+  }
+
+  if(engine->net != NULL){
+    freeChNet(engine->net);
+  }
+  engine->net = net;
+  snprintf(engine->netName, sizeof(engine->netName), "%s",
+           (net != NULL) ? name : "<empty>");
+  uciResizeHash(engine);
+  return true;
+}
+
+
+/**
+ * thread of search started by go
+ */
+static void* uciSearchThread(void* data)
+{
+  TuciEngine* engine = data;
+
+  minimaxSearch(engine->searchBoard, engine->net, &engine->info);
+
+  // bestmove of infinite search can be sent only after stop
+  pthread_mutex_lock(&engine->lock);
+  while(engine->isInfinite && !engine->stop){
+    pthread_cond_wait(&engine->stopped, &engine->lock);
+  }
+  pthread_mutex_unlock(&engine->lock);
+
+  char move[MAX_INP_LEN + 1];
+  moveToUci(engine->searchBoard, engine->info.bestMove, move);
+  uciSend("bestmove %s", move);
+
+  return NULL;
+}
+
+/**
+ * waits for bestmove of running search (if there is one)
+ *
+ * @param isStopped if true (or search is infinite), search is stopped,
+ *        else it is finished within its limits
+ */
+static void uciWaitSearch(TuciEngine* engine, bool isStopped)
+{
+  if(!engine->isSearching){
+    return;
+  }
+
+  if(isStopped || engine->isInfinite){
+    pthread_mutex_lock(&engine->lock);
+    __atomic_store_n(&engine->stop, true, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&engine->stopped);
+    pthread_mutex_unlock(&engine->lock);
+  }
+
+  pthread_join(engine->thread, NULL);
+  freeBoard(engine->searchBoard);
+  engine->searchBoard = NULL;
+  engine->isSearching = false;
+}
+
+
+/**
+ * "uci", prints identity and options
+ */
+static void uciIdentify(const TuciEngine* engine)
+{
+  uciSend("id name %s", UCI_ENGINE_NAME);
+  uciSend("id author %s", UCI_ENGINE_AUTHOR);
+  uciSend("option name Hash type spin default %d min 1 max %d",
+          UCI_DEFAULT_HASH_MB, UCI_MAX_HASH_MB);
+  uciSend("option name Threads type spin default 1 min 1 max %d",
+          UCI_MAX_THREADS);
+  uciSend("option name NetFile type string default %s", engine->netName);
+  uciSend("uciok");
+}
+
+/**
+ * "setoption name <id> [value <x>]"
+ */
+static void uciSetOption(TuciEngine* engine, char* args)
+{
+  char* name = strstr(args, "name");
+  if(name == NULL){
+    return;
+  }
+  name += strlen("name");
+
+  char* value = strstr(name, " value");
+  if(value != NULL){
+    *value = '\0';
+    value += strlen(" value");
+    while(isspace(*value)) ++value;
+    value[strcspn(value, " \t")] = '\0';
+  } else {
+    value = "";
+  }
+  while(isspace(*name)) ++name;
+  name[strcspn(name, " \t")] = '\0';
+
+  if(strcasecmp(name, "Hash") == 0){
+    int mb = atoi(value);
+    engine->hashMb = (mb < 1) ? 1 : (mb > UCI_MAX_HASH_MB) ?
+                                    UCI_MAX_HASH_MB : mb;
+    uciResizeHash(engine);
+  } else if(strcasecmp(name, "Threads") == 0){
+    int threads = atoi(value);
+    engine->threads = (threads < 1) ? 1 : (threads > UCI_MAX_THREADS) ?
+                                          UCI_MAX_THREADS : threads;
+  } else if(strcasecmp(name, "NetFile") == 0){
+    if(!uciSetNet(engine, value)){
+      uciSend("info string %s is not valid net", value);
+    }
+  } else {
+    uciSend("info string unknown option %s", name);
+  }
+}
+
+/**
+ * "position [startpos | fen <fen>] [moves <move>...]"
+ */
+static void uciPosition(TuciEngine* engine, char* args)
+{
+  char* moves = strstr(args, "moves");
+  if(moves != NULL){
+    *moves = '\0';
+    moves += strlen("moves");
+  }
+
+  Tboard* b = NULL;
+  char* fen = strstr(args, "fen");
+  if(fen != NULL){
+    fen += strlen("fen");
+    while(isspace(*fen)) ++fen;
+    b = fenToBoard(fen);
+  } else if(strstr(args, "startpos") != NULL){
+    b = initBoard();
+  }
+  if(b == NULL){
+    uciSend("info string invalid position");
+    return;
+  }
+
+  char* save;
+  char move[MAX_INP_LEN];
+  for(char* uci = (moves != NULL) ? strtok_r(moves, " \t", &save) : NULL;
+      uci != NULL; uci = strtok_r(NULL, " \t", &save)){
+    if(!uciToMove(b, uci, move)){
+      uciSend("info string illegal move %s", uci);
+      freeBoard(b);
+      return;
+    }
+    moveBoard(move, b);
+  }
+
+  freeBoard(engine->board);
+  engine->board = b;
+}
+
+/**
+ * "go [wtime x] [btime x] [winc x] [binc x] [movestogo x] [movetime x]
+ * [depth x] [nodes x] [infinite]", starts search thread
+ */
+static void uciGo(TuciEngine* engine, char* args)
+{
+  uciWaitSearch(engine, false);
+
+  double time[2] = {0, 0}, inc[2] = {0, 0}, moveTime = 0;
+  int movesToGo = 0, depth = 0;
+  long nodes = 0;
+  bool isInfinite = false;
+
+  char* save;
+  for(char* token = strtok_r(args, " \t", &save); token != NULL;
+      token = strtok_r(NULL, " \t", &save)){
+    if(strcmp(token, "infinite") == 0){
+      isInfinite = true;
+      continue;
+    }
+    char* value = strtok_r(NULL, " \t", &save);
+    if(value == NULL){
+      break;
+    }
+    if(strcmp(token, "wtime") == 0) time[0] = atof(value);
+    else if(strcmp(token, "btime") == 0) time[1] = atof(value);
+    else if(strcmp(token, "winc") == 0) inc[0] = atof(value);
+    else if(strcmp(token, "binc") == 0) inc[1] = atof(value);
+    else if(strcmp(token, "movestogo") == 0) movesToGo = atoi(value);
+    else if(strcmp(token, "movetime") == 0) moveTime = atof(value);
+    else if(strcmp(token, "depth") == 0) depth = atoi(value);
+    else if(strcmp(token, "nodes") == 0) nodes = atol(value);
+  }
+
+  // time for move (in ms)
+  int side = engine->board->move%2;
+  if(moveTime <= 0 && time[side] > 0){
+    moveTime = time[side] / ((movesToGo > 0) ? movesToGo :
+                                               UCI_DEFAULT_MOVES_TO_GO) +
+               inc[side] * UCI_INC_USAGE;
+    moveTime = fmin(moveTime, time[side] * UCI_MAX_TIME_USAGE);
+  }
+
+  TsearchInfo* info = &engine->info;
+  initSearchInfo(info, isInfinite ? 0 : moveTime / 1000);
+  info->maxDepth = isInfinite ? 0 : depth;
+  info->maxNodes = isInfinite ? 0 : nodes;
+  info->threads = engine->threads;
+  info->cancel = &engine->stop;
+  info->onDepth = uciOnDepth;
+
+  engine->searchBoard = copyBoard(engine->board);
+  info->onDepthData = engine;
+  // go without any limit searches until stop
+  engine->isInfinite = isInfinite || (info->seconds <= 0 &&
+                                      info->maxDepth <= 0 &&
+                                      info->maxNodes <= 0);
+  engine->stop = false;
+
+  if(pthread_create(&engine->thread, NULL, uciSearchThread, engine) != 0){
+    freeBoard(engine->searchBoard);
+    engine->searchBoard = NULL;
+    uciSend("bestmove 0000");
+    return;
+  }
+  engine->isSearching = true;
+}
+
+
+bool uciLoop(const char* netName)
+{
+  TuciEngine engine;
+  memset(&engine, 0, sizeof(engine));
+  engine.hashMb = UCI_DEFAULT_HASH_MB;
+  engine.threads = 1;
+  if(!uciSetNet(&engine, (netName != NULL) ? netName : "")){
+    return false;
+  }
+  engine.board = initBoard();
+  pthread_mutex_init(&engine.lock, NULL);
+  pthread_cond_init(&engine.stopped, NULL);
+
+  char* line = malloc(UCI_LINE_LEN);
+  while(line != NULL && fgets(line, UCI_LINE_LEN, stdin) != NULL){
+    line[strcspn(line, "\r\n")] = '\0';
+    char command[32];
+    int argsStart;
+    if(sscanf(line, "%31s%n", command, &argsStart) != 1){
+      continue;
+    }
+    char* args = line + argsStart;
+
+    if(strcmp(command, "uci") == 0){
+      uciIdentify(&engine);
+    } else if(strcmp(command, "isready") == 0){
+      uciSend("readyok");
+    } else if(strcmp(command, "setoption") == 0){
+      uciWaitSearch(&engine, false);
+      uciSetOption(&engine, args);
+    } else if(strcmp(command, "ucinewgame") == 0){
+      uciWaitSearch(&engine, false);
+      if(engine.net != NULL && engine.net->evalCache != NULL){
+        clearEvalCache(engine.net->evalCache);
+      }
+    } else if(strcmp(command, "position") == 0){
+      // search has its own copy of board, so it can run on
+      uciPosition(&engine, args);
+    } else if(strcmp(command, "go") == 0){
+      uciGo(&engine, args);
+    } else if(strcmp(command, "stop") == 0){
+      uciWaitSearch(&engine, true);
+    } else if(strcmp(command, "bench") == 0){
+      uciWaitSearch(&engine, false);
+      int depth = atoi(args);
+      runBench(engine.net, (depth > 0) ? depth : BENCH_DEFAULT_DEPTH,
+               engine.threads);
+    } else if(strcmp(command, "quit") == 0){
+      break;
+    } else {
+      uciSend("info string unknown command %s", command);
+    }
+  }
+
+  uciWaitSearch(&engine, true);
+  free(line);
+  freeBoard(engine.board);
+  if(engine.net != NULL){
+    freeChNet(engine.net);
+  }
+  pthread_mutex_destroy(&engine.lock);
+  pthread_cond_destroy(&engine.stopped);
+  return true;
+}
+
+
+long runBench(TchNet* net, int depth, int threads)
+{
+  const int positionCount = sizeof(benchFens) / sizeof(*benchFens);
+
+  if(net != NULL && net->evalCache != NULL){
+    clearEvalCache(net->evalCache);
+  }
+
+  long nodes = 0;
+  double seconds = 0;
+  for(int i = 0; i < positionCount; ++i){
+    Tboard* b = fenToBoard(benchFens[i]);
+    if(b == NULL){
+      continue;
+    }
+
+    TsearchInfo info;
+    initSearchInfo(&info, 0);
+    info.maxDepth = depth;
+    info.threads = threads;
+    minimaxSearch(b, net, &info);
+
+    char move[MAX_INP_LEN + 1];
+    moveToUci(b, info.bestMove, move);
+    printf("position %d/%d: bestmove %-5s nodes %10ld time %.3f s\n",
+           i + 1, positionCount, move, info.nodes, info.elapsed);
+    nodes += info.nodes;
+    seconds += info.elapsed;
+    freeBoard(b);
+  }
+
+  printf("bench: depth %d, %d threads, %s\n", depth, threads,
+         (net != NULL) ? "net" : "primitiveEval");
+  printf("  nodes: %ld\n", nodes);
+  printf("  time: %.3f s\n", seconds);
+  printf("  nodes/sec: %.0f\n", (seconds > 0) ? nodes / seconds : 0);
+  fflush(stdout);
+  return nodes;
+}
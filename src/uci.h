@@ -0,0 +1,90 @@
+/**
+ * Project:  neural chess
+ * Author:   Jakub Urbanek
+ * Year:     2022
+ */
+
+#ifndef __MODULE_UCI_H
+#define __MODULE_UCI_H
+
+#include "ai.h"
+#include "chess_net.h"
+#include "chess_structs.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+
+#define UCI_ENGINE_NAME "neural chess"
+#define UCI_ENGINE_AUTHOR "Jakub Urbanek"
+
+// default and max size of eval cache (option Hash) in MB
+#define UCI_DEFAULT_HASH_MB 1
+#define UCI_MAX_HASH_MB 1024
+
+// max threads of one search (option Threads)
+#define UCI_MAX_THREADS 256
+
+// default depth of bench
+#define BENCH_DEFAULT_DEPTH 4
+
+
+/**
+ * state of UCI engine
+ *
+ * commands are read by main thread, search runs in its own thread, so
+ * stop (or isready) is answered while it is running
+ */
+typedef struct {
+
+  // net used for evaluation (NULL for primitiveEval) and its name
+  TchNet* net;
+  char netName[1024];
+
+  // options
+  int hashMb;
+  int threads;
+
+  // position of last "position" command
+  Tboard* board;
+
+  // running search
+  pthread_t thread;
+  bool isSearching;
+  TsearchInfo info;
+  Tboard* searchBoard;
+
+  // search of "go infinite" doesn`t print bestmove before stop, stop is
+  // also cancel flag of search
+  bool isInfinite;
+  bool stop;
+  pthread_mutex_t lock;
+  pthread_cond_t stopped;
+
+} TuciEngine;
+
+
+/**
+ * reads UCI commands from stdin and answers them on stdout until quit
+ * (or end of input)
+ *
+ * @param netName net for evaluation (same as NetFile option), NULL for
+ *        primitiveEval
+ * @return false if net can not be loaded
+ */
+bool uciLoop(const char* netName);
+
+/**
+ * searches fixed positions to depth and prints nodes of every search,
+ * total nodes and nodes/sec
+ *
+ * cache of net is cleared first, so same build gives same node count
+ *
+ * @param net chess network used for evaluation (NULL for primitiveEval)
+ * @param depth depth of every search in plies
+ * @param threads threads of every search
+ * @return total number of nodes
+ */
+long runBench(TchNet* net, int depth, int threads);
+
+#endif